@@ -161,6 +161,12 @@ public:
   /// \brief Enable the use of the early if conversion pass.
   virtual bool enableEarlyIfConversion() const { return false; }
 
+  /// \brief True if early if conversion should compare the cycles needed to
+  /// issue the speculated instructions and selects against the branch
+  /// mispredict penalty, rather than looking for unused ILP. This suits
+  /// in-order cores, which issue every speculated instruction in sequence.
+  virtual bool enableInOrderEarlyIfConversionCost() const { return false; }
+
   /// \brief Return PBQPConstraint(s) for the target.
   ///
   /// Override to provide custom PBQP constraints.
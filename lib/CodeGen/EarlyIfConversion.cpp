@@ -587,6 +587,7 @@ class EarlyIfConverter : public MachineFunctionPass {
   MachineTraceMetrics *Traces;
   MachineTraceMetrics::Ensemble *MinInstr;
   SSAIfConv IfConv;
+  bool InOrderCost;
 
 public:
   static char ID;
@@ -601,6 +602,7 @@ private:
   void updateLoops(ArrayRef<MachineBasicBlock*> Removed);
   void invalidateTraces();
   bool shouldConvertIf();
+  bool shouldConvertIfInOrder();
 };
 } // end anonymous namespace
 
@@ -670,6 +672,40 @@ static unsigned adjCycles(unsigned Cyc, int Delta) {
   return Cyc + Delta;
 }
 
+/// Cost model for in-order cores. There is no unused ILP to hide the
+/// speculated instructions in, so compare the extra cycles needed to issue
+/// them and the selects against the cost of a mispredicted branch.
+///
+bool EarlyIfConverter::shouldConvertIfInOrder() {
+  MachineTraceMetrics::Trace TBBTrace = MinInstr->getTrace(IfConv.getTPred());
+  MachineTraceMetrics::Trace FBBTrace = MinInstr->getTrace(IfConv.getFPred());
+  unsigned MinLength = std::min(TBBTrace.getResourceLength(),
+                                FBBTrace.getResourceLength());
+
+  SmallVector<const MachineBasicBlock*, 1> ExtraBlocks;
+  if (IfConv.TBB != IfConv.Tail)
+    ExtraBlocks.push_back(IfConv.TBB);
+  unsigned ResLength = FBBTrace.getResourceLength(ExtraBlocks);
+
+  unsigned SelectCycles = 0;
+  for (unsigned i = 0, e = IfConv.PHIs.size(); i != e; ++i) {
+    SSAIfConv::PHIInfo &PI = IfConv.PHIs[i];
+    SelectCycles += std::max(0, std::max(PI.CondCycles,
+                                         std::max(PI.TCycles, PI.FCycles)));
+  }
+
+  unsigned ExtraCycles = ResLength + SelectCycles - MinLength;
+  DEBUG(dbgs() << "Resource length " << ResLength << ", shortest path "
+               << MinLength << ", selects " << SelectCycles << '\n');
+  if (ExtraCycles > SchedModel.MispredictPenalty) {
+    DEBUG(dbgs() << "Adds " << ExtraCycles << " cycles, more than "
+                 << SchedModel.MispredictPenalty << '\n');
+    return false;
+  }
+
+  return true;
+}
+
 /// Apply cost model and heuristics to the if-conversion in IfConv.
 /// Return true if the conversion is a good idea.
 ///
@@ -681,6 +717,9 @@ bool EarlyIfConverter::shouldConvertIf() {
   if (!MinInstr)
     MinInstr = Traces->getEnsemble(MachineTraceMetrics::TS_MinInstrCount);
 
+  if (InOrderCost)
+    return shouldConvertIfInOrder();
+
   MachineTraceMetrics::Trace TBBTrace = MinInstr->getTrace(IfConv.getTPred());
   MachineTraceMetrics::Trace FBBTrace = MinInstr->getTrace(IfConv.getFPred());
   DEBUG(dbgs() << "TBB: " << TBBTrace << "FBB: " << FBBTrace);
@@ -784,6 +823,7 @@ bool EarlyIfConverter::runOnMachineFunction(MachineFunction &MF) {
   TII = STI.getInstrInfo();
   TRI = STI.getRegisterInfo();
   SchedModel = STI.getSchedModel();
+  InOrderCost = STI.enableInOrderEarlyIfConversionCost();
   MRI = &MF.getRegInfo();
   DomTree = &getAnalysis<MachineDominatorTree>();
   Loops = getAnalysisIfAvailable<MachineLoopInfo>();
@@ -2743,6 +2743,20 @@ SDValue DAGTypeLegalizer::WidenVecOp_CONCAT_VECTORS(SDNode *N) {
   // legal vector of the same size. Replace the concatenate vector with a
   // nasty build vector.
   EVT VT = N->getValueType(0);
+
+  // If the widened first operand is the same type as the result and all the
+  // other operands are undef, just use the widened operand.
+  if (getTypeAction(N->getOperand(0).getValueType()) ==
+      TargetLowering::TypeWidenVector) {
+    SDValue InOp = GetWidenedVector(N->getOperand(0));
+    bool RestUndef = true;
+    for (unsigned i = 1, e = N->getNumOperands(); i != e; ++i)
+      if (N->getOperand(i).getOpcode() != ISD::UNDEF)
+        RestUndef = false;
+    if (RestUndef && InOp.getValueType() == VT)
+      return InOp;
+  }
+
   EVT EltVT = VT.getVectorElementType();
   SDLoc dl(N);
   unsigned NumElts = VT.getVectorNumElements();
@@ -26,6 +26,10 @@ class NyuziTargetMachine;
 class formatted_raw_ostream;
 
 FunctionPass *createNyuziISelDag(NyuziTargetMachine &TM);
+FunctionPass *createNyuziMemBarMergePass();
+FunctionPass *createNyuziGatherScatterFormationPass();
+FunctionPass *createNyuziLoopPrefetchPass();
+FunctionPass *createNyuziCFIFixupPass();
 
 } // end namespace llvm;
 
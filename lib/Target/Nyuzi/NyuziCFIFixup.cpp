@@ -0,0 +1,205 @@
+//===-- NyuziCFIFixup.cpp - Correct CFI at block boundaries ---------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// CFI directives describe the frame at each point in the order the code is
+// laid out, but the frame state depends on the path taken to get there. The
+// stack frame is only set up on the paths that need it (see
+// NyuziFrameLowering), and its epilogues can be in the middle of the function,
+// so a block may be laid out after one that has a different frame state at
+// its end. For example, a block that uses the frame may follow a return
+// block that has torn it down.
+//
+// This runs after block placement. It computes the frame state at the start
+// of each block from its predecessors, then inserts directives at the start
+// of any block where that differs from the state that the block before it in
+// the layout leaves behind.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "nyuzi-cfi-fixup"
+#include "Nyuzi.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineFunction.h"
+#include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/MC/MCContext.h"
+#include "llvm/MC/MCDwarf.h"
+#include "llvm/MC/MCRegisterInfo.h"
+#include "llvm/Target/TargetInstrInfo.h"
+#include "llvm/Target/TargetSubtargetInfo.h"
+#include <map>
+using namespace llvm;
+
+STATISTIC(NumStateChanges, "Number of CFI state changes inserted");
+
+namespace {
+// The canonical frame address rule and the locations of saved registers
+struct CFIState {
+  unsigned CFAReg;
+  int CFAOffset;
+  std::map<unsigned, int> SavedRegs;
+
+  bool operator==(const CFIState &Other) const {
+    return CFAReg == Other.CFAReg && CFAOffset == Other.CFAOffset &&
+           SavedRegs == Other.SavedRegs;
+  }
+
+  bool operator!=(const CFIState &Other) const { return !(*this == Other); }
+};
+
+class NyuziCFIFixup : public MachineFunctionPass {
+public:
+  static char ID;
+
+  NyuziCFIFixup() : MachineFunctionPass(ID) {}
+
+  virtual bool runOnMachineFunction(MachineFunction &MF) override;
+
+  virtual const char *getPassName() const override {
+    return "Nyuzi CFI fixup";
+  }
+
+private:
+  void applyCFI(const MachineBasicBlock &MBB, CFIState &State) const;
+  void changeState(MachineBasicBlock &MBB, const CFIState &From,
+                   const CFIState &To) const;
+  void buildCFI(MachineBasicBlock &MBB, MachineBasicBlock::iterator MBBI,
+                const MCCFIInstruction &CFI) const;
+
+  MachineFunction *MF;
+};
+
+char NyuziCFIFixup::ID = 0;
+} // namespace
+
+FunctionPass *llvm::createNyuziCFIFixupPass() { return new NyuziCFIFixup(); }
+
+// Update State with the directives in MBB
+void NyuziCFIFixup::applyCFI(const MachineBasicBlock &MBB,
+                             CFIState &State) const {
+  const std::vector<MCCFIInstruction> &Instrs =
+      MF->getMMI().getFrameInstructions();
+  for (const MachineInstr &MI : MBB) {
+    if (!MI.isCFIInstruction())
+      continue;
+
+    const MCCFIInstruction &CFI = Instrs[MI.getOperand(0).getCFIIndex()];
+    switch (CFI.getOperation()) {
+    case MCCFIInstruction::OpDefCfa:
+      State.CFAReg = CFI.getRegister();
+      State.CFAOffset = CFI.getOffset();
+      break;
+    case MCCFIInstruction::OpDefCfaRegister:
+      State.CFAReg = CFI.getRegister();
+      break;
+    case MCCFIInstruction::OpDefCfaOffset:
+      State.CFAOffset = CFI.getOffset();
+      break;
+    case MCCFIInstruction::OpOffset:
+      State.SavedRegs[CFI.getRegister()] = CFI.getOffset();
+      break;
+    case MCCFIInstruction::OpRestore:
+      State.SavedRegs.erase(CFI.getRegister());
+      break;
+    default:
+      llvm_unreachable("unexpected CFI instruction");
+    }
+  }
+}
+
+void NyuziCFIFixup::buildCFI(MachineBasicBlock &MBB,
+                             MachineBasicBlock::iterator MBBI,
+                             const MCCFIInstruction &CFI) const {
+  const TargetInstrInfo &TII = *MF->getSubtarget().getInstrInfo();
+  BuildMI(MBB, MBBI, DebugLoc(), TII.get(TargetOpcode::CFI_INSTRUCTION))
+      .addCFIIndex(MF->getMMI().addFrameInst(CFI));
+}
+
+// Insert directives at the start of MBB that change the state From to To.
+// The MCCFIInstruction factories negate CFA offsets, so they are negated here
+// as well.
+void NyuziCFIFixup::changeState(MachineBasicBlock &MBB, const CFIState &From,
+                                const CFIState &To) const {
+  MachineBasicBlock::iterator MBBI = MBB.begin();
+  for (const auto &Reg : To.SavedRegs) {
+    auto FromReg = From.SavedRegs.find(Reg.first);
+    if (FromReg == From.SavedRegs.end() || FromReg->second != Reg.second)
+      buildCFI(MBB, MBBI,
+               MCCFIInstruction::createOffset(nullptr, Reg.first, Reg.second));
+  }
+
+  for (const auto &Reg : From.SavedRegs) {
+    if (!To.SavedRegs.count(Reg.first))
+      buildCFI(MBB, MBBI, MCCFIInstruction::createRestore(nullptr, Reg.first));
+  }
+
+  if (From.CFAReg != To.CFAReg && From.CFAOffset != To.CFAOffset)
+    buildCFI(MBB, MBBI, MCCFIInstruction::createDefCfa(nullptr, To.CFAReg,
+                                                       -To.CFAOffset));
+  else if (From.CFAReg != To.CFAReg)
+    buildCFI(MBB, MBBI,
+             MCCFIInstruction::createDefCfaRegister(nullptr, To.CFAReg));
+  else if (From.CFAOffset != To.CFAOffset)
+    buildCFI(MBB, MBBI,
+             MCCFIInstruction::createDefCfaOffset(nullptr, -To.CFAOffset));
+
+  ++NumStateChanges;
+}
+
+bool NyuziCFIFixup::runOnMachineFunction(MachineFunction &Fn) {
+  MF = &Fn;
+  const MCRegisterInfo *MRI = MF->getMMI().getContext().getRegisterInfo();
+  CFIState Initial;
+  Initial.CFAReg = MRI->getDwarfRegNum(Nyuzi::SP_REG, true);
+  Initial.CFAOffset = 0;
+
+  // Find the state at the start and end of each block by walking the control
+  // flow graph. All predecessors of a block have the same state at their
+  // ends, so the first one found is used.
+  unsigned NumBlocks = MF->getNumBlockIDs();
+  std::vector<CFIState> InState(NumBlocks, Initial);
+  std::vector<CFIState> OutState(NumBlocks, Initial);
+  std::vector<bool> Visited(NumBlocks, false);
+  SmallVector<MachineBasicBlock *, 16> Worklist(1, &MF->front());
+  Visited[MF->front().getNumber()] = true;
+  while (!Worklist.empty()) {
+    MachineBasicBlock *MBB = Worklist.pop_back_val();
+    CFIState State = InState[MBB->getNumber()];
+    applyCFI(*MBB, State);
+    OutState[MBB->getNumber()] = State;
+    for (auto SI = MBB->succ_begin(), SE = MBB->succ_end(); SI != SE; ++SI) {
+      if (Visited[(*SI)->getNumber()])
+        continue;
+
+      Visited[(*SI)->getNumber()] = true;
+      InState[(*SI)->getNumber()] = State;
+      Worklist.push_back(*SI);
+    }
+  }
+
+  bool Changed = false;
+  CFIState Current = Initial;
+  for (MachineBasicBlock &MBB : *MF) {
+    if (!Visited[MBB.getNumber()]) {
+      applyCFI(MBB, Current);
+      continue;
+    }
+
+    const CFIState &Expected = InState[MBB.getNumber()];
+    if (Current != Expected) {
+      changeState(MBB, Current, Expected);
+      Changed = true;
+    }
+
+    Current = OutState[MBB.getNumber()];
+  }
+
+  return Changed;
+}
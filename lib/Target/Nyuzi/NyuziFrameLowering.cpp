@@ -11,6 +11,16 @@
 // This file contains the Nyuzi implementation of TargetFrameLowering
 // class.
 //
+// Many functions return early after a check, without making calls or
+// touching callee saved registers. The stack frame is only set up on the path
+// that needs it: chooseSaveBlocks walks down from the entry block while only
+// one successor leads to code that uses the frame, and the prologue and callee
+// saved register spills are placed in the block where that walk stops.
+// Registers are restored and the frame is torn down in return blocks reached
+// from there, and at the end of blocks that branch back to a path that never
+// set up the frame. Callee saved vector registers take 64 bytes each to save,
+// so they use a separate walk that starts from the frame setup block.
+//
 //===----------------------------------------------------------------------===//
 
 #include "NyuziFrameLowering.h"
@@ -30,12 +40,264 @@
 
 using namespace llvm;
 
+static cl::opt<bool> EnableShrinkWrap(
+    "nyuzi-shrink-wrap", cl::Hidden, cl::init(true),
+    cl::desc("Only set up the stack frame on paths that need it"));
+
 const NyuziFrameLowering *NyuziFrameLowering::create(const NyuziSubtarget &ST) {
   return new NyuziFrameLowering(ST);
 }
 
+// Collect every block reachable from Start without going through a block in
+// Avoid, including Start itself (unless it is in Avoid).
+static void getReachable(MachineBasicBlock *Start,
+                         SmallPtrSetImpl<MachineBasicBlock *> &Reachable,
+                         const SmallPtrSetImpl<MachineBasicBlock *> &Avoid) {
+  SmallVector<MachineBasicBlock *, 16> Worklist(1, Start);
+  while (!Worklist.empty()) {
+    MachineBasicBlock *MBB = Worklist.pop_back_val();
+    if (!Avoid.count(MBB) && Reachable.insert(MBB).second)
+      Worklist.append(MBB->succ_begin(), MBB->succ_end());
+  }
+}
+
+// Collect the blocks that run after Save, up to where control flow joins a
+// path from the entry block that doesn't go through Save.
+static void getSaveRegion(MachineBasicBlock *Save,
+                          SmallPtrSetImpl<MachineBasicBlock *> &Region) {
+  SmallPtrSet<MachineBasicBlock *, 16> Bypass;
+  SmallPtrSet<MachineBasicBlock *, 1> SaveOnly;
+  SaveOnly.insert(Save);
+  getReachable(&Save->getParent()->front(), Bypass, SaveOnly);
+  getReachable(Save, Region, Bypass);
+}
+
+// Check if MBB references a stack slot (when CheckFrameIndices is set) or
+// reads, writes, or clobbers any register in Regs. Returns are ignored: they
+// run after the epilogue.
+static bool usesRegsOrFrame(const MachineBasicBlock &MBB, const BitVector &Regs,
+                            bool CheckFrameIndices) {
+  for (const MachineInstr &MI : MBB) {
+    if (MI.isDebugValue() || MI.isReturn())
+      continue;
+
+    for (const MachineOperand &MO : MI.operands()) {
+      if (MO.isFI() && CheckFrameIndices)
+        return true;
+
+      if (MO.isReg() && MO.getReg() && Regs.test(MO.getReg()))
+        return true;
+
+      if (MO.isRegMask()) {
+        for (int Reg = Regs.find_first(); Reg != -1; Reg = Regs.find_next(Reg))
+          if (MO.clobbersPhysReg(Reg))
+            return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+//
+// Check that Save can set up the state needed by the blocks in Needs. Save must
+// not be in a loop, and each block that leaves its region without returning
+// must have a single successor, so registers can be restored before it
+// branches out (see emitRegionExits).
+//
+static bool
+isValidSaveRegion(MachineBasicBlock *Save,
+                  const SmallPtrSetImpl<MachineBasicBlock *> &Region,
+                  const SmallPtrSetImpl<MachineBasicBlock *> &Needs) {
+  for (MachineBasicBlock *MBB : Needs)
+    if (!Region.count(MBB))
+      return false;
+
+  SmallPtrSet<MachineBasicBlock *, 16> Reachable;
+  SmallPtrSet<MachineBasicBlock *, 1> Avoid;
+  for (auto SI = Save->succ_begin(), SE = Save->succ_end(); SI != SE; ++SI)
+    getReachable(*SI, Reachable, Avoid);
+
+  if (Reachable.count(Save))
+    return false;
+
+  for (MachineBasicBlock *MBB : Region) {
+    for (auto SI = MBB->succ_begin(), SE = MBB->succ_end(); SI != SE; ++SI) {
+      if (Region.count(*SI))
+        continue;
+
+      MachineBasicBlock::iterator Term = MBB->getFirstTerminator();
+      if (MBB->succ_size() != 1 ||
+          (Term != MBB->end() && !Term->isUnconditionalBranch()))
+        return false;
+    }
+  }
+
+  return true;
+}
+
+//
+// Walk down from Start while it doesn't need the state being saved and
+// exactly one successor leads to a block in Needs, stopping at the first
+// successor that isn't a valid save point. Region is set to the blocks that
+// run with the state saved.
+//
+static MachineBasicBlock *
+findSaveBlock(MachineBasicBlock *Start,
+              const SmallPtrSetImpl<MachineBasicBlock *> &Needs,
+              SmallPtrSetImpl<MachineBasicBlock *> &Region) {
+  MachineBasicBlock *Save = Start;
+  getSaveRegion(Save, Region);
+  while (!Needs.count(Save)) {
+    MachineBasicBlock *Next = nullptr;
+    for (auto SI = Save->succ_begin(), SE = Save->succ_end(); SI != SE; ++SI) {
+      SmallPtrSet<MachineBasicBlock *, 16> Reachable;
+      SmallPtrSet<MachineBasicBlock *, 1> Avoid;
+      getReachable(*SI, Reachable, Avoid);
+      bool ReachesNeed = false;
+      for (MachineBasicBlock *MBB : Reachable)
+        ReachesNeed |= Needs.count(MBB) != 0;
+
+      if (!ReachesNeed)
+        continue;
+
+      if (Next)
+        return Save;
+
+      Next = *SI;
+    }
+
+    if (!Next)
+      return Save;
+
+    SmallPtrSet<MachineBasicBlock *, 16> NextRegion;
+    getSaveRegion(Next, NextRegion);
+    if (!isValidSaveRegion(Next, NextRegion, Needs))
+      return Save;
+
+    Save = Next;
+    Region.clear();
+    Region.insert(NextRegion.begin(), NextRegion.end());
+  }
+
+  return Save;
+}
+
+// Check if A and B are the same epilogue directive
+static bool isSameCFI(const MCCFIInstruction &A, const MCCFIInstruction &B) {
+  if (A.getOperation() != B.getOperation() || A.getLabel() || B.getLabel())
+    return false;
+
+  switch (A.getOperation()) {
+  case MCCFIInstruction::OpDefCfaOffset:
+    return A.getOffset() == B.getOffset();
+  case MCCFIInstruction::OpDefCfaRegister:
+  case MCCFIInstruction::OpRestore:
+    return A.getRegister() == B.getRegister();
+  default:
+    return false;
+  }
+}
+
+// Insert a CFI directive in an epilogue. Identical directives share an
+// index, so epilogues that are otherwise the same can still be tail merged.
+static void buildCFI(MachineBasicBlock &MBB, MachineBasicBlock::iterator MBBI,
+                     const MCCFIInstruction &CFI) {
+  MachineFunction &MF = *MBB.getParent();
+  MachineModuleInfo &MMI = MF.getMMI();
+  const std::vector<MCCFIInstruction> &Instrs = MMI.getFrameInstructions();
+  unsigned Index = 0;
+  while (Index < Instrs.size() && !isSameCFI(Instrs[Index], CFI))
+    ++Index;
+
+  if (Index == Instrs.size())
+    Index = MMI.addFrameInst(CFI);
+
+  const TargetInstrInfo &TII = *MF.getSubtarget().getInstrInfo();
+  DebugLoc DL = MBBI != MBB.end() ? MBBI->getDebugLoc() : DebugLoc();
+  BuildMI(MBB, MBBI, DL, TII.get(TargetOpcode::CFI_INSTRUCTION))
+      .addCFIIndex(Index);
+}
+
+// Reload callee saved registers before InsertPt, in the opposite order of the
+// spills, and emit .cfi_restore directives for them (debug information).
+static void restoreRegs(MachineBasicBlock &MBB,
+                        MachineBasicBlock::iterator InsertPt,
+                        const std::vector<CalleeSavedInfo> &CSI,
+                        bool RestoreScalars, bool RestoreVectors) {
+  MachineFunction &MF = *MBB.getParent();
+  const TargetInstrInfo &TII = *MF.getSubtarget().getInstrInfo();
+  const TargetRegisterInfo *TRI = MF.getSubtarget().getRegisterInfo();
+  const MCRegisterInfo *MRI = MF.getMMI().getContext().getRegisterInfo();
+  SmallVector<unsigned, 16> Restored;
+  for (auto I = CSI.rbegin(), E = CSI.rend(); I != E; ++I) {
+    unsigned Reg = I->getReg();
+    if (!(Nyuzi::VR512RegClass.contains(Reg) ? RestoreVectors
+                                             : RestoreScalars))
+      continue;
+
+    TII.loadRegFromStackSlot(MBB, InsertPt, Reg, I->getFrameIdx(),
+                             TRI->getMinimalPhysRegClass(Reg), TRI);
+    Restored.push_back(Reg);
+  }
+
+  for (unsigned Reg : Restored)
+    buildCFI(MBB, InsertPt, MCCFIInstruction::createRestore(
+                                nullptr, MRI->getDwarfRegNum(Reg, true)));
+}
+
+void NyuziFrameLowering::chooseSaveBlocks(MachineFunction &MF) const {
+  NyuziMachineFunctionInfo *VFI = MF.getInfo<NyuziMachineFunctionInfo>();
+  MachineBasicBlock *Entry = &MF.front();
+  VFI->setSaveBlock(Entry);
+  VFI->setVectorSaveBlock(Entry);
+  VFI->getFrameBlocks().clear();
+  VFI->getVectorBlocks().clear();
+  getSaveRegion(Entry, VFI->getFrameBlocks());
+  getSaveRegion(Entry, VFI->getVectorBlocks());
+  if (!EnableShrinkWrap)
+    return;
+
+  // The unwinder expects the frame to be set up in landing pads.
+  for (const MachineBasicBlock &MBB : MF)
+    if (MBB.isLandingPad())
+      return;
+
+  const TargetRegisterInfo *TRI = MF.getSubtarget().getRegisterInfo();
+  BitVector FrameRegs(TRI->getNumRegs());
+  BitVector VectorRegs(TRI->getNumRegs());
+  for (const uint16_t *R = TRI->getCalleeSavedRegs(&MF); *R; ++R) {
+    FrameRegs.set(*R);
+    if (Nyuzi::VR512RegClass.contains(*R))
+      VectorRegs.set(*R);
+  }
+
+  FrameRegs.set(Nyuzi::SP_REG);
+  FrameRegs.set(Nyuzi::FP_REG);
+
+  SmallPtrSet<MachineBasicBlock *, 16> NeedsFrame;
+  SmallPtrSet<MachineBasicBlock *, 16> NeedsVectors;
+  for (MachineBasicBlock &MBB : MF) {
+    if (usesRegsOrFrame(MBB, FrameRegs, true))
+      NeedsFrame.insert(&MBB);
+
+    if (usesRegsOrFrame(MBB, VectorRegs, false))
+      NeedsVectors.insert(&MBB);
+  }
+
+  VFI->getFrameBlocks().clear();
+  VFI->getVectorBlocks().clear();
+  MachineBasicBlock *Save =
+      findSaveBlock(Entry, NeedsFrame, VFI->getFrameBlocks());
+  VFI->setSaveBlock(Save);
+  VFI->setVectorSaveBlock(
+      findSaveBlock(Save, NeedsVectors, VFI->getVectorBlocks()));
+}
+
 void NyuziFrameLowering::emitPrologue(MachineFunction &MF) const {
-  MachineBasicBlock &MBB = MF.front();
+  NyuziMachineFunctionInfo *VFI = MF.getInfo<NyuziMachineFunctionInfo>();
+  MachineBasicBlock &MBB =
+      VFI->getSaveBlock() ? *VFI->getSaveBlock() : MF.front();
   MachineFrameInfo *MFI = MF.getFrameInfo();
   const NyuziInstrInfo &TII =
       *static_cast<const NyuziInstrInfo *>(MF.getSubtarget().getInstrInfo());
@@ -44,6 +306,8 @@ void NyuziFrameLowering::emitPrologue(MachineFunction &MF) const {
   MachineBasicBlock::iterator MBBI = MBB.begin();
   DebugLoc DL = MBBI != MBB.end() ? MBBI->getDebugLoc() : DebugLoc();
 
+  emitRegionExits(MF);
+
   // Compute stack size. Allocate space, keeping SP 64 byte aligned so we
   // can do block vector load/stores
   int StackSize = RoundUpToAlignment(MFI->getStackSize(), getStackAlignment()); 
@@ -59,30 +323,15 @@ void NyuziFrameLowering::emitPrologue(MachineFunction &MF) const {
   BuildMI(MBB, MBBI, DL, TII.get(TargetOpcode::CFI_INSTRUCTION))
       .addCFIIndex(CFIIndex);
 
-  // Find the instruction past the last instruction that saves a callee-saved
-  // register to the stack.  We need to set up FP after its old value has been
-  // saved.
-  const std::vector<CalleeSavedInfo> &CSI = MFI->getCalleeSavedInfo();
-  if (CSI.size()) {
-    for (unsigned i = 0; i < CSI.size(); ++i)
-      ++MBBI;
-
-    // Iterate over list of callee-saved registers and emit .cfi_offset
-    // directives (debug information)
-    for (const auto &I : CSI) {
-      int64_t Offset = MFI->getObjectOffset(I.getFrameIdx());
-      unsigned Reg = I.getReg();
-      unsigned CFIIndex = MMI.addFrameInst(MCCFIInstruction::createOffset(
-          nullptr, MRI->getDwarfRegNum(Reg, 1), Offset));
-      BuildMI(MBB, MBBI, DL, TII.get(TargetOpcode::CFI_INSTRUCTION))
-          .addCFIIndex(CFIIndex);
-    }
-  }
+  // Skip past the instructions that save callee-saved registers to the stack
+  // (see spillCalleeSavedRegisters).  We need to set up FP after its old value
+  // has been saved.
+  while (MBBI != MBB.end() && MBBI->getFlag(MachineInstr::FrameSetup))
+    ++MBBI;
 
   // fp = sp
   if (hasFP(MF)) {
-    BuildMI(MBB, MBBI, DL, TII.get(Nyuzi::MOVESS))
-        .addReg(Nyuzi::FP_REG)
+    BuildMI(MBB, MBBI, DL, TII.get(Nyuzi::MOVESS), Nyuzi::FP_REG)
         .addReg(Nyuzi::SP_REG);
 
     // emit ".cfi_def_cfa_register $fp" (debug information)
@@ -96,23 +345,73 @@ void NyuziFrameLowering::emitPrologue(MachineFunction &MF) const {
 void NyuziFrameLowering::emitEpilogue(MachineFunction &MF,
                                            MachineBasicBlock &MBB) const {
   MachineBasicBlock::iterator MBBI = MBB.getLastNonDebugInstr();
+  assert(MBBI->isReturn() &&
+         "Can only put epilog before a return or tail call!");
+
+  // Returns on paths that never set up the frame don't need to tear it down.
+  NyuziMachineFunctionInfo *VFI = MF.getInfo<NyuziMachineFunctionInfo>();
+  if (!VFI->getFrameBlocks().count(&MBB))
+    return;
+
+  insertEpilogue(MF, MBB, MBBI);
+}
+
+// Restore callee saved registers and tear down the frame at the end of blocks
+// that leave the region that has them set up without returning.
+void NyuziFrameLowering::emitRegionExits(MachineFunction &MF) const {
+  NyuziMachineFunctionInfo *VFI = MF.getInfo<NyuziMachineFunctionInfo>();
+  const std::vector<CalleeSavedInfo> &CSI =
+      MF.getFrameInfo()->getCalleeSavedInfo();
+  for (MachineBasicBlock &MBB : MF) {
+    if (MBB.succ_size() != 1)
+      continue;
+
+    MachineBasicBlock *Succ = *MBB.succ_begin();
+    bool ExitsFrame =
+        VFI->getFrameBlocks().count(&MBB) && !VFI->getFrameBlocks().count(Succ);
+    bool ExitsVectors = VFI->getVectorBlocks().count(&MBB) &&
+                        !VFI->getVectorBlocks().count(Succ);
+    if (!ExitsFrame && !ExitsVectors)
+      continue;
+
+    MachineBasicBlock::iterator InsertPt = MBB.getFirstTerminator();
+    restoreRegs(MBB, InsertPt, CSI, ExitsFrame, ExitsVectors);
+    if (ExitsFrame)
+      insertEpilogue(MF, MBB, InsertPt);
+  }
+}
+
+void NyuziFrameLowering::insertEpilogue(MachineFunction &MF,
+                                        MachineBasicBlock &MBB,
+                                        MachineBasicBlock::iterator MBBI) const {
   MachineFrameInfo *MFI = MF.getFrameInfo();
   const NyuziInstrInfo &TII =
       *static_cast<const NyuziInstrInfo *>(MF.getSubtarget().getInstrInfo());
-  DebugLoc DL = MBBI->getDebugLoc();
-  assert(MBBI->getOpcode() == Nyuzi::RET &&
-         "Can only put epilog before 'retl' instruction!");
+  const MCRegisterInfo *MRI = MF.getMMI().getContext().getRegisterInfo();
+  DebugLoc DL = MBBI != MBB.end() ? MBBI->getDebugLoc() : DebugLoc();
 
   // if framepointer enabled, restore the stack pointer.
   if (hasFP(MF)) {
     // Find the first instruction that restores a callee-saved register.
+    const std::vector<CalleeSavedInfo> &CSI = MFI->getCalleeSavedInfo();
     MachineBasicBlock::iterator I = MBBI;
-    for (unsigned i = 0; i < MFI->getCalleeSavedInfo().size(); ++i)
+    int FI;
+    while (I != MBB.begin() &&
+           (std::prev(I)->isCFIInstruction() ||
+            (TII.isLoadFromStackSlot(std::prev(I), FI) &&
+             std::any_of(CSI.begin(), CSI.end(),
+                         [FI](const CalleeSavedInfo &Info) {
+                           return Info.getFrameIdx() == FI;
+                         }))))
       --I;
 
-    BuildMI(MBB, I, DL, TII.get(Nyuzi::MOVESS))
-        .addReg(Nyuzi::SP_REG)
+    BuildMI(MBB, I, DL, TII.get(Nyuzi::MOVESS), Nyuzi::SP_REG)
         .addReg(Nyuzi::FP_REG);
+
+    // emit ".cfi_def_cfa_register $sp" (debug information). fp is about to
+    // be reloaded, but has the same value as sp until then.
+    buildCFI(MBB, I, MCCFIInstruction::createDefCfaRegister(
+                         nullptr, MRI->getDwarfRegNum(Nyuzi::SP_REG, true)));
   }
 
   uint64_t StackSize = RoundUpToAlignment(MFI->getStackSize(), getStackAlignment());
@@ -120,6 +419,9 @@ void NyuziFrameLowering::emitEpilogue(MachineFunction &MF,
     return;
 
   TII.adjustStackPointer(MBB, MBBI, StackSize);
+
+  // emit ".cfi_def_cfa_offset 0" (debug information)
+  buildCFI(MBB, MBBI, MCCFIInstruction::createDefCfaOffset(nullptr, 0));
 }
 
 // Returns true if the prologue inserter should reserve space for outgoing arguments 
@@ -198,6 +500,8 @@ uint64_t NyuziFrameLowering::getWorstCaseStackSize(const MachineFunction &MF) co
 
 void NyuziFrameLowering::processFunctionBeforeCalleeSavedScan(
     MachineFunction &MF, RegScavenger *RS) const {
+  chooseSaveBlocks(MF);
+
   if (hasFP(MF))
     MF.getRegInfo().setPhysRegUsed(Nyuzi::FP_REG);
 
@@ -215,3 +519,70 @@ void NyuziFrameLowering::processFunctionBeforeCalleeSavedScan(
                                                 RC->getAlignment(), false);
   RS->addScavengingFrameIndex(FI);
 }
+
+bool NyuziFrameLowering::spillCalleeSavedRegisters(
+    MachineBasicBlock &EntryMBB, MachineBasicBlock::iterator MI,
+    const std::vector<CalleeSavedInfo> &CSI,
+    const TargetRegisterInfo *TRI) const {
+  MachineFunction &MF = *EntryMBB.getParent();
+  MachineFrameInfo *MFI = MF.getFrameInfo();
+  const TargetInstrInfo &TII = *MF.getSubtarget().getInstrInfo();
+  NyuziMachineFunctionInfo *VFI = MF.getInfo<NyuziMachineFunctionInfo>();
+  MachineModuleInfo &MMI = MF.getMMI();
+  const MCRegisterInfo *MRI = MMI.getContext().getRegisterInfo();
+
+  for (const auto &I : CSI) {
+    unsigned Reg = I.getReg();
+    MachineBasicBlock *MBB = Nyuzi::VR512RegClass.contains(Reg)
+                                 ? VFI->getVectorSaveBlock()
+                                 : VFI->getSaveBlock();
+    if (!MBB)
+      MBB = &EntryMBB;
+
+    // The register is live in to every block on a path to where it is saved.
+    SmallPtrSet<MachineBasicBlock *, 16> Visited;
+    SmallVector<MachineBasicBlock *, 16> Worklist(1, MBB);
+    while (!Worklist.empty()) {
+      MachineBasicBlock *LiveMBB = Worklist.pop_back_val();
+      if (!Visited.insert(LiveMBB).second)
+        continue;
+
+      if (!LiveMBB->isLiveIn(Reg))
+        LiveMBB->addLiveIn(Reg);
+
+      Worklist.append(LiveMBB->pred_begin(), LiveMBB->pred_end());
+    }
+
+    // Insert after any spills already in this block, and emit .cfi_offset
+    // directives (debug information)
+    MachineBasicBlock::iterator InsertPt = MBB->begin();
+    while (InsertPt != MBB->end() &&
+           InsertPt->getFlag(MachineInstr::FrameSetup))
+      ++InsertPt;
+
+    DebugLoc DL = InsertPt != MBB->end() ? InsertPt->getDebugLoc() : DebugLoc();
+    TII.storeRegToStackSlot(*MBB, InsertPt, Reg, true, I.getFrameIdx(),
+                            TRI->getMinimalPhysRegClass(Reg), TRI);
+    std::prev(InsertPt)->setFlag(MachineInstr::FrameSetup);
+
+    int64_t Offset = MFI->getObjectOffset(I.getFrameIdx());
+    unsigned CFIIndex = MMI.addFrameInst(MCCFIInstruction::createOffset(
+        nullptr, MRI->getDwarfRegNum(Reg, 1), Offset));
+    BuildMI(*MBB, InsertPt, DL, TII.get(TargetOpcode::CFI_INSTRUCTION))
+        .addCFIIndex(CFIIndex)
+        .setMIFlag(MachineInstr::FrameSetup);
+  }
+
+  return true;
+}
+
+bool NyuziFrameLowering::restoreCalleeSavedRegisters(
+    MachineBasicBlock &MBB, MachineBasicBlock::iterator MI,
+    const std::vector<CalleeSavedInfo> &CSI,
+    const TargetRegisterInfo *TRI) const {
+  NyuziMachineFunctionInfo *VFI =
+      MBB.getParent()->getInfo<NyuziMachineFunctionInfo>();
+  restoreRegs(MBB, MI, CSI, VFI->getFrameBlocks().count(&MBB),
+              VFI->getVectorBlocks().count(&MBB));
+  return true;
+}
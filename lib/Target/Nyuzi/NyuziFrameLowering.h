@@ -31,11 +31,25 @@ public:
                                     		 MachineBasicBlock::iterator I) const override;
   virtual void processFunctionBeforeCalleeSavedScan(MachineFunction &MF,
                                                     RegScavenger *RS) const override;
+  virtual bool
+  spillCalleeSavedRegisters(MachineBasicBlock &MBB,
+                            MachineBasicBlock::iterator MI,
+                            const std::vector<CalleeSavedInfo> &CSI,
+                            const TargetRegisterInfo *TRI) const override;
+  virtual bool
+  restoreCalleeSavedRegisters(MachineBasicBlock &MBB,
+                              MachineBasicBlock::iterator MI,
+                              const std::vector<CalleeSavedInfo> &CSI,
+                              const TargetRegisterInfo *TRI) const override;
   virtual bool hasFP(const MachineFunction &MF) const override;
   virtual bool hasReservedCallFrame(const MachineFunction &MF) const override;
 
 private:
   uint64_t getWorstCaseStackSize(const MachineFunction &MF) const;
+  void chooseSaveBlocks(MachineFunction &MF) const;
+  void emitRegionExits(MachineFunction &MF) const;
+  void insertEpilogue(MachineFunction &MF, MachineBasicBlock &MBB,
+                      MachineBasicBlock::iterator MBBI) const;
 };
 
 } // End llvm namespace
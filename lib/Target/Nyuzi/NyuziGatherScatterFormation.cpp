@@ -0,0 +1,435 @@
+//===-- NyuziGatherScatterFormation.cpp - Form vector memory accesses -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The vectorizers only form vector memory accesses for consecutive addresses.
+// Accesses with a constant stride, or to one field of an array of structures,
+// are left as sixteen scalar loads that are inserted into a vector, or
+// sixteen extracted elements that are stored individually. Each of those lane
+// operations costs an instruction or two on top of the memory access.
+//
+// This pass finds those patterns, where every lane is a constant offset from
+// a common base pointer, and replaces them with a single gather or scatter.
+// If the lanes are a permutation of a 64 byte aligned block, it instead uses a
+// block load or store and a shuffle.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "nyuzi-gather-scatter"
+#include "Nyuzi.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+using namespace llvm;
+
+STATISTIC(NumGathers, "Number of gathers formed from scalar loads");
+STATISTIC(NumScatters, "Number of scatters formed from scalar stores");
+STATISTIC(NumShuffled, "Number of vector accesses formed with a shuffle");
+
+namespace {
+const unsigned kNumLanes = 16;
+
+class NyuziGatherScatterFormation : public FunctionPass {
+public:
+  static char ID;
+
+  NyuziGatherScatterFormation() : FunctionPass(ID), DL(nullptr) {}
+
+  virtual bool runOnFunction(Function &F) override;
+
+  virtual const char *getPassName() const override {
+    return "Nyuzi gather/scatter formation";
+  }
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+private:
+  bool formGathers(BasicBlock &BB);
+  bool formScatters(BasicBlock &BB);
+  Value *getLaneOffsets(ArrayRef<Value *> Ptrs, int64_t Offsets[]);
+  Value *getAddressVector(IRBuilder<> &Builder, Value *Base,
+                          const int64_t Offsets[]);
+
+  const DataLayout *DL;
+};
+
+char NyuziGatherScatterFormation::ID = 0;
+} // namespace
+
+FunctionPass *llvm::createNyuziGatherScatterFormationPass() {
+  return new NyuziGatherScatterFormation();
+}
+
+static bool isVectorOfWords(Type *Ty) {
+  VectorType *VecTy = dyn_cast<VectorType>(Ty);
+  if (!VecTy || VecTy->getNumElements() != kNumLanes)
+    return false;
+
+  Type *ElemTy = VecTy->getElementType();
+  return ElemTy->isIntegerTy(32) || ElemTy->isFloatTy();
+}
+
+// A zero alignment means the ABI alignment of the scalar type. That needs to
+// be explicit on the vector access, which would otherwise assume the
+// alignment of the vector type.
+template <typename AccessInst>
+static unsigned getAlignment(AccessInst *I, const DataLayout *DL) {
+  if (I->getAlignment())
+    return I->getAlignment();
+
+  return DL->getABITypeAlignment(I->getPointerOperand()->getType()
+                                     ->getPointerElementType());
+}
+
+// Find the common base that each pointer is a constant byte offset from, and
+// fill in those offsets. Returns null if there isn't one.
+Value *NyuziGatherScatterFormation::getLaneOffsets(ArrayRef<Value *> Ptrs,
+                                                   int64_t Offsets[]) {
+  Value *Base = nullptr;
+  for (unsigned Lane = 0; Lane < kNumLanes; Lane++) {
+    Value *LaneBase =
+        GetPointerBaseWithConstantOffset(Ptrs[Lane], Offsets[Lane], DL);
+    if (Base && LaneBase != Base)
+      return nullptr;
+
+    Base = LaneBase;
+  }
+
+  return Base;
+}
+
+// Splat the base address and add each lane's offset to it.
+Value *NyuziGatherScatterFormation::getAddressVector(IRBuilder<> &Builder,
+                                                     Value *Base,
+                                                     const int64_t Offsets[]) {
+  Type *Int32Ty = Builder.getInt32Ty();
+  SmallVector<Constant *, 16> OffsetConsts;
+  for (unsigned Lane = 0; Lane < kNumLanes; Lane++)
+    OffsetConsts.push_back(ConstantInt::get(Int32Ty, Offsets[Lane]));
+
+  Value *BaseInt = Builder.CreatePtrToInt(Base, Int32Ty);
+  return Builder.CreateAdd(Builder.CreateVectorSplat(kNumLanes, BaseInt),
+                           ConstantVector::get(OffsetConsts));
+}
+
+// Check if the offsets cover sixteen consecutive words in some order, and if
+// so, set First to the lowest one.
+static bool isPermutedBlock(const int64_t Offsets[], int64_t &First) {
+  First = Offsets[0];
+  for (unsigned Lane = 1; Lane < kNumLanes; Lane++)
+    First = std::min(First, Offsets[Lane]);
+
+  unsigned Covered = 0;
+  for (unsigned Lane = 0; Lane < kNumLanes; Lane++) {
+    int64_t Word = Offsets[Lane] - First;
+    if (Word % 4 != 0 || Word / 4 >= int64_t(kNumLanes))
+      return false;
+
+    Covered |= 1 << (Word / 4);
+  }
+
+  return Covered == 0xffff;
+}
+
+// Return a vector pointer to Base + Offset.
+static Value *getBlockAddress(IRBuilder<> &Builder, Value *Base,
+                              int64_t Offset, Type *VecTy) {
+  unsigned AddrSpace = Base->getType()->getPointerAddressSpace();
+  Value *Addr = Builder.CreateBitCast(Base, Builder.getInt8PtrTy(AddrSpace));
+  if (Offset != 0)
+    Addr = Builder.CreateConstGEP1_64(Addr, Offset);
+
+  return Builder.CreateBitCast(Addr, VecTy->getPointerTo(AddrSpace));
+}
+
+//
+// Look for a chain of insertelements that fills every lane of a vector with
+// a scalar load. All loads must be in this block and there can't be a store
+// between the first load and the point where the vector is complete.
+//
+bool NyuziGatherScatterFormation::formGathers(BasicBlock &BB) {
+  bool Changed = false;
+  for (BasicBlock::iterator I = BB.begin(), E = BB.end(); I != E;) {
+    InsertElementInst *Root = dyn_cast<InsertElementInst>(I++);
+    if (!Root || !isVectorOfWords(Root->getType()))
+      continue;
+
+    // Only start at the last insertelement of a chain.
+    if (Root->hasOneUse() && isa<InsertElementInst>(*Root->user_begin()))
+      continue;
+
+    Value *Ptrs[kNumLanes] = {};
+    LoadInst *Loads[kNumLanes] = {};
+    SmallVector<InsertElementInst *, 16> Chain;
+    Value *Vec = Root;
+    bool Valid = true;
+    while (InsertElementInst *Insert = dyn_cast<InsertElementInst>(Vec)) {
+      ConstantInt *Index = dyn_cast<ConstantInt>(Insert->getOperand(2));
+      LoadInst *Load = dyn_cast<LoadInst>(Insert->getOperand(1));
+      if (!Index || !Load || !Load->isSimple() || !Load->hasOneUse() ||
+          Insert->getParent() != &BB || Load->getParent() != &BB ||
+          Load->getAlignment() % 4 != 0 ||
+          (Insert != Root && !Insert->hasOneUse()) ||
+          Index->getZExtValue() >= kNumLanes) {
+        Valid = false;
+        break;
+      }
+
+      // A later insert to the same lane replaces this one.
+      unsigned Lane = Index->getZExtValue();
+      if (Loads[Lane]) {
+        Valid = false;
+        break;
+      }
+
+      Loads[Lane] = Load;
+      Ptrs[Lane] = Load->getPointerOperand();
+      Chain.push_back(Insert);
+      Vec = Insert->getOperand(0);
+    }
+
+    if (!Valid || !isa<UndefValue>(Vec) || Chain.size() != kNumLanes)
+      continue;
+
+    int64_t Offsets[kNumLanes];
+    Value *Base = getLaneOffsets(Ptrs, Offsets);
+    if (!Base)
+      continue;
+
+    // Make sure nothing writes to memory between the first load and the
+    // point where the combined load will be issued.
+    SmallPtrSet<Instruction *, 16> LoadSet(Loads, Loads + kNumLanes);
+    bool SeenLoad = false;
+    for (BasicBlock::iterator J = BB.begin(); &*J != Root && Valid; ++J) {
+      if (LoadSet.count(&*J))
+        SeenLoad = true;
+      else if (SeenLoad && J->mayWriteToMemory())
+        Valid = false;
+    }
+
+    if (!Valid)
+      continue;
+
+    IRBuilder<> Builder(Root);
+    Type *VecTy = Root->getType();
+    Value *NewVec;
+
+    // A block load is only possible if the first word is 64 byte aligned.
+    // Otherwise it would become a gather, and a gather can load the lanes in
+    // any order without a shuffle.
+    int64_t First;
+    unsigned Align = 0;
+    if (isPermutedBlock(Offsets, First)) {
+      for (unsigned Lane = 0; Lane < kNumLanes; Lane++) {
+        if (Offsets[Lane] == First)
+          Align = getAlignment(Loads[Lane], DL);
+      }
+    }
+
+    if (Align >= 64) {
+      Value *Addr = getBlockAddress(Builder, Base, First, VecTy);
+      NewVec = Builder.CreateAlignedLoad(Addr, Align);
+      SmallVector<Constant *, 16> ShuffleMask;
+      bool IsIdentity = true;
+      for (unsigned Lane = 0; Lane < kNumLanes; Lane++) {
+        unsigned Word = (Offsets[Lane] - First) / 4;
+        ShuffleMask.push_back(Builder.getInt32(Word));
+        IsIdentity &= Word == Lane;
+      }
+
+      if (!IsIdentity) {
+        NewVec = Builder.CreateShuffleVector(
+            NewVec, UndefValue::get(VecTy), ConstantVector::get(ShuffleMask));
+        ++NumShuffled;
+      }
+    } else {
+      Intrinsic::ID Gather = VecTy->getVectorElementType()->isFloatTy()
+                                 ? Intrinsic::nyuzi_gather_loadf
+                                 : Intrinsic::nyuzi_gather_loadi;
+      NewVec = Builder.CreateCall(
+          Intrinsic::getDeclaration(BB.getParent()->getParent(), Gather),
+          getAddressVector(Builder, Base, Offsets));
+      ++NumGathers;
+    }
+
+    Root->replaceAllUsesWith(NewVec);
+    for (InsertElementInst *Insert : Chain)
+      Insert->eraseFromParent();
+
+    for (LoadInst *Load : Loads)
+      Load->eraseFromParent();
+
+    Changed = true;
+  }
+
+  return Changed;
+}
+
+//
+// Look for sixteen stores of extracted elements that cover every lane of a
+// vector. Each lane must be written exactly once, and there can't be any
+// other memory access between the first and last store.
+//
+bool NyuziGatherScatterFormation::formScatters(BasicBlock &BB) {
+  typedef SmallVector<StoreInst *, 16> StoreList;
+  DenseMap<Value *, StoreList> StoresByVector;
+  SmallVector<Value *, 4> Vectors;
+  for (Instruction &I : BB) {
+    StoreInst *Store = dyn_cast<StoreInst>(&I);
+    if (!Store || !Store->isSimple() || Store->getAlignment() % 4 != 0)
+      continue;
+
+    ExtractElementInst *Extract =
+        dyn_cast<ExtractElementInst>(Store->getValueOperand());
+    if (!Extract || !Extract->hasOneUse() ||
+        !isa<ConstantInt>(Extract->getIndexOperand()) ||
+        !isVectorOfWords(Extract->getVectorOperandType()))
+      continue;
+
+    Value *Vec = Extract->getVectorOperand();
+    StoreList &Stores = StoresByVector[Vec];
+    if (Stores.empty())
+      Vectors.push_back(Vec);
+
+    Stores.push_back(Store);
+  }
+
+  bool Changed = false;
+  for (Value *Vec : Vectors) {
+    StoreList &Stores = StoresByVector[Vec];
+    if (Stores.size() != kNumLanes)
+      continue;
+
+    StoreInst *LaneStores[kNumLanes] = {};
+    Value *Ptrs[kNumLanes];
+    bool Valid = true;
+    for (StoreInst *Store : Stores) {
+      ExtractElementInst *Extract =
+          cast<ExtractElementInst>(Store->getValueOperand());
+      uint64_t Lane =
+          cast<ConstantInt>(Extract->getIndexOperand())->getZExtValue();
+      if (Lane >= kNumLanes || LaneStores[Lane]) {
+        Valid = false;
+        break;
+      }
+
+      LaneStores[Lane] = Store;
+      Ptrs[Lane] = Store->getPointerOperand();
+    }
+
+    if (!Valid)
+      continue;
+
+    int64_t Offsets[kNumLanes];
+    Value *Base = getLaneOffsets(Ptrs, Offsets);
+    if (!Base)
+      continue;
+
+    // If two lanes write the same address, the last one must win, which a
+    // scatter doesn't guarantee.
+    for (unsigned i = 0; i < kNumLanes && Valid; i++) {
+      for (unsigned j = i + 1; j < kNumLanes && Valid; j++) {
+        if (Offsets[i] == Offsets[j])
+          Valid = false;
+      }
+    }
+
+    // The stores are combined at the position of the last one. Make sure
+    // nothing else accesses memory in between.
+    SmallPtrSet<Instruction *, 16> StoreSet(Stores.begin(), Stores.end());
+    StoreInst *LastStore = Stores.back();
+    bool SeenStore = false;
+    for (BasicBlock::iterator J = BB.begin(); &*J != LastStore && Valid; ++J) {
+      if (StoreSet.count(&*J))
+        SeenStore = true;
+      else if (SeenStore && J->mayReadOrWriteMemory())
+        Valid = false;
+    }
+
+    if (!Valid)
+      continue;
+
+    IRBuilder<> Builder(LastStore);
+    Type *VecTy = Vec->getType();
+    // Stores are handled the same way as loads (see formGathers).
+    int64_t First;
+    unsigned Align = 0;
+    if (isPermutedBlock(Offsets, First)) {
+      for (unsigned Lane = 0; Lane < kNumLanes; Lane++) {
+        if (Offsets[Lane] == First)
+          Align = getAlignment(LaneStores[Lane], DL);
+      }
+    }
+
+    if (Align >= 64) {
+      Value *Addr = getBlockAddress(Builder, Base, First, VecTy);
+      SmallVector<Constant *, 16> ShuffleMask(kNumLanes);
+      bool IsIdentity = true;
+      for (unsigned Lane = 0; Lane < kNumLanes; Lane++) {
+        unsigned Word = (Offsets[Lane] - First) / 4;
+        ShuffleMask[Word] = Builder.getInt32(Lane);
+        IsIdentity &= Word == Lane;
+      }
+
+      Value *StoreVec = Vec;
+      if (!IsIdentity) {
+        StoreVec = Builder.CreateShuffleVector(
+            Vec, UndefValue::get(VecTy), ConstantVector::get(ShuffleMask));
+        ++NumShuffled;
+      }
+
+      Builder.CreateAlignedStore(StoreVec, Addr, Align);
+    } else {
+      Intrinsic::ID Scatter = VecTy->getVectorElementType()->isFloatTy()
+                                  ? Intrinsic::nyuzi_scatter_storef
+                                  : Intrinsic::nyuzi_scatter_storei;
+      Builder.CreateCall2(
+          Intrinsic::getDeclaration(BB.getParent()->getParent(), Scatter),
+          getAddressVector(Builder, Base, Offsets), Vec);
+      ++NumScatters;
+    }
+
+    for (StoreInst *Store : Stores) {
+      Instruction *Extract = cast<Instruction>(Store->getValueOperand());
+      Store->eraseFromParent();
+      Extract->eraseFromParent();
+    }
+
+    Changed = true;
+  }
+
+  return Changed;
+}
+
+bool NyuziGatherScatterFormation::runOnFunction(Function &F) {
+  if (skipOptnoneFunction(F))
+    return false;
+
+  DL = F.getParent()->getDataLayout();
+  if (!DL)
+    return false;
+
+  bool Changed = false;
+  for (BasicBlock &BB : F) {
+    Changed |= formGathers(BB);
+    Changed |= formScatters(BB);
+  }
+
+  return Changed;
+}
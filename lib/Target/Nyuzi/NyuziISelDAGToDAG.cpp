@@ -37,6 +37,7 @@ public:
 
   // Complex Pattern Selectors (referenced from TableGen'd instruction matching code)
   bool SelectADDRri(SDValue N, SDValue &Base, SDValue &Offset);
+  bool SelectMaskedADDRri(SDValue N, SDValue &Base, SDValue &Offset);
 
   virtual const char *getPassName() const {
     return "Nyuzi DAG->DAG Pattern Instruction Selection";
@@ -46,12 +47,32 @@ public:
 #include "NyuziGenDAGISel.inc"
 
 private:
+  bool selectAddress(SDValue Addr, SDValue &Base, SDValue &Offset,
+                     unsigned OffsetBits);
+
   const NyuziSubtarget &Subtarget;
 };
 } // end anonymous namespace
 
+//
+// Memory instructions take a base register and a signed immediate offset.
+// Unmasked forms have a 15 bit offset field and masked forms have a 10 bit
+// one. Frame index elimination and address arithmetic (ADDISSI) are limited
+// to 13 bits, so unmasked forms use that (see also
+// NyuziTargetLowering::isLegalAddressingMode).
+//
 bool NyuziDAGToDAGISel::SelectADDRri(SDValue Addr, SDValue &Base,
-                                          SDValue &Offset) {
+                                     SDValue &Offset) {
+  return selectAddress(Addr, Base, Offset, 13);
+}
+
+bool NyuziDAGToDAGISel::SelectMaskedADDRri(SDValue Addr, SDValue &Base,
+                                           SDValue &Offset) {
+  return selectAddress(Addr, Base, Offset, 10);
+}
+
+bool NyuziDAGToDAGISel::selectAddress(SDValue Addr, SDValue &Base,
+                                      SDValue &Offset, unsigned OffsetBits) {
   if (FrameIndexSDNode *FIN = dyn_cast<FrameIndexSDNode>(Addr)) {
     Base = CurDAG->getTargetFrameIndex(FIN->getIndex(), MVT::i32);
     Offset = CurDAG->getTargetConstant(0, MVT::i32);
@@ -63,7 +84,7 @@ bool NyuziDAGToDAGISel::SelectADDRri(SDValue Addr, SDValue &Base,
 
   if (Addr.getOpcode() == ISD::ADD) {
     if (ConstantSDNode *CN = dyn_cast<ConstantSDNode>(Addr.getOperand(1))) {
-      if (isInt<13>(CN->getSExtValue())) {
+      if (isIntN(OffsetBits, CN->getSExtValue())) {
         if (FrameIndexSDNode *FIN =
                 dyn_cast<FrameIndexSDNode>(Addr.getOperand(0))) {
           // Constant offset from frame ref.
@@ -85,6 +106,20 @@ SDNode *NyuziDAGToDAGISel::Select(SDNode *N) {
   if (N->isMachineOpcode())
     return nullptr; // Already selected.
 
+  // The address of a field in a stack object is a single lea, rather than an
+  // lea of the object followed by an add. That keeps it rematerializable.
+  if (N->getOpcode() == ISD::ADD) {
+    FrameIndexSDNode *FIN = dyn_cast<FrameIndexSDNode>(N->getOperand(0));
+    ConstantSDNode *CN = dyn_cast<ConstantSDNode>(N->getOperand(1));
+    if (FIN && CN && isInt<13>(CN->getSExtValue())) {
+      SDValue Ops[] = {
+          CurDAG->getTargetFrameIndex(FIN->getIndex(), MVT::i32),
+          CurDAG->getTargetConstant(CN->getSExtValue(), MVT::i32)};
+      return CurDAG->SelectNodeTo(N, Nyuzi::LOAD_EFFECTIVE_ADDR, MVT::i32,
+                                  Ops);
+    }
+  }
+
   return SelectCode(N);
 }
 
@@ -30,6 +30,7 @@
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Debug.h"
@@ -38,6 +39,11 @@ using namespace llvm;
 
 #include "NyuziGenCallingConv.inc"
 
+static cl::opt<bool> PrefetchLoads(
+    "nyuzi-prefetch-loads", cl::Hidden, cl::init(false),
+    cl::desc("Lower data prefetches to byte loads (otherwise they are "
+             "dropped)"));
+
 const NyuziTargetLowering *NyuziTargetLowering::create(const NyuziTargetMachine &TM,
                                                 const NyuziSubtarget &STI) {
  return new NyuziTargetLowering(TM, STI);
@@ -187,6 +193,34 @@ SDValue NyuziTargetLowering::LowerFormalArguments(
   return Chain;
 }
 
+// A call in tail position can branch directly to the callee after the
+// epilogue has run if everything it needs is in registers. Arguments passed
+// on the stack would be written into the frame that is being torn down, and
+// byval and sret arguments point into it. The callee will return directly to
+// this function's caller, so it must preserve at least the registers the
+// caller's convention does. A fastcc function doesn't preserve any vector
+// registers.
+bool NyuziTargetLowering::isEligibleForTailCallOptimization(
+    CCState &CCInfo, TargetLowering::CallLoweringInfo &CLI,
+    MachineFunction &MF) const {
+  if (CCInfo.getNextStackOffset() != 0)
+    return false;
+
+  if (CLI.CallConv == CallingConv::Fast &&
+      MF.getFunction()->getCallingConv() != CallingConv::Fast)
+    return false;
+
+  if (MF.getFunction()->hasStructRetAttr())
+    return false;
+
+  for (const auto &Out : CLI.Outs) {
+    if (Out.Flags.isByVal() || Out.Flags.isSRet())
+      return false;
+  }
+
+  return true;
+}
+
 // Generate code to call a function
 SDValue
 NyuziTargetLowering::LowerCall(TargetLowering::CallLoweringInfo &CLI,
@@ -201,10 +235,6 @@ NyuziTargetLowering::LowerCall(TargetLowering::CallLoweringInfo &CLI,
   CallingConv::ID CallConv = CLI.CallConv;
   bool isVarArg = CLI.IsVarArg;
 
-  // We do not support tail calls. This flag must be cleared in order
-  // to indicate that to subsequent passes.
-  CLI.IsTailCall = false;
-
   MachineFunction &MF = DAG.getMachineFunction();
   MachineFrameInfo *MFI = MF.getFrameInfo();
   const TargetFrameLowering *TFL = MF.getSubtarget().getFrameLowering();
@@ -217,6 +247,27 @@ NyuziTargetLowering::LowerCall(TargetLowering::CallLoweringInfo &CLI,
                  ArgLocs, *DAG.getContext());
   CCInfo.AnalyzeCallOperands(Outs, CC_Nyuzi32);
 
+  // The IR tail marker guarantees the callee doesn't access this function's
+  // stack, so sibling calls only need the checks in
+  // isEligibleForTailCallOptimization. With -tailcallopt, fastcc calls in
+  // tail position are emitted the same way. Callees don't pop their stack
+  // arguments, so a fastcc call that passes any can't be guaranteed to be a
+  // tail call.
+  if (CLI.IsTailCall) {
+    bool IsEligible = isEligibleForTailCallOptimization(CCInfo, CLI, MF);
+    if (!IsEligible && CLI.CS && CLI.CS->isMustTailCall())
+      report_fatal_error("failed to perform tail call elimination on a call "
+                         "site marked musttail");
+
+    if (!IsEligible && MF.getTarget().Options.GuaranteedTailCallOpt &&
+        CallConv == CallingConv::Fast &&
+        MF.getFunction()->getCallingConv() == CallingConv::Fast)
+      report_fatal_error("failed to perform guaranteed tail call "
+                         "optimization on a fastcc call");
+
+    CLI.IsTailCall = IsEligible;
+  }
+
   // Get the size of the outgoing arguments stack space requirement.
   // We always keep the stack pointer 64 byte aligned so we can use block
   // loads/stores for vector arguments
@@ -245,9 +296,11 @@ NyuziTargetLowering::LowerCall(TargetLowering::CallLoweringInfo &CLI,
     ByValArgs.push_back(FIPtr);
   }
 
-  // CALLSEQ_START will decrement the stack to reserve space
-  Chain =
-      DAG.getCALLSEQ_START(Chain, DAG.getIntPtrConstant(ArgsSize, true), DL);
+  // CALLSEQ_START will decrement the stack to reserve space. A tail call
+  // doesn't use any stack space.
+  if (!CLI.IsTailCall)
+    Chain =
+        DAG.getCALLSEQ_START(Chain, DAG.getIntPtrConstant(ArgsSize, true), DL);
 
   SmallVector<std::pair<unsigned, SDValue>, 8> RegsToPass;
   SmallVector<SDValue, 8> MemOpChains;
@@ -351,6 +404,10 @@ NyuziTargetLowering::LowerCall(TargetLowering::CallLoweringInfo &CLI,
   if (InFlag.getNode())
     Ops.push_back(InFlag);
 
+  // The return values of a tail call go directly to this function's caller.
+  if (CLI.IsTailCall)
+    return DAG.getNode(NyuziISD::TAIL_CALL, DL, MVT::Other, Ops);
+
   Chain = DAG.getNode(NyuziISD::CALL, DL, NodeTys, Ops);
   InFlag = Chain.getValue(1);
 
@@ -411,11 +468,26 @@ NyuziTargetLowering::NyuziTargetLowering(const TargetMachine &TM,
   setOperationAction(ISD::SELECT_CC, MVT::v16f32, Custom);
   setOperationAction(ISD::FDIV, MVT::f32, Custom);
   setOperationAction(ISD::FDIV, MVT::v16f32, Custom);
+  setOperationAction(ISD::FSQRT, MVT::v16f32, Custom);
+
+  // Transcendental functions are expanded inline for vectors (see
+  // NyuziMathLowering.cpp).
+  setOperationAction(ISD::FSIN, MVT::v16f32, Custom);
+  setOperationAction(ISD::FCOS, MVT::v16f32, Custom);
+  setOperationAction(ISD::FPOW, MVT::v16f32, Custom);
+  setOperationAction(ISD::FEXP, MVT::v16f32, Custom);
+  setOperationAction(ISD::FEXP2, MVT::v16f32, Custom);
+  setOperationAction(ISD::FLOG, MVT::v16f32, Custom);
+  setOperationAction(ISD::FLOG2, MVT::v16f32, Custom);
+  setOperationAction(ISD::FLOG10, MVT::v16f32, Custom);
   setOperationAction(ISD::BR_JT, MVT::Other, Custom);
   setOperationAction(ISD::FNEG, MVT::f32, Custom);
   setOperationAction(ISD::FNEG, MVT::v16f32, Custom);
   setOperationAction(ISD::SETCC, MVT::f32, Custom);
   setOperationAction(ISD::SETCC, MVT::v16f32, Custom);
+  setOperationAction(ISD::SETCC, MVT::v16i32, Custom);
+  setOperationAction(ISD::VSELECT, MVT::v16f32, Custom);
+  setOperationAction(ISD::VSELECT, MVT::v16i32, Custom);
   setOperationAction(ISD::CTLZ_ZERO_UNDEF, MVT::i32, Custom);
   setOperationAction(ISD::CTTZ_ZERO_UNDEF, MVT::i32, Custom);
   setOperationAction(ISD::UINT_TO_FP, MVT::i32, Custom);
@@ -425,13 +497,39 @@ NyuziTargetLowering::NyuziTargetLowering(const TargetMachine &TM,
   setOperationAction(ISD::VASTART, MVT::Other, Custom);
   setOperationAction(ISD::FABS,  MVT::f32, Custom);
   setOperationAction(ISD::FABS,  MVT::v16f32, Custom);
+  setOperationAction(ISD::LOAD, MVT::v16i32, Custom);
+  setOperationAction(ISD::LOAD, MVT::v16f32, Custom);
+  setOperationAction(ISD::STORE, MVT::v16i32, Custom);
+  setOperationAction(ISD::STORE, MVT::v16f32, Custom);
+  setOperationAction(ISD::MLOAD, MVT::v16i32, Custom);
+  setOperationAction(ISD::MLOAD, MVT::v16f32, Custom);
+  setOperationAction(ISD::MSTORE, MVT::Other, Custom);
+
+  // Vectors with fewer than 16 elements are widened to a full register. Their
+  // loads and stores are masked, so they only access the live lanes.
+  for (MVT VT : { MVT::v2i32, MVT::v4i32, MVT::v8i32, MVT::v2f32, MVT::v4f32,
+                  MVT::v8f32 }) {
+    setOperationAction(ISD::LOAD, VT, Custom);
+    setOperationAction(ISD::STORE, VT, Custom);
+  }
+
+  // Vectors of 8 and 16 bit elements are promoted to 32 bit elements.
+  for (MVT MemVT : { MVT::v16i8, MVT::v16i16 }) {
+    setLoadExtAction(ISD::EXTLOAD, MVT::v16i32, MemVT, Custom);
+    setLoadExtAction(ISD::ZEXTLOAD, MVT::v16i32, MemVT, Custom);
+    setLoadExtAction(ISD::SEXTLOAD, MVT::v16i32, MemVT, Custom);
+    setTruncStoreAction(MVT::v16i32, MemVT, Custom);
+    setOperationAction(ISD::SIGN_EXTEND_INREG, MemVT, Expand);
+  }
+  setOperationAction(ISD::PREFETCH, MVT::Other, Custom);
+  setOperationAction(ISD::INTRINSIC_WO_CHAIN, MVT::Other, Custom);
 
   setOperationAction(ISD::BR_CC, MVT::i32, Expand);
   setOperationAction(ISD::BR_CC, MVT::f32, Expand);
   setOperationAction(ISD::BRCOND, MVT::i32, Expand);
   setOperationAction(ISD::BRCOND, MVT::f32, Expand);
   setOperationAction(ISD::SIGN_EXTEND_INREG, MVT::i1, Expand);
-  setOperationAction(ISD::CTPOP, MVT::i32, Expand);
+  setOperationAction(ISD::CTPOP, MVT::i32, Custom);
   setOperationAction(ISD::SELECT, MVT::i32, Expand);
   setOperationAction(ISD::SELECT, MVT::f32, Expand);
   setOperationAction(ISD::ROTL, MVT::i32, Expand);
@@ -440,43 +538,90 @@ NyuziTargetLowering::NyuziTargetLowering(const TargetMachine &TM,
   setOperationAction(ISD::SDIVREM, MVT::i32, Expand);
   setOperationAction(ISD::UMUL_LOHI, MVT::i32, Expand);
   setOperationAction(ISD::SMUL_LOHI, MVT::i32, Expand);
-  setOperationAction(ISD::FP_TO_UINT, MVT::i32, Expand);
+  setOperationAction(ISD::FP_TO_UINT, MVT::i32, Custom);
   setOperationAction(ISD::DYNAMIC_STACKALLOC, MVT::i32, Expand);
   setOperationAction(ISD::STACKSAVE, MVT::Other, Expand);
   setOperationAction(ISD::STACKRESTORE, MVT::Other, Expand);
-  setOperationAction(ISD::BSWAP, MVT::i32, Expand);
+  setOperationAction(ISD::BSWAP, MVT::i32, Custom);
   setOperationAction(ISD::ADDC, MVT::i32, Expand);
   setOperationAction(ISD::ADDE, MVT::i32, Expand);
   setOperationAction(ISD::SUBC, MVT::i32, Expand);
   setOperationAction(ISD::SUBE, MVT::i32, Expand);
-  setOperationAction(ISD::SRA_PARTS, MVT::i32, Expand);
-  setOperationAction(ISD::SRL_PARTS, MVT::i32, Expand);
-  setOperationAction(ISD::SHL_PARTS, MVT::i32, Expand);
+  setOperationAction(ISD::SRA_PARTS, MVT::i32, Custom);
+  setOperationAction(ISD::SRL_PARTS, MVT::i32, Custom);
+  setOperationAction(ISD::SHL_PARTS, MVT::i32, Custom);
+  setOperationAction(ISD::ADD, MVT::i64, Custom);
+  setOperationAction(ISD::SUB, MVT::i64, Custom);
   setOperationAction(ISD::VAARG, MVT::Other, Expand);
   setOperationAction(ISD::VACOPY, MVT::Other, Expand);
   setOperationAction(ISD::VAEND, MVT::Other, Expand);
 
-  setOperationAction(ISD::ATOMIC_LOAD, MVT::i32, Expand);
+  // Aligned loads and stores of 32 bits or less are atomic, so atomic loads
+  // and stores are selected as normal memory instructions.
   setOperationAction(ISD::ATOMIC_LOAD, MVT::i64, Expand);
-  setOperationAction(ISD::ATOMIC_STORE, MVT::i32, Expand);
   setOperationAction(ISD::ATOMIC_STORE, MVT::i64, Expand);
 
+  // The AtomicExpand pass strips the ordering from atomic operations and
+  // brackets them with fences where it requires (emitLeadingFence and
+  // emitTrailingFence).
   setInsertFencesForAtomic(true);
 
   setOperationAction(ISD::FCOPYSIGN,  MVT::f32, Expand);
-  setOperationAction(ISD::FFLOOR,  MVT::f32, Expand);
-  setOperationAction(ISD::FFLOOR,  MVT::v16f32, Expand);
-
-  // Hardware does not have an integer divider, so convert these to
-  // library calls
-  setOperationAction(ISD::UDIV, MVT::i32, Expand); // __udivsi3
-  setOperationAction(ISD::UREM, MVT::i32, Expand); // __umodsi3
-  setOperationAction(ISD::SDIV, MVT::i32, Expand); // __divsi3
-  setOperationAction(ISD::SREM, MVT::i32, Expand); // __modsi3
+
+  // Rounding to an integral value is done by converting to an integer and
+  // back (LowerFROUND).
+  setOperationAction(ISD::FFLOOR, MVT::f32, Custom);
+  setOperationAction(ISD::FCEIL, MVT::f32, Custom);
+  setOperationAction(ISD::FTRUNC, MVT::f32, Custom);
+  setOperationAction(ISD::FRINT, MVT::f32, Custom);
+  setOperationAction(ISD::FNEARBYINT, MVT::f32, Custom);
+  setOperationAction(ISD::FROUND, MVT::f32, Custom);
+  setOperationAction(ISD::FFLOOR, MVT::v16f32, Custom);
+  setOperationAction(ISD::FCEIL, MVT::v16f32, Custom);
+  setOperationAction(ISD::FTRUNC, MVT::v16f32, Custom);
+  setOperationAction(ISD::FRINT, MVT::v16f32, Custom);
+  setOperationAction(ISD::FNEARBYINT, MVT::v16f32, Custom);
+  setOperationAction(ISD::FROUND, MVT::v16f32, Custom);
+
+  // Unsigned conversions adjust the result of a signed conversion.
+  setOperationAction(ISD::FP_TO_UINT, MVT::v16i32, Custom);
+  setOperationAction(ISD::UINT_TO_FP, MVT::v16i32, Custom);
+
+  // Hardware does not have an integer divider. Division by a constant is
+  // turned into a multiply by the DAG combiner. Other divisions use a
+  // floating point reciprocal estimate (LowerDIVREM).
+  setOperationAction(ISD::UDIV, MVT::i32, Custom);
+  setOperationAction(ISD::UREM, MVT::i32, Custom);
+  setOperationAction(ISD::SDIV, MVT::i32, Custom);
+  setOperationAction(ISD::SREM, MVT::i32, Custom);
+  setOperationAction(ISD::UDIV, MVT::v16i32, Custom);
+  setOperationAction(ISD::UREM, MVT::v16i32, Custom);
+  setOperationAction(ISD::SDIV, MVT::v16i32, Custom);
+  setOperationAction(ISD::SREM, MVT::v16i32, Custom);
   
-  setOperationAction(ISD::FSQRT, MVT::f32, Expand); // sqrtf
+  setOperationAction(ISD::FSQRT, MVT::f32, Custom);
   setOperationAction(ISD::FSIN, MVT::f32, Expand); // sinf
   setOperationAction(ISD::FCOS, MVT::f32, Expand); // cosf
+
+  // The vector unit has no instructions for these. Expanding them unrolls
+  // them into scalar operations (or library calls) on each lane.
+  setOperationAction(ISD::UDIVREM, MVT::v16i32, Expand);
+  setOperationAction(ISD::SDIVREM, MVT::v16i32, Expand);
+  setOperationAction(ISD::UMUL_LOHI, MVT::v16i32, Expand);
+  setOperationAction(ISD::SMUL_LOHI, MVT::v16i32, Expand);
+  setOperationAction(ISD::FREM, MVT::v16f32, Expand);
+  setOperationAction(ISD::FMA, MVT::v16f32, Expand);
+
+  // There are no rotate instructions. Leaving these unsupported keeps the
+  // DAG combiner from forming them, so rotate idioms stay as shifts and an
+  // or, which work on vectors as well as scalars.
+  setOperationAction(ISD::ROTL, MVT::v16i32, Expand);
+  setOperationAction(ISD::ROTR, MVT::v16i32, Expand);
+
+  // Built from shifts and masks, which all work on vectors (LowerCTPOP,
+  // LowerBSWAP)
+  setOperationAction(ISD::CTPOP, MVT::v16i32, Custom);
+  setOperationAction(ISD::BSWAP, MVT::v16i32, Custom);
   
   setCondCodeAction(ISD::SETO, MVT::f32, Expand);
   setCondCodeAction(ISD::SETUO, MVT::f32, Expand);  // XXX this is broken
@@ -487,6 +632,22 @@ NyuziTargetLowering::NyuziTargetLowering(const TargetMachine &TM,
   setIntDivIsCheap(false);
   setSchedulingPreference(Sched::RegPressure);
 
+  setTargetDAGCombine(ISD::ADD);
+  setTargetDAGCombine(ISD::SUB);
+  setTargetDAGCombine(ISD::MUL);
+  setTargetDAGCombine(ISD::MULHU);
+  setTargetDAGCombine(ISD::MULHS);
+  setTargetDAGCombine(ISD::AND);
+  setTargetDAGCombine(ISD::OR);
+  setTargetDAGCombine(ISD::XOR);
+  setTargetDAGCombine(ISD::SHL);
+  setTargetDAGCombine(ISD::SRL);
+  setTargetDAGCombine(ISD::SRA);
+  setTargetDAGCombine(ISD::FADD);
+  setTargetDAGCombine(ISD::FSUB);
+  setTargetDAGCombine(ISD::FMUL);
+  setTargetDAGCombine(ISD::FDIV);
+
   computeRegisterProperties();
 }
 
@@ -494,6 +655,8 @@ const char *NyuziTargetLowering::getTargetNodeName(unsigned Opcode) const {
   switch (Opcode) {
   case NyuziISD::CALL:
     return "NyuziISD::CALL";
+  case NyuziISD::TAIL_CALL:
+    return "NyuziISD::TAIL_CALL";
   case NyuziISD::RET_FLAG:
     return "NyuziISD::RET_FLAG";
   case NyuziISD::SPLAT:
@@ -613,10 +776,98 @@ static bool isZero(SDValue V) {
   return C && C->isNullValue();
 }
 
+// Check if all elements of a vector are the same, either because it is a
+// SPLAT node or a BUILD_VECTOR that hasn't been lowered yet.
+static bool isSplat(SDValue V) {
+  if (V.getOpcode() == NyuziISD::SPLAT)
+    return true;
+
+  return V.getOpcode() == ISD::BUILD_VECTOR && isSplatVector(V.getNode());
+}
+
+// Like isSplat, but also matches shuffles that broadcast a single lane, which
+// will be lowered to a SPLAT.
+static bool isUniform(SDValue V) {
+  if (isSplat(V))
+    return true;
+
+  return V.getOpcode() == ISD::VECTOR_SHUFFLE &&
+         cast<ShuffleVectorSDNode>(V)->isSplat();
+}
+
+// Check for floating point 1.0 or a splat of it.
+static bool isOne(SDValue V) {
+  if (isSplat(V))
+    V = V.getOperand(0);
+
+  ConstantFPSDNode *C = dyn_cast<ConstantFPSDNode>(V);
+  return C && C->isExactlyValue(1.0);
+}
+
+// Load a vector from the constant pool.
+static SDValue getConstantVector(ArrayRef<Constant *> Elems, MVT VT, SDLoc DL,
+                                 SelectionDAG &DAG) {
+  SDValue CPIdx =
+      DAG.getConstantPool(ConstantVector::get(Elems), MVT::i32, 64);
+  return DAG.getLoad(VT, DL, DAG.getEntryNode(), CPIdx,
+                     MachinePointerInfo::getConstantPool(), false, false,
+                     false, 64);
+}
+
+static SDValue getConstantIntVector(ArrayRef<int> Values, SDLoc DL,
+                                    SelectionDAG &DAG) {
+  Type *Int32Ty = Type::getInt32Ty(*DAG.getContext());
+  SmallVector<Constant *, 16> Elems;
+  for (int Val : Values)
+    Elems.push_back(ConstantInt::get(Int32Ty, Val));
+
+  return getConstantVector(Elems, MVT::v16i32, DL, DAG);
+}
+
+// Lane masks are ordered with lane 0 in the most significant bit.
+static unsigned laneMaskBit(int Lane) { return 0x8000 >> Lane; }
+
+// Lanes in Mask get their value from NewVal, others from OldVal
+static SDValue getVectorMix(unsigned Mask, SDValue NewVal, SDValue OldVal,
+                            SDLoc DL, SelectionDAG &DAG) {
+  MVT VT = NewVal.getValueType().getSimpleVT();
+  Intrinsic::ID Mix = VT == MVT::v16f32 ? Intrinsic::nyuzi_vector_mixf
+                                        : Intrinsic::nyuzi_vector_mixi;
+  return DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, VT,
+                     DAG.getConstant(Mix, MVT::i32),
+                     DAG.getConstant(Mask, MVT::i32), NewVal, OldVal);
+}
+
+// Approximate number of instructions needed to get a scalar value into a
+// register or an immediate field.
+static int getMaterializeCost(SDValue Val) {
+  if (ConstantSDNode *C = dyn_cast<ConstantSDNode>(Val))
+    return isInt<8>(C->getSExtValue()) ? 0 : 1;
+
+  if (isa<ConstantFPSDNode>(Val))
+    return 1;
+
+  return 0; // Already in a register
+}
+
+static int getMaskCost(unsigned Mask) { return isInt<13>(Mask) ? 1 : 2; }
+
+static bool isConstantElement(SDValue Val) {
+  return isa<ConstantSDNode>(Val) || isa<ConstantFPSDNode>(Val);
+}
+
+//
+// Vectors with only a few distinct values are built by splatting the most
+// common one and using masked moves for the others. Vectors of constants
+// can also be loaded from the constant pool, followed by masked moves for
+// any lanes that are not constant. Pick whichever needs fewer instructions,
+// counting a constant pool load as the latency of a load.
+//
 SDValue NyuziTargetLowering::LowerBUILD_VECTOR(SDValue Op,
                                                     SelectionDAG &DAG) const {
   MVT VT = Op.getValueType().getSimpleVT();
   SDLoc DL(Op);
+  const int kConstPoolLoadCost = 3;
 
   if (isSplatVector(Op.getNode())) {
     // This is a constant node that is duplicated to all lanes.
@@ -624,7 +875,78 @@ SDValue NyuziTargetLowering::LowerBUILD_VECTOR(SDValue Op,
     return DAG.getNode(NyuziISD::SPLAT, DL, VT, Op.getOperand(0));
   }
 
-  return SDValue(); // Expand
+  // Group lanes that have the same value. Undefined lanes can be anything.
+  SmallVector<std::pair<SDValue, unsigned>, 16> Groups;
+  for (int Lane = 0; Lane < 16; Lane++) {
+    SDValue Val = Op.getOperand(Lane);
+    if (Val.getOpcode() == ISD::UNDEF)
+      continue;
+
+    unsigned i = 0;
+    while (i < Groups.size() && Groups[i].first != Val)
+      i++;
+
+    if (i == Groups.size())
+      Groups.push_back(std::make_pair(Val, 0u));
+
+    Groups[i].second |= laneMaskBit(Lane);
+  }
+
+  if (Groups.empty())
+    return DAG.getUNDEF(VT);
+
+  unsigned BaseGroup = 0;
+  for (unsigned i = 1; i < Groups.size(); i++) {
+    if (CountPopulation_32(Groups[i].second) >
+        CountPopulation_32(Groups[BaseGroup].second))
+      BaseGroup = i;
+  }
+
+  int SplatCost = 1 + getMaterializeCost(Groups[BaseGroup].first);
+  int ConstPoolCost = kConstPoolLoadCost;
+  int NumConstantGroups = 0;
+  for (unsigned i = 0; i < Groups.size(); i++) {
+    int MoveCost = 1 + getMaskCost(Groups[i].second) +
+                   getMaterializeCost(Groups[i].first);
+    if (i != BaseGroup)
+      SplatCost += MoveCost;
+
+    if (isConstantElement(Groups[i].first))
+      NumConstantGroups++;
+    else
+      ConstPoolCost += MoveCost;
+  }
+
+  SDValue Result;
+  bool UseConstPool = NumConstantGroups > 1 && ConstPoolCost < SplatCost;
+  if (UseConstPool) {
+    Type *EltTy = VT.getVectorElementType() == MVT::f32
+                      ? Type::getFloatTy(*DAG.getContext())
+                      : Type::getInt32Ty(*DAG.getContext());
+    SmallVector<Constant *, 16> Elems;
+    for (int Lane = 0; Lane < 16; Lane++) {
+      SDValue Val = Op.getOperand(Lane);
+      if (ConstantSDNode *C = dyn_cast<ConstantSDNode>(Val))
+        Elems.push_back(ConstantInt::get(EltTy, C->getZExtValue()));
+      else if (ConstantFPSDNode *C = dyn_cast<ConstantFPSDNode>(Val))
+        Elems.push_back(const_cast<ConstantFP *>(C->getConstantFPValue()));
+      else
+        Elems.push_back(UndefValue::get(EltTy));
+    }
+
+    Result = getConstantVector(Elems, VT, DL, DAG);
+  } else
+    Result = DAG.getNode(NyuziISD::SPLAT, DL, VT, Groups[BaseGroup].first);
+
+  for (unsigned i = 0; i < Groups.size(); i++) {
+    if (UseConstPool ? isConstantElement(Groups[i].first) : i == BaseGroup)
+      continue;
+
+    SDValue Splat = DAG.getNode(NyuziISD::SPLAT, DL, VT, Groups[i].first);
+    Result = getVectorMix(Groups[i].second, Splat, Result, DL, DAG);
+  }
+
+  return Result;
 }
 
 // SCALAR_TO_VECTOR loads the scalar register into lane 0 of the register.
@@ -657,13 +979,69 @@ NyuziTargetLowering::LowerINSERT_VECTOR_ELT(SDValue Op,
                      Splat, Op.getOperand(0));
 }
 
+// LowerVECTOR_SHUFFLE can handle any mask.
 bool NyuziTargetLowering::isShuffleMaskLegal(const SmallVectorImpl<int> &M,
                                                   EVT VT) const {
-  if (M.size() != 16)
-    return false;
+  return M.size() == 16;
+}
+
+static SDValue getShuffle(SDValue Src, SDValue Indices, SDLoc DL,
+                          SelectionDAG &DAG) {
+  MVT VT = Src.getValueType().getSimpleVT();
+  Intrinsic::ID Shuffle = VT == MVT::v16f32 ? Intrinsic::nyuzi_shufflef
+                                            : Intrinsic::nyuzi_shufflei;
+  return DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, VT,
+                     DAG.getConstant(Shuffle, MVT::i32), Src, Indices);
+}
+
+// If the mask (with sources folded together) rotates the lanes, return the
+// amount, otherwise -1. Undefined lanes match anything.
+static int getRotateAmount(ArrayRef<int> Indices) {
+  int Amount = -1;
+  for (int i = 0; i < 16; i++) {
+    if (Indices[i] < 0)
+      continue;
+
+    int LaneAmount = (Indices[i] - i) & 15;
+    if (Amount == -1)
+      Amount = LaneAmount;
+    else if (Amount != LaneAmount)
+      return -1;
+  }
+
+  return Amount;
+}
+
+// If each lane of the mask comes from the lane whose index differs from its
+// own in a fixed set of bits, return those bits, otherwise -1. The shuffles
+// in a reduction tree have this form.
+static int getSwizzleBits(ArrayRef<int> Indices) {
+  int Bits = -1;
+  for (int i = 0; i < 16; i++) {
+    if (Indices[i] < 0)
+      continue;
+
+    int LaneBits = Indices[i] ^ i;
+    if (Bits == -1)
+      Bits = LaneBits;
+    else if (Bits != LaneBits)
+      return -1;
+  }
+
+  return Bits;
+}
+
+static SDValue getLaneNumbers(SDLoc DL, SelectionDAG &DAG) {
+  int LaneNumbers[16];
+  for (int i = 0; i < 16; i++)
+    LaneNumbers[i] = i;
 
-  for (int val : M) {
-    if (val != 0)
+  return getConstantIntVector(LaneNumbers, DL, DAG);
+}
+
+static bool isReverse(ArrayRef<int> Indices) {
+  for (int i = 0; i < 16; i++) {
+    if (Indices[i] >= 0 && Indices[i] != 15 - i)
       return false;
   }
 
@@ -671,62 +1049,227 @@ bool NyuziTargetLowering::isShuffleMaskLegal(const SmallVectorImpl<int> &M,
 }
 
 //
-// Look for patterns that built splats.  isShuffleMaskLegal should ensure this
-// will only be called with splat masks, but I don't know if there are edge cases 
-// where it will still be called.  Perhaps need to check explicitly (note that the 
-// shuffle mask doesn't appear to be an operand, but must be accessed by casting the 
-// SDNode and using a separate accessor).
+// The shuffle instruction takes a vector of lane indices and selects lanes
+// from a single source vector. Two source shuffles are done with two
+// shuffles, the second masked so it only updates lanes from the second
+// source. Simpler masks are handled specially:
+// - Splats become a SPLAT of the scalar value or of a single lane.
+// - Masks where each lane comes from the same lane in one of the sources are
+//   a single masked move.
+// - Rotations, reversals, and swizzles where each lane comes from the lane
+//   whose index differs in fixed bits (lane ^ N) compute the index vector
+//   from a shared vector of lane numbers rather than using a constant pool
+//   entry for each mask. The shuffles that the vectorizers emit for a
+//   reduction are swizzles, which take a single xor.
 //
 SDValue NyuziTargetLowering::LowerVECTOR_SHUFFLE(SDValue Op,
                                                       SelectionDAG &DAG) const {
   MVT VT = Op.getValueType().getSimpleVT();
   SDLoc DL(Op);
+  ShuffleVectorSDNode *SVN = cast<ShuffleVectorSDNode>(Op.getNode());
+  ArrayRef<int> Mask = SVN->getMask();
+  SDValue V1 = Op.getOperand(0);
+  SDValue V2 = Op.getOperand(1);
+
+  if (SVN->isSplat()) {
+    int SplatLane = SVN->getSplatIndex();
+    SDValue Src = V1;
+    if (SplatLane >= 16) {
+      Src = V2;
+      SplatLane -= 16;
+    }
+
+    // Using shufflevector to build a splat like this:
+    // %vector = shufflevector <16 x i32> %single, <16 x i32> (don't care),
+    //                       <16 x i32> zeroinitializer
 
-  // Using shufflevector to build a splat like this:
-  // %vector = shufflevector <16 x i32> %single, <16 x i32> (don't care),
-  //                       <16 x i32> zeroinitializer
+    // %single = insertelement <16 x i32> (don't care), i32 %value, i32 0
+    if (Src.getOpcode() == ISD::INSERT_VECTOR_ELT) {
+      ConstantSDNode *InsertIdx = dyn_cast<ConstantSDNode>(Src.getOperand(2));
+      if (InsertIdx && InsertIdx->getZExtValue() == (unsigned) SplatLane)
+        return DAG.getNode(NyuziISD::SPLAT, DL, VT, Src.getOperand(1));
+    }
 
-  // %single = insertelement <16 x i32> (don't care), i32 %value, i32 0
-  if (Op.getOperand(0).getOpcode() == ISD::INSERT_VECTOR_ELT &&
-      isZero(Op.getOperand(0).getOperand(2)))
-    return DAG.getNode(NyuziISD::SPLAT, DL, VT,
-                       Op.getOperand(0).getOperand(1));
+    // %single = scalar_to_vector i32 %b
+    if (Src.getOpcode() == ISD::SCALAR_TO_VECTOR && SplatLane == 0)
+      return DAG.getNode(NyuziISD::SPLAT, DL, VT, Src.getOperand(0));
 
-  // %single = scalar_to_vector i32 %b
-  if (Op.getOperand(0).getOpcode() == ISD::SCALAR_TO_VECTOR)
-    return DAG.getNode(NyuziISD::SPLAT, DL, VT,
-                       Op.getOperand(0).getOperand(0));
+    // Broadcast an arbitrary lane by reading it into a scalar register.
+    SDValue Elem = DAG.getNode(ISD::EXTRACT_VECTOR_ELT, DL,
+                               VT.getVectorElementType(), Src,
+                               DAG.getConstant(SplatLane, MVT::i32));
+    return DAG.getNode(NyuziISD::SPLAT, DL, VT, Elem);
+  }
 
-  return SDValue();
+  // Determine which lanes come from which source.
+  unsigned V2Lanes = 0;
+  bool UsesV1 = false;
+  bool IsBlend = true;
+  int Indices[16];
+  for (int i = 0; i < 16; i++) {
+    if (Mask[i] < 0) {
+      Indices[i] = -1;
+      continue;
+    }
+
+    if (Mask[i] >= 16)
+      V2Lanes |= laneMaskBit(i);
+    else
+      UsesV1 = true;
+
+    Indices[i] = Mask[i] & 15;
+    if (Indices[i] != i)
+      IsBlend = false;
+  }
+
+  if (IsBlend)
+    return getVectorMix(V2Lanes, V2, V1, DL, DAG);
+
+  // Compute the vector of source lane indices.
+  SDValue IndexVec;
+  int SwizzleBits = getSwizzleBits(Indices);
+  int RotateAmount = getRotateAmount(Indices);
+  if (SwizzleBits >= 0 || RotateAmount >= 0 || isReverse(Indices)) {
+    SDValue LaneNumVec = getLaneNumbers(DL, DAG);
+    if (SwizzleBits >= 0) {
+      IndexVec = DAG.getNode(ISD::XOR, DL, MVT::v16i32, LaneNumVec,
+                             DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32,
+                                         DAG.getConstant(SwizzleBits,
+                                                         MVT::i32)));
+    } else if (RotateAmount >= 0) {
+      SDValue Sum = DAG.getNode(
+          ISD::ADD, DL, MVT::v16i32, LaneNumVec,
+          DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32,
+                      DAG.getConstant(RotateAmount, MVT::i32)));
+      IndexVec = DAG.getNode(ISD::AND, DL, MVT::v16i32, Sum,
+                             DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32,
+                                         DAG.getConstant(15, MVT::i32)));
+    } else {
+      IndexVec = DAG.getNode(ISD::SUB, DL, MVT::v16i32,
+                             DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32,
+                                         DAG.getConstant(15, MVT::i32)),
+                             LaneNumVec);
+    }
+  } else {
+    for (int i = 0; i < 16; i++) {
+      if (Indices[i] < 0)
+        Indices[i] = 0;
+    }
+
+    IndexVec = getConstantIntVector(Indices, DL, DAG);
+  }
+
+  if (V2Lanes == 0)
+    return getShuffle(V1, IndexVec, DL, DAG);
+
+  if (!UsesV1)
+    return getShuffle(V2, IndexVec, DL, DAG);
+
+  return getVectorMix(V2Lanes, getShuffle(V2, IndexVec, DL, DAG),
+                      getShuffle(V1, IndexVec, DL, DAG), DL, DAG);
+}
+
+static Intrinsic::ID intrinsicForVectorCompare(ISD::CondCode CC, bool isFloat);
+
+// Compare two vectors, returning a mask with a bit set for each lane where
+// the comparison is true.
+static SDValue getVectorCompareMask(SDValue SetCC, SelectionDAG &DAG) {
+  SDLoc DL(SetCC);
+  ISD::CondCode CC = cast<CondCodeSDNode>(SetCC.getOperand(2))->get();
+  SDValue LHS = SetCC.getOperand(0);
+  SDValue RHS = SetCC.getOperand(1);
+  bool IsFloat = LHS.getValueType().isFloatingPoint();
+
+  // Comparisons can take a scalar or immediate as the second operand, but
+  // not the first.
+  if (isUniform(LHS) && !isUniform(RHS)) {
+    std::swap(LHS, RHS);
+    CC = ISD::getSetCCSwappedOperands(CC);
+  }
+
+  return DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, MVT::i32,
+                     DAG.getConstant(intrinsicForVectorCompare(CC, IsFloat),
+                                     MVT::i32),
+                     LHS, RHS);
+}
+
+// Expand a lane mask into a vector with all bits set in the lanes where the
+// mask bit is set and zero in the others.
+static SDValue getMaskBoolVector(SDValue Mask, SDLoc DL, SelectionDAG &DAG) {
+  SDValue FalseVal = DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32,
+                                 DAG.getConstant(0, MVT::i32));
+  SDValue TrueVal = DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32,
+                                DAG.getConstant(0xffffffff, MVT::i32));
+  return DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, MVT::v16i32,
+                     DAG.getConstant(Intrinsic::nyuzi_vector_mixi, MVT::i32),
+                     Mask, TrueVal, FalseVal);
+}
+
+// If Vec was created by getMaskBoolVector, return the mask it was built from.
+static SDValue getBoolVectorMask(SDValue Vec) {
+  if (Vec.getOpcode() != ISD::INTRINSIC_WO_CHAIN ||
+      cast<ConstantSDNode>(Vec.getOperand(0))->getZExtValue() !=
+          Intrinsic::nyuzi_vector_mixi)
+    return SDValue();
+
+  SDValue TrueVal = Vec.getOperand(2);
+  SDValue FalseVal = Vec.getOperand(3);
+  if (TrueVal.getOpcode() != NyuziISD::SPLAT ||
+      FalseVal.getOpcode() != NyuziISD::SPLAT)
+    return SDValue();
+
+  ConstantSDNode *TrueConst = dyn_cast<ConstantSDNode>(TrueVal.getOperand(0));
+  if (!TrueConst || !TrueConst->isAllOnesValue() ||
+      !isZero(FalseVal.getOperand(0)))
+    return SDValue();
+
+  return Vec.getOperand(1);
 }
 
 // This architecture does not support conditional moves for scalar registers.
 // We must convert this into a set of conditional branches.  We do this by
 // creating a pseudo-instruction SEL_COND_RESULT, which will later be
 // transformed.
+//
+// Vector values don't need a branch: a lane-wise comparison is a vector
+// select (see LowerVSELECT), and a scalar comparison can be turned into a
+// mask for a masked move that selects all lanes or none.
+//
 SDValue NyuziTargetLowering::LowerSELECT_CC(SDValue Op,
                                                  SelectionDAG &DAG) const {
   SDLoc DL(Op);
   EVT Ty = Op.getOperand(0).getValueType();
+  EVT VT = Op.getValueType();
   SDValue Pred =
       DAG.getNode(ISD::SETCC, DL, getSetCCResultType(*DAG.getContext(), Ty),
                   Op.getOperand(0), Op.getOperand(1), Op.getOperand(4));
 
+  if (Ty.isVector())
+    return DAG.getNode(ISD::VSELECT, DL, VT, Pred, Op.getOperand(2),
+                       Op.getOperand(3));
+
+  if (VT.isVector()) {
+    // 0 - (Pred & 1) is all ones if the condition is true, zero otherwise.
+    SDValue Mask = DAG.getNode(ISD::SUB, DL, MVT::i32,
+                               DAG.getConstant(0, MVT::i32),
+                               DAG.getNode(ISD::AND, DL, MVT::i32, Pred,
+                                           DAG.getConstant(1, MVT::i32)));
+    Intrinsic::ID Mix = VT == MVT::v16f32 ? Intrinsic::nyuzi_vector_mixf
+                                          : Intrinsic::nyuzi_vector_mixi;
+    return DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, VT,
+                       DAG.getConstant(Mix, MVT::i32), Mask, Op.getOperand(2),
+                       Op.getOperand(3));
+  }
+
   return DAG.getNode(NyuziISD::SEL_COND_RESULT, DL, Op.getValueType(),
                      Pred, Op.getOperand(2), Op.getOperand(3));
 }
 
-// There is no native floating point division, but we can convert this to a
-// reciprocal/multiply operation.  If the first parameter is constant 1.0, then
-// just a reciprocal will suffice.
-SDValue NyuziTargetLowering::LowerFDIV(SDValue Op,
-                                            SelectionDAG &DAG) const {
-  SDLoc DL(Op);
-
-  EVT Type = Op.getOperand(1).getValueType();
-
+// Compute 1/x from the hardware reciprocal estimate.
+static SDValue getReciprocal(SDValue Denominator, SDLoc DL,
+                             SelectionDAG &DAG) {
+  EVT Type = Denominator.getValueType();
   SDValue Two = DAG.getConstantFP(2.0, Type);
-  SDValue Denominator = Op.getOperand(1);
   SDValue Estimate =
       DAG.getNode(NyuziISD::RECIPROCAL_EST, DL, Type, Denominator);
 
@@ -743,24 +1286,290 @@ SDValue NyuziTargetLowering::LowerFDIV(SDValue Op,
     Estimate = DAG.getNode(ISD::FMUL, DL, Type, Estimate, Error);
   }
 
+  return Estimate;
+}
+
+// Approximate 1/sqrt(x). There is no instruction for this, so the initial
+// estimate comes from treating the bits of x as an integer: shifting right
+// halves the exponent and subtracting from a magic constant negates it. This
+// has about 5 bits of precision. Each Newton-Raphson iteration roughly
+// doubles that (to about 9, 17 and 22 bits), so three iterations are needed
+// for a full precision result. With unsafe math, two are used, which is
+// still accurate to about one part in 100000.
+// Inputs smaller than FLT_MIN give an estimate that overflows, so callers
+// handle zero and denormals separately.
+static SDValue getReciprocalSqrt(SDValue X, SDLoc DL, SelectionDAG &DAG,
+                                 bool Exact) {
+  EVT Type = X.getValueType();
+  EVT IntType = Type.isVector() ? MVT::v16i32 : MVT::i32;
+
+  SDValue Bits = DAG.getNode(ISD::BITCAST, DL, IntType, X);
+  SDValue Estimate = DAG.getNode(
+      ISD::BITCAST, DL, Type,
+      DAG.getNode(ISD::SUB, DL, IntType, DAG.getConstant(0x5f3759df, IntType),
+                  DAG.getNode(ISD::SRL, DL, IntType, Bits,
+                              DAG.getConstant(1, IntType))));
+
+  SDValue HalfX =
+      DAG.getNode(ISD::FMUL, DL, Type, X, DAG.getConstantFP(0.5, Type));
+  SDValue ThreeHalves = DAG.getConstantFP(1.5, Type);
+  int Iterations = Exact ? 3 : 2;
+  for (int i = 0; i < Iterations; i++) {
+    // Estimate = Estimate * (1.5 - x / 2 * Estimate * Estimate)
+    SDValue Square = DAG.getNode(ISD::FMUL, DL, Type, Estimate, Estimate);
+    SDValue Trial = DAG.getNode(ISD::FMUL, DL, Type, HalfX, Square);
+    SDValue Error = DAG.getNode(ISD::FSUB, DL, Type, ThreeHalves, Trial);
+    Estimate = DAG.getNode(ISD::FMUL, DL, Type, Estimate, Error);
+  }
+
+  return Estimate;
+}
+
+// Return true if X is zero or a denormal, which are treated as zero by the
+// square root functions.
+static SDValue isTiny(SDValue X, SDLoc DL, SelectionDAG &DAG) {
+  EVT Type = X.getValueType();
+  EVT CondType = DAG.getTargetLoweringInfo().getSetCCResultType(
+      *DAG.getContext(), Type);
+  return DAG.getSetCC(DL, CondType, DAG.getNode(ISD::FABS, DL, Type, X),
+                      DAG.getConstantFP(APFloat::getSmallestNormalized(
+                                            APFloat::IEEEsingle),
+                                        Type),
+                      ISD::SETOLT);
+}
+
+// Return a zero or infinity (chosen by Magnitude) with the same sign as X
+static SDValue getSignedValue(SDValue X, uint32_t Magnitude, SDLoc DL,
+                              SelectionDAG &DAG) {
+  EVT Type = X.getValueType();
+  EVT IntType = Type.isVector() ? MVT::v16i32 : MVT::i32;
+  SDValue Sign = DAG.getNode(ISD::AND, DL, IntType,
+                             DAG.getNode(ISD::BITCAST, DL, IntType, X),
+                             DAG.getConstant(0x80000000, IntType));
+  if (Magnitude != 0)
+    Sign = DAG.getNode(ISD::OR, DL, IntType, Sign,
+                       DAG.getConstant(Magnitude, IntType));
+
+  return DAG.getNode(ISD::BITCAST, DL, Type, Sign);
+}
+
+// Return Result, or Replacement in elements where X compares to Value using CC.
+// The result may have a different type than X (for example, an integer result
+// selected by a floating point comparison).
+static SDValue replaceIf(SDValue X, ISD::CondCode CC, SDValue Value,
+                         SDValue Replacement, SDValue Result, SDLoc DL,
+                         SelectionDAG &DAG) {
+  EVT CondType = DAG.getTargetLoweringInfo().getSetCCResultType(
+      *DAG.getContext(), X.getValueType());
+  SDValue Cond = DAG.getSetCC(DL, CondType, X, Value, CC);
+  return DAG.getSelect(DL, Result.getValueType(), Cond, Replacement, Result);
+}
+
+// Dividing by a square root is a multiply by the reciprocal square root.
+// This is done as a DAG combine, because vector square roots are lowered
+// before the division that uses them.
+static SDValue getDivideBySqrt(SDNode *N, SelectionDAG &DAG) {
+  SDLoc DL(N);
+  EVT Type = N->getValueType(0);
+  SDValue X = N->getOperand(1).getOperand(0);
+  bool Exact = !DAG.getTarget().Options.UnsafeFPMath;
+  SDValue Result = getReciprocalSqrt(X, DL, DAG, Exact);
+  if (Exact) {
+    SDValue Inf = DAG.getConstantFP(APFloat::getInf(APFloat::IEEEsingle),
+                                    Type);
+    Result = replaceIf(X, ISD::SETOEQ, Inf, DAG.getConstantFP(0.0, Type),
+                       Result, DL, DAG);
+    Result = replaceIf(X, ISD::SETOLT, DAG.getConstantFP(0.0, Type),
+                       DAG.getConstantFP(APFloat::getNaN(APFloat::IEEEsingle),
+                                         Type),
+                       Result, DL, DAG);
+
+    // 1/sqrt(+/-0) is +/-inf. Denormals are flushed to zero.
+    Result = DAG.getSelect(DL, Type, isTiny(X, DL, DAG),
+                           getSignedValue(X, 0x7f800000, DL, DAG), Result);
+  }
+
+  if (isOne(N->getOperand(0)))
+    return Result;
+
+  return DAG.getNode(ISD::FMUL, DL, Type, N->getOperand(0), Result);
+}
+
+// There is no native floating point division, but we can convert this to a
+// reciprocal/multiply operation.  If the first parameter is constant 1.0, then
+// just a reciprocal will suffice.
+SDValue NyuziTargetLowering::LowerFDIV(SDValue Op,
+                                            SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+
+  EVT Type = Op.getOperand(1).getValueType();
+
+  SDValue Denominator = Op.getOperand(1);
+
+  SDValue Estimate = getReciprocal(Denominator, DL, DAG);
+
   // Check if the first parameter is constant 1.0.  If so, we don't need
   // to multiply by the dividend.
-  bool IsOne = false;
-  if (Type.isVector()) {
-    if (isSplatVector(Op.getOperand(0).getNode())) {
-      ConstantFPSDNode *C =
-          dyn_cast<ConstantFPSDNode>(Op.getOperand(0).getOperand(0));
-      IsOne = C && C->isExactlyValue(1.0);
-    }
+  if (!isOne(Op.getOperand(0)))
+    Estimate = DAG.getNode(ISD::FMUL, DL, Type, Op.getOperand(0), Estimate);
+
+  return Estimate;
+}
+
+// sqrt(x) = x * 1/sqrt(x). With full precision, fix up the cases where
+// that is not true: sqrt(+inf) is +inf, the square root of a negative
+// number is NaN, and sqrt(+/-0) is +/-0 (the reciprocal estimate for zero
+// overflows, so the product would be NaN). Denormals are flushed to zero.
+SDValue NyuziTargetLowering::LowerFSQRT(SDValue Op, SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  EVT Type = Op.getValueType();
+  SDValue X = Op.getOperand(0);
+  bool Exact = !DAG.getTarget().Options.UnsafeFPMath;
+  SDValue Result = DAG.getNode(ISD::FMUL, DL, Type, X,
+                               getReciprocalSqrt(X, DL, DAG, Exact));
+  if (Exact) {
+    SDValue Inf = DAG.getConstantFP(APFloat::getInf(APFloat::IEEEsingle), Type);
+    Result = replaceIf(X, ISD::SETOEQ, Inf, Inf, Result, DL, DAG);
+    Result = replaceIf(X, ISD::SETOLT, DAG.getConstantFP(0.0, Type),
+                       DAG.getConstantFP(APFloat::getNaN(APFloat::IEEEsingle),
+                                         Type),
+                       Result, DL, DAG);
+    Result = DAG.getSelect(DL, Type, isTiny(X, DL, DAG),
+                           getSignedValue(X, 0, DL, DAG), Result);
+  }
+
+  return Result;
+}
+
+// Return 1 if A CC B, 0 otherwise, as an integer of the same width as A. This
+// works for both scalars and vectors regardless of how the comparison result
+// is represented.
+static SDValue getCompareBit(SDValue A, SDValue B, ISD::CondCode CC, SDLoc DL,
+                             SelectionDAG &DAG) {
+  EVT CondVT = DAG.getTargetLoweringInfo().getSetCCResultType(
+      *DAG.getContext(), A.getValueType());
+  return DAG.getNode(ISD::AND, DL, CondVT, DAG.getSetCC(DL, CondVT, A, B, CC),
+                     DAG.getConstant(1, CondVT));
+}
+
+// Return TrueVal where A CC B, FalseVal elsewhere. Vectors use a masked move
+// (see LowerVSELECT). Scalar selects need a branch, so they are done with
+// bitwise operations on a mask built from the comparison result instead.
+static SDValue getSelectOnCompare(SDValue A, SDValue B, ISD::CondCode CC,
+                                  SDValue TrueVal, SDValue FalseVal, SDLoc DL,
+                                  SelectionDAG &DAG) {
+  EVT VT = TrueVal.getValueType();
+  if (VT.isVector())
+    return replaceIf(A, CC, B, TrueVal, FalseVal, DL, DAG);
+
+  SDValue Mask = DAG.getNode(ISD::SUB, DL, MVT::i32,
+                             DAG.getConstant(0, MVT::i32),
+                             getCompareBit(A, B, CC, DL, DAG));
+  SDValue TrueBits = DAG.getNode(ISD::BITCAST, DL, MVT::i32, TrueVal);
+  SDValue FalseBits = DAG.getNode(ISD::BITCAST, DL, MVT::i32, FalseVal);
+  SDValue Diff = DAG.getNode(ISD::XOR, DL, MVT::i32, TrueBits, FalseBits);
+  return DAG.getNode(
+      ISD::BITCAST, DL, VT,
+      DAG.getNode(ISD::XOR, DL, MVT::i32, FalseBits,
+                  DAG.getNode(ISD::AND, DL, MVT::i32, Diff, Mask)));
+}
+
+// Compute the unsigned quotient or remainder of X / Y.
+//
+// Z = 2^32 / Y is estimated with a floating point reciprocal, scaled down
+// slightly so it never exceeds the real value, then improved with an integer
+// Newton-Raphson iteration. The high half of X * Z is then within two of
+// the quotient, which is corrected by comparing the remainder with Y
+// (twice). This is the same approach the AMDGPU backend uses for its 32-bit
+// division.
+//
+// If Y has its top bit set, it can't be converted to a float with a signed
+// conversion, but the quotient is just X >= Y.
+static SDValue getUnsignedDivRem(SDValue X, SDValue Y, bool IsRem, SDLoc DL,
+                                 SelectionDAG &DAG) {
+  EVT VT = X.getValueType();
+  EVT FloatVT = VT.isVector() ? MVT::v16f32 : MVT::f32;
+  SDValue Zero = DAG.getConstant(0, VT);
+  SDValue One = DAG.getConstant(1, VT);
+
+  // The conversion back to integer is signed, so compute Z / 2 and double it.
+  SDValue Rcp = getReciprocal(DAG.getNode(ISD::SINT_TO_FP, DL, FloatVT, Y),
+                              DL, DAG);
+  SDValue ScaledRcp = DAG.getNode(ISD::FMUL, DL, FloatVT, Rcp,
+                                  DAG.getConstantFP(2147481600.0, FloatVT));
+  SDValue Z = DAG.getNode(ISD::SHL, DL, VT,
+                          DAG.getNode(ISD::FP_TO_SINT, DL, VT, ScaledRcp),
+                          One);
+
+  // Z = Z + Z * (2^32 - Y * Z) / 2^32
+  SDValue NegYZ = DAG.getNode(ISD::MUL, DL, VT,
+                              DAG.getNode(ISD::SUB, DL, VT, Zero, Y), Z);
+  Z = DAG.getNode(ISD::ADD, DL, VT, Z,
+                  DAG.getNode(ISD::MULHU, DL, VT, Z, NegYZ));
+
+  SDValue Q = DAG.getNode(ISD::MULHU, DL, VT, X, Z);
+  SDValue R = DAG.getNode(ISD::SUB, DL, VT, X,
+                          DAG.getNode(ISD::MUL, DL, VT, Q, Y));
+  for (int i = 0; i < 2; i++) {
+    SDValue TooSmall = getCompareBit(R, Y, ISD::SETUGE, DL, DAG);
+    Q = DAG.getNode(ISD::ADD, DL, VT, Q, TooSmall);
+    R = DAG.getNode(ISD::SUB, DL, VT, R,
+                    DAG.getNode(ISD::AND, DL, VT, Y,
+                                DAG.getNode(ISD::SUB, DL, VT, Zero, TooSmall)));
+  }
+
+  // All ones if the top bit of Y is set
+  SDValue BigY = DAG.getNode(ISD::SRA, DL, VT, Y, DAG.getConstant(31, VT));
+  SDValue BigResult;
+  SDValue Result;
+  SDValue XGreater = getCompareBit(X, Y, ISD::SETUGE, DL, DAG);
+  if (IsRem) {
+    Result = R;
+    BigResult = DAG.getNode(
+        ISD::SUB, DL, VT, X,
+        DAG.getNode(ISD::AND, DL, VT, Y,
+                    DAG.getNode(ISD::SUB, DL, VT, Zero, XGreater)));
   } else {
-    ConstantFPSDNode *C = dyn_cast<ConstantFPSDNode>(Op.getOperand(0));
-    IsOne = C && C->isExactlyValue(1.0);
+    Result = Q;
+    BigResult = XGreater;
   }
 
-  if (!IsOne)
-    Estimate = DAG.getNode(ISD::FMUL, DL, Type, Op.getOperand(0), Estimate);
+  return DAG.getNode(
+      ISD::OR, DL, VT, DAG.getNode(ISD::AND, DL, VT, BigResult, BigY),
+      DAG.getNode(ISD::AND, DL, VT, Result,
+                  DAG.getNode(ISD::XOR, DL, VT, BigY,
+                              DAG.getConstant(-1, VT))));
+}
 
-  return Estimate;
+// Signed division and remainder use the unsigned algorithm on the absolute
+// values, then fix the sign of the result. The quotient is negative if the
+// signs of the operands differ, and the remainder has the sign of the
+// dividend.
+SDValue NyuziTargetLowering::LowerDIVREM(SDValue Op, SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  EVT VT = Op.getValueType();
+  SDValue X = Op.getOperand(0);
+  SDValue Y = Op.getOperand(1);
+  unsigned Opcode = Op.getOpcode();
+  bool IsRem = Opcode == ISD::UREM || Opcode == ISD::SREM;
+  if (Opcode == ISD::UDIV || Opcode == ISD::UREM)
+    return getUnsignedDivRem(X, Y, IsRem, DL, DAG);
+
+  SDValue SignBit = DAG.getConstant(31, VT);
+  SDValue XSign = DAG.getNode(ISD::SRA, DL, VT, X, SignBit);
+  SDValue YSign = DAG.getNode(ISD::SRA, DL, VT, Y, SignBit);
+
+  // abs(x) = (x ^ sign) - sign
+  SDValue AbsX = DAG.getNode(ISD::SUB, DL, VT,
+                             DAG.getNode(ISD::XOR, DL, VT, X, XSign), XSign);
+  SDValue AbsY = DAG.getNode(ISD::SUB, DL, VT,
+                             DAG.getNode(ISD::XOR, DL, VT, Y, YSign), YSign);
+  SDValue Result = getUnsignedDivRem(AbsX, AbsY, IsRem, DL, DAG);
+  SDValue ResultSign =
+      IsRem ? XSign : DAG.getNode(ISD::XOR, DL, VT, XSign, YSign);
+  return DAG.getNode(ISD::SUB, DL, VT,
+                     DAG.getNode(ISD::XOR, DL, VT, Result, ResultSign),
+                     ResultSign);
 }
 
 // Branch using jump table (used for switch statements)
@@ -814,6 +1623,10 @@ SDValue NyuziTargetLowering::LowerSETCC(SDValue Op,
   ISD::CondCode NewCode;
   SDLoc DL(Op);
 
+  // Vector comparisons produce a mask in a scalar register.
+  if (Op.getValueType().isVector())
+    return getMaskBoolVector(getVectorCompareMask(Op, DAG), DL, DAG);
+
   switch (CC) {
   default:
     return Op; // No change
@@ -864,36 +1677,219 @@ NyuziTargetLowering::LowerCTTZ_ZERO_UNDEF(SDValue Op,
   return DAG.getNode(ISD::CTTZ, DL, Op.getValueType(), Op.getOperand(0));
 }
 
+//
+// Population count, adding bits in parallel within the word: first the pairs
+// of bits, then nibbles, then bytes. The multiply sums the four byte counts
+// into the top byte. This works the same way on vectors and scalars.
+//
+SDValue NyuziTargetLowering::LowerCTPOP(SDValue Op, SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  EVT Type = Op.getValueType();
+  SDValue X = Op.getOperand(0);
+  auto Shift = [&](unsigned Opcode, SDValue Value, unsigned Amount) {
+    return DAG.getNode(Opcode, DL, Type, Value, DAG.getConstant(Amount, Type));
+  };
+  auto And = [&](SDValue Value, unsigned Mask) {
+    return DAG.getNode(ISD::AND, DL, Type, Value, DAG.getConstant(Mask, Type));
+  };
+
+  // x - ((x >> 1) & 0x55555555)
+  SDValue Pairs = DAG.getNode(ISD::SUB, DL, Type, X,
+                              And(Shift(ISD::SRL, X, 1), 0x55555555));
+
+  // (x & 0x33333333) + ((x >> 2) & 0x33333333)
+  SDValue Nibbles = DAG.getNode(ISD::ADD, DL, Type, And(Pairs, 0x33333333),
+                                And(Shift(ISD::SRL, Pairs, 2), 0x33333333));
+
+  // (x + (x >> 4)) & 0x0f0f0f0f
+  SDValue Bytes = And(DAG.getNode(ISD::ADD, DL, Type, Nibbles,
+                                  Shift(ISD::SRL, Nibbles, 4)),
+                      0x0f0f0f0f);
+
+  // (x * 0x01010101) >> 24
+  return Shift(ISD::SRL, DAG.getNode(ISD::MUL, DL, Type, Bytes,
+                                     DAG.getConstant(0x01010101, Type)),
+               24);
+}
+
+//
+// Byte swap. This first swaps the bytes within each halfword, then swaps the
+// halfwords with a rotate. Shuffles only move whole lanes, so vectors use the
+// same sequence as scalars.
+//
+SDValue NyuziTargetLowering::LowerBSWAP(SDValue Op, SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  EVT Type = Op.getValueType();
+  SDValue X = Op.getOperand(0);
+  SDValue ByteMask = DAG.getConstant(0x00ff00ff, Type);
+  SDValue Eight = DAG.getConstant(8, Type);
+  SDValue Sixteen = DAG.getConstant(16, Type);
+
+  // ((x & 0x00ff00ff) << 8) | ((x >> 8) & 0x00ff00ff)
+  SDValue Swapped = DAG.getNode(
+      ISD::OR, DL, Type,
+      DAG.getNode(ISD::SHL, DL, Type,
+                  DAG.getNode(ISD::AND, DL, Type, X, ByteMask), Eight),
+      DAG.getNode(ISD::AND, DL, Type,
+                  DAG.getNode(ISD::SRL, DL, Type, X, Eight), ByteMask));
+
+  return DAG.getNode(ISD::OR, DL, Type,
+                     DAG.getNode(ISD::SHL, DL, Type, Swapped, Sixteen),
+                     DAG.getNode(ISD::SRL, DL, Type, Swapped, Sixteen));
+}
+
 //
 // The architecture only supports signed integer to floating point.  If the
-// source value is negative (when treated as signed), then add UINT_MAX to the
-// resulting floating point value to adjust it.
-// This is a simpler version of SelectionDAGLegalize::ExpandLegalINT_TO_FP.
-// I've done a custom expansion because the default version uses arithmetic
-// with constant pool symbols, and that gets clobbered (see comments in
-// NyuziMCInstLower::Lower)
+// source value is negative (when treated as signed), then add 2^32 to the
+// resulting floating point value to adjust it. The sign bit, smeared across
+// the word, masks the adjustment, so this doesn't need a select.
 //
 SDValue NyuziTargetLowering::LowerUINT_TO_FP(SDValue Op,
                                                   SelectionDAG &DAG) const {
   SDLoc DL(Op);
+  EVT Type = Op.getValueType();
+  EVT IntType = Op.getOperand(0).getValueType();
 
   SDValue RVal = Op.getOperand(0);
-  SDValue SignedVal = DAG.getNode(ISD::SINT_TO_FP, DL, MVT::f32, RVal);
-  Constant *FudgeFactor =
-      ConstantInt::get(Type::getInt32Ty(*DAG.getContext()),
-                       0x4f800000); // UINT_MAX in float format
-  SDValue CPIdx = DAG.getConstantPool(FudgeFactor, MVT::f32);
-  SDValue FudgeInReg = DAG.getLoad(MVT::f32, DL, DAG.getEntryNode(), CPIdx,
-                                   MachinePointerInfo::getConstantPool(), false,
-                                   false, false, 4);
-  SDValue IsNegative =
-      DAG.getSetCC(DL, getSetCCResultType(*DAG.getContext(), MVT::i32), RVal,
-                   DAG.getConstant(0, MVT::i32), ISD::SETLT);
-  SDValue Adjusted =
-      DAG.getNode(ISD::FADD, DL, MVT::f32, SignedVal, FudgeInReg);
-
-  return DAG.getNode(NyuziISD::SEL_COND_RESULT, DL, MVT::f32, IsNegative,
-                     Adjusted, SignedVal);
+  SDValue SignedVal = DAG.getNode(ISD::SINT_TO_FP, DL, Type, RVal);
+  SDValue IsNegative = DAG.getNode(ISD::SRA, DL, IntType, RVal,
+                                   DAG.getConstant(31, IntType));
+  SDValue Adjust = DAG.getNode(
+      ISD::BITCAST, DL, Type,
+      DAG.getNode(ISD::AND, DL, IntType, IsNegative,
+                  DAG.getConstant(0x4f800000, IntType))); // 2^32
+  return DAG.getNode(ISD::FADD, DL, Type, SignedVal, Adjust);
+}
+
+//
+// Values that are 2^31 or larger don't fit in a signed integer, so 2^31 is
+// subtracted before converting them and the top bit of the result is set
+// afterwards.
+//
+SDValue NyuziTargetLowering::LowerFP_TO_UINT(SDValue Op,
+                                             SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  EVT Type = Op.getOperand(0).getValueType();
+  EVT IntType = Op.getValueType();
+  SDValue X = Op.getOperand(0);
+  SDValue Limit = DAG.getConstantFP(2147483648.0, Type);
+  SDValue TopBit = DAG.getConstant(0x80000000, IntType);
+
+  if (Type.isVector()) {
+    SDValue Converted = DAG.getNode(
+        ISD::FP_TO_SINT, DL, IntType,
+        replaceIf(X, ISD::SETOGE, Limit,
+                  DAG.getNode(ISD::FSUB, DL, Type, X, Limit), X, DL, DAG));
+    return replaceIf(X, ISD::SETOGE, Limit,
+                     DAG.getNode(ISD::XOR, DL, IntType, Converted, TopBit),
+                     Converted, DL, DAG);
+  }
+
+  SDValue IsLarge = getCompareBit(X, Limit, ISD::SETOGE, DL, DAG);
+  SDValue Adjust = DAG.getNode(
+      ISD::BITCAST, DL, Type,
+      DAG.getNode(ISD::AND, DL, IntType,
+                  DAG.getNode(ISD::SUB, DL, IntType,
+                              DAG.getConstant(0, IntType), IsLarge),
+                  DAG.getNode(ISD::BITCAST, DL, IntType, Limit)));
+  SDValue Converted = DAG.getNode(ISD::FP_TO_SINT, DL, IntType,
+                                  DAG.getNode(ISD::FSUB, DL, Type, X, Adjust));
+  return DAG.getNode(ISD::XOR, DL, IntType, Converted,
+                     DAG.getNode(ISD::SHL, DL, IntType, IsLarge,
+                                 DAG.getConstant(31, IntType)));
+}
+
+// Add Step (+/-1.0) to Value in the elements where A CC B. Vectors use a
+// masked add. Scalars subtract the negated step, masked with the comparison
+// result, which leaves -0.0 unchanged when the mask is zero.
+static SDValue addOneIf(SDValue A, ISD::CondCode CC, SDValue B, SDValue Value,
+                        SDValue Step, SDLoc DL, SelectionDAG &DAG) {
+  EVT Type = Value.getValueType();
+  if (Type.isVector())
+    return replaceIf(A, CC, B, DAG.getNode(ISD::FADD, DL, Type, Value, Step),
+                     Value, DL, DAG);
+
+  SDValue Mask = DAG.getNode(ISD::SUB, DL, MVT::i32,
+                             DAG.getConstant(0, MVT::i32),
+                             getCompareBit(A, B, CC, DL, DAG));
+  SDValue NegStep = DAG.getNode(ISD::FNEG, DL, Type, Step);
+  return DAG.getNode(
+      ISD::FSUB, DL, Type, Value,
+      DAG.getNode(ISD::BITCAST, DL, Type,
+                  DAG.getNode(ISD::AND, DL, MVT::i32, Mask,
+                              DAG.getNode(ISD::BITCAST, DL, MVT::i32,
+                                          NegStep))));
+}
+
+//
+// Rounding to an integral value. The value is truncated by converting it to
+// an integer and back, with the sign copied from the original so negative
+// values that truncate to zero give -0.0. Values of 2^23 or more are already
+// integral (as are infinities and NaNs) and may not fit in an integer, so
+// they are left unchanged. The other rounding modes then move the truncated
+// value by one where needed. None of these need a branch.
+//
+SDValue NyuziTargetLowering::LowerFROUND(SDValue Op, SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  EVT Type = Op.getValueType();
+  EVT IntType = Type.isVector() ? MVT::v16i32 : MVT::i32;
+  SDValue X = Op.getOperand(0);
+
+  SDValue IntVal = DAG.getNode(ISD::FP_TO_SINT, DL, IntType, X);
+  SDValue Sign = DAG.getNode(ISD::AND, DL, IntType,
+                             DAG.getNode(ISD::BITCAST, DL, IntType, X),
+                             DAG.getConstant(0x80000000, IntType));
+  SDValue Truncated = DAG.getNode(
+      ISD::BITCAST, DL, Type,
+      DAG.getNode(ISD::OR, DL, IntType,
+                  DAG.getNode(ISD::BITCAST, DL, IntType,
+                              DAG.getNode(ISD::SINT_TO_FP, DL, Type, IntVal)),
+                  Sign));
+  Truncated = getSelectOnCompare(DAG.getNode(ISD::FABS, DL, Type, X),
+                                 DAG.getConstantFP(8388608.0, Type),
+                                 ISD::SETOLT, Truncated, X, DL, DAG);
+
+  switch (Op.getOpcode()) {
+  case ISD::FTRUNC:
+    return Truncated;
+
+  case ISD::FFLOOR:
+    return addOneIf(Truncated, ISD::SETOGT, X, Truncated,
+                    DAG.getConstantFP(-1.0, Type), DL, DAG);
+
+  case ISD::FCEIL:
+    return addOneIf(Truncated, ISD::SETOLT, X, Truncated,
+                    DAG.getConstantFP(1.0, Type), DL, DAG);
+
+  default: {
+    // Round away from zero if the fraction is one half or more for FROUND.
+    // FRINT and FNEARBYINT (assuming the default rounding mode) round a
+    // fraction of exactly one half to the even neighbor instead. The next
+    // float above 0.5 is 0.5 + 2^-24, and no fraction lies between the two,
+    // so comparing against that when the truncated value is even does this.
+    SDValue Fraction = DAG.getNode(ISD::FABS, DL, Type,
+                                   DAG.getNode(ISD::FSUB, DL, Type, X,
+                                               Truncated));
+    SDValue Threshold;
+    if (Op.getOpcode() == ISD::FROUND)
+      Threshold = DAG.getConstantFP(0.5, Type);
+    else {
+      Threshold = DAG.getNode(
+          ISD::BITCAST, DL, Type,
+          DAG.getNode(ISD::SUB, DL, IntType,
+                      DAG.getConstant(0x3f000001, IntType),
+                      DAG.getNode(ISD::AND, DL, IntType, IntVal,
+                                  DAG.getConstant(1, IntType))));
+    }
+
+    SDValue SignedOne = DAG.getNode(
+        ISD::BITCAST, DL, Type,
+        DAG.getNode(ISD::OR, DL, IntType, Sign,
+                    DAG.getConstant(0x3f800000, IntType)));
+    return addOneIf(Fraction, ISD::SETOGE, Threshold, Truncated, SignedOne, DL,
+                    DAG);
+  }
+  }
 }
 
 SDValue NyuziTargetLowering::LowerFRAMEADDR(SDValue Op, SelectionDAG &DAG) const {
@@ -1020,42 +2016,670 @@ static Intrinsic::ID intrinsicForVectorCompare(ISD::CondCode CC, bool isFloat) {
 SDValue NyuziTargetLowering::LowerSIGN_EXTEND_INREG(SDValue Op, 
                                                          SelectionDAG &DAG) const {
   SDValue SetCcOp = Op.getOperand(0);
-  if (SetCcOp.getOpcode() != ISD::SETCC)
-    return SDValue();
+  if (SetCcOp.getOpcode() == ISD::SETCC)
+    return getMaskBoolVector(getVectorCompareMask(SetCcOp, DAG), SDLoc(Op), DAG);
 
-  SDLoc DL(Op);
-  Intrinsic::ID intrinsic = intrinsicForVectorCompare(cast<CondCodeSDNode>(
-                                                      SetCcOp.getOperand(2))->get(),
-                                                      SetCcOp.getOperand(0).getValueType()
-                                                      .getSimpleVT().isFloatingPoint());
+  // Already expanded by LowerSETCC
+  if (getBoolVectorMask(SetCcOp).getNode())
+    return SetCcOp;
 
-  SDValue FalseVal = DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32,
-                             DAG.getConstant(0, MVT::i32));
-  SDValue TrueVal = DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32, 
-                            DAG.getConstant(0xffffffff, MVT::i32));
-  SDValue Mask = DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, MVT::i32,
-                             DAG.getConstant(intrinsic, MVT::i32), 
-                             SetCcOp.getOperand(0), SetCcOp.getOperand(1));
-  return DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, MVT::v16i32,
-                     DAG.getConstant(Intrinsic::nyuzi_vector_mixi, MVT::i32), Mask,
-                     TrueVal, FalseVal);
+  return SDValue();
 }
 
-SDValue NyuziTargetLowering::LowerOperation(SDValue Op,
-                                                 SelectionDAG &DAG) const {
-  switch (Op.getOpcode()) {
-  case ISD::VECTOR_SHUFFLE:
-    return LowerVECTOR_SHUFFLE(Op, DAG);
-  case ISD::BUILD_VECTOR:
-    return LowerBUILD_VECTOR(Op, DAG);
-  case ISD::INSERT_VECTOR_ELT:
-    return LowerINSERT_VECTOR_ELT(Op, DAG);
-  case ISD::SCALAR_TO_VECTOR:
-    return LowerSCALAR_TO_VECTOR(Op, DAG);
-  case ISD::GlobalAddress:
-    return LowerGlobalAddress(Op, DAG);
-  case ISD::BlockAddress:
-    return LowerBlockAddress(Op, DAG);
+static bool hasMaskedForm(unsigned Opcode) {
+  switch (Opcode) {
+  case ISD::OR:
+  case ISD::AND:
+  case ISD::XOR:
+  case ISD::ADD:
+  case ISD::SUB:
+  case ISD::MUL:
+  case ISD::MULHU:
+  case ISD::MULHS:
+  case ISD::SRA:
+  case ISD::SRL:
+  case ISD::SHL:
+  case ISD::CTLZ:
+  case ISD::CTTZ:
+  case ISD::FADD:
+  case ISD::FSUB:
+  case ISD::FMUL:
+  case NyuziISD::RECIPROCAL_EST:
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+// Convert a vector of booleans to a scalar lane mask.
+static SDValue getLaneMask(SDValue Cond, SDLoc DL, SelectionDAG &DAG) {
+  SDValue Mask;
+  if (Cond.getOpcode() == ISD::SETCC)
+    Mask = getVectorCompareMask(Cond, DAG);
+  else
+    Mask = getBoolVectorMask(Cond);
+
+  if (Mask.getNode())
+    return Mask;
+
+  if (ISD::isBuildVectorOfConstantSDNodes(Cond.getNode())) {
+    unsigned MaskVal = 0;
+    for (unsigned i = 0; i < 16; i++) {
+      if (!isZero(Cond.getOperand(i)))
+        MaskVal |= 0x8000 >> i;
+    }
+
+    return DAG.getConstant(MaskVal, MVT::i32);
+  }
+
+  // Arbitrary condition vector. Lanes are either all ones or zero.
+  SDValue Zero = DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32,
+                             DAG.getConstant(0, MVT::i32));
+  return DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, MVT::i32,
+                     DAG.getConstant(Intrinsic::nyuzi_mask_cmpi_ne, MVT::i32),
+                     DAG.getNode(ISD::BITCAST, DL, MVT::v16i32, Cond), Zero);
+}
+
+//
+// Convert the condition to a lane mask and use a masked move. The masked
+// move is folded into the instruction that computes the selected value if
+// that instruction has a masked form. If only the false value can be
+// folded, invert the mask and swap the operands.
+//
+SDValue NyuziTargetLowering::LowerVSELECT(SDValue Op, SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  MVT VT = Op.getValueType().getSimpleVT();
+  SDValue Cond = Op.getOperand(0);
+  SDValue TrueVal = Op.getOperand(1);
+  SDValue FalseVal = Op.getOperand(2);
+
+  SDValue Mask = getLaneMask(Cond, DL, DAG);
+  if (hasMaskedForm(FalseVal.getOpcode()) && FalseVal.hasOneUse() &&
+      !(hasMaskedForm(TrueVal.getOpcode()) && TrueVal.hasOneUse())) {
+    Mask = DAG.getNode(ISD::XOR, DL, MVT::i32, Mask,
+                       DAG.getConstant(-1, MVT::i32));
+    std::swap(TrueVal, FalseVal);
+  }
+
+  Intrinsic::ID Mix = VT == MVT::v16f32 ? Intrinsic::nyuzi_vector_mixf
+                                        : Intrinsic::nyuzi_vector_mixi;
+  return DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, VT,
+                     DAG.getConstant(Mix, MVT::i32), Mask, TrueVal, FalseVal);
+}
+
+// Return a vector containing the address of each element of a vector that
+// is stored in memory at Ptr.
+static SDValue getElementAddresses(SDValue Ptr, SDLoc DL, SelectionDAG &DAG) {
+  int Offsets[16];
+  for (int i = 0; i < 16; i++)
+    Offsets[i] = i * 4;
+
+  SDValue PtrVec = DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32, Ptr);
+  return DAG.getNode(ISD::ADD, DL, MVT::v16i32, PtrVec,
+                     getConstantIntVector(Offsets, DL, DAG));
+}
+
+// Load the lanes of VT enabled in Mask from the vector in memory that Mem
+// accesses, using a masked block load if it is 64 byte aligned and a masked
+// gather otherwise. Disabled lanes are undefined.
+static SDValue getMaskedLoad(MVT VT, SDValue Mask, MemSDNode *Mem, SDLoc DL,
+                             SelectionDAG &DAG) {
+  bool IsFloat = VT == MVT::v16f32;
+  SDValue Ops[4];
+  Ops[0] = Mem->getChain();
+  Ops[3] = Mask;
+  if (Mem->getAlignment() >= 64) {
+    Ops[1] = DAG.getConstant(IsFloat ? Intrinsic::nyuzi_block_loadf_masked
+                                     : Intrinsic::nyuzi_block_loadi_masked,
+                             MVT::i32);
+    Ops[2] = Mem->getBasePtr();
+  } else {
+    Ops[1] = DAG.getConstant(IsFloat ? Intrinsic::nyuzi_gather_loadf_masked
+                                     : Intrinsic::nyuzi_gather_loadi_masked,
+                             MVT::i32);
+    Ops[2] = getElementAddresses(Mem->getBasePtr(), DL, DAG);
+  }
+
+  return DAG.getMemIntrinsicNode(ISD::INTRINSIC_W_CHAIN, DL,
+                                 DAG.getVTList(VT, MVT::Other), Ops,
+                                 Mem->getMemoryVT(), Mem->getMemOperand());
+}
+
+// Store the lanes of Value enabled in Mask (see getMaskedLoad).
+static SDValue getMaskedStore(SDValue Value, SDValue Mask, MemSDNode *Mem,
+                              SDLoc DL, SelectionDAG &DAG) {
+  bool IsFloat = Value.getValueType() == MVT::v16f32;
+  SDValue Ops[5];
+  Ops[0] = Mem->getChain();
+  Ops[3] = Value;
+  Ops[4] = Mask;
+  if (Mem->getAlignment() >= 64) {
+    Ops[1] = DAG.getConstant(IsFloat ? Intrinsic::nyuzi_block_storef_masked
+                                     : Intrinsic::nyuzi_block_storei_masked,
+                             MVT::i32);
+    Ops[2] = Mem->getBasePtr();
+  } else {
+    Ops[1] = DAG.getConstant(IsFloat ? Intrinsic::nyuzi_scatter_storef_masked
+                                     : Intrinsic::nyuzi_scatter_storei_masked,
+                             MVT::i32);
+    Ops[2] = getElementAddresses(Mem->getBasePtr(), DL, DAG);
+  }
+
+  return DAG.getMemIntrinsicNode(ISD::INTRINSIC_VOID, DL,
+                                 DAG.getVTList(MVT::Other), Ops,
+                                 Mem->getMemoryVT(), Mem->getMemOperand());
+}
+
+// Mask that enables lanes 0 to NumLanes - 1.
+static SDValue getLeadingLaneMask(unsigned NumLanes, SelectionDAG &DAG) {
+  return DAG.getConstant(0xffff & ~(0xffff >> NumLanes), MVT::i32);
+}
+
+// Vectors with fewer than 16 32-bit elements are widened to a full register.
+static bool isNarrowVector(EVT VT) {
+  return VT.isSimple() && VT.isVector() && VT.getVectorNumElements() < 16 &&
+         VT.getScalarSizeInBits() == 32;
+}
+
+//
+// Vectors of 8 or 16 bit elements are promoted to 32 bit elements. There are
+// no vector loads or stores of bytes or halfwords, so the elements are
+// accessed as packed 32 bit words, which are loaded into the first lanes of a
+// vector and then spread out with a shuffle and shifts.
+//
+static SDValue getExtendingVectorLoad(LoadSDNode *Load, SDLoc DL,
+                                      SelectionDAG &DAG) {
+  EVT MemVT = Load->getMemoryVT();
+  unsigned ElemBits = MemVT.getScalarSizeInBits();
+  unsigned PerWord = 32 / ElemBits;
+  if (Load->getAlignment() < 4) {
+    // Load each element separately.
+    SmallVector<SDValue, 16> Elems;
+    SmallVector<SDValue, 16> Chains;
+    for (int i = 0; i < 16; i++) {
+      unsigned Offset = i * ElemBits / 8;
+      SDValue ElemPtr = DAG.getNode(ISD::ADD, DL, MVT::i32, Load->getBasePtr(),
+                                    DAG.getConstant(Offset, MVT::i32));
+      SDValue Elem = DAG.getExtLoad(
+          Load->getExtensionType(), DL, MVT::i32, Load->getChain(), ElemPtr,
+          Load->getPointerInfo().getWithOffset(Offset),
+          MemVT.getVectorElementType(), Load->isVolatile(),
+          Load->isNonTemporal(), Load->isInvariant(), Load->getAlignment());
+      Elems.push_back(Elem);
+      Chains.push_back(Elem.getValue(1));
+    }
+
+    SDValue Ops[] = { DAG.getNode(ISD::BUILD_VECTOR, DL, MVT::v16i32, Elems),
+                      DAG.getNode(ISD::TokenFactor, DL, MVT::Other, Chains) };
+    return DAG.getMergeValues(Ops, DL);
+  }
+
+  SDValue Words = getMaskedLoad(MVT::v16i32,
+                                getLeadingLaneMask(16 / PerWord, DAG), Load,
+                                DL, DAG);
+  int Indices[16];
+  int Shifts[16];
+  for (int i = 0; i < 16; i++) {
+    Indices[i] = i / PerWord;
+    Shifts[i] = 32 - ElemBits - (i % PerWord) * ElemBits;
+  }
+
+  // Shift each element to the top of its lane, then back down to the bottom,
+  // which also extends it.
+  SDValue Spread = getShuffle(Words, getConstantIntVector(Indices, DL, DAG),
+                              DL, DAG);
+  SDValue Top = DAG.getNode(ISD::SHL, DL, MVT::v16i32, Spread,
+                            getConstantIntVector(Shifts, DL, DAG));
+  unsigned ShiftOp =
+      Load->getExtensionType() == ISD::SEXTLOAD ? ISD::SRA : ISD::SRL;
+  SDValue Ops[] = {
+      DAG.getNode(ShiftOp, DL, MVT::v16i32, Top,
+                  DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32,
+                              DAG.getConstant(32 - ElemBits, MVT::i32))),
+      Words.getValue(1)};
+  return DAG.getMergeValues(Ops, DL);
+}
+
+// Truncating stores pack the elements into words (see getExtendingVectorLoad).
+static SDValue getTruncatingVectorStore(StoreSDNode *Store, SDLoc DL,
+                                        SelectionDAG &DAG) {
+  EVT MemVT = Store->getMemoryVT();
+  unsigned ElemBits = MemVT.getScalarSizeInBits();
+  unsigned PerWord = 32 / ElemBits;
+  SDValue Value = Store->getValue();
+  if (Store->getAlignment() < 4) {
+    SmallVector<SDValue, 16> Chains;
+    for (int i = 0; i < 16; i++) {
+      unsigned Offset = i * ElemBits / 8;
+      SDValue ElemPtr = DAG.getNode(ISD::ADD, DL, MVT::i32,
+                                    Store->getBasePtr(),
+                                    DAG.getConstant(Offset, MVT::i32));
+      SDValue Elem = DAG.getNode(ISD::EXTRACT_VECTOR_ELT, DL, MVT::i32, Value,
+                                 DAG.getConstant(i, MVT::i32));
+      Chains.push_back(DAG.getTruncStore(
+          Store->getChain(), DL, Elem, ElemPtr,
+          Store->getPointerInfo().getWithOffset(Offset),
+          MemVT.getVectorElementType(), Store->isVolatile(),
+          Store->isNonTemporal(), Store->getAlignment()));
+    }
+
+    return DAG.getNode(ISD::TokenFactor, DL, MVT::Other, Chains);
+  }
+
+  // Shift each element to its position in its word, then combine the lanes
+  // that make up each word by or-ing each lane with its neighbors.
+  int Shifts[16];
+  int Compact[16];
+  for (int i = 0; i < 16; i++) {
+    Shifts[i] = (i % PerWord) * ElemBits;
+    Compact[i] = (i * PerWord) & 15;
+  }
+
+  SDValue Packed = DAG.getNode(
+      ISD::SHL, DL, MVT::v16i32,
+      DAG.getNode(ISD::AND, DL, MVT::v16i32, Value,
+                  DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32,
+                              DAG.getConstant((1 << ElemBits) - 1,
+                                              MVT::i32))),
+      getConstantIntVector(Shifts, DL, DAG));
+  for (unsigned Distance = 1; Distance < PerWord; Distance *= 2) {
+    int Indices[16];
+    for (int i = 0; i < 16; i++)
+      Indices[i] = i ^ Distance;
+
+    Packed = DAG.getNode(ISD::OR, DL, MVT::v16i32, Packed,
+                         getShuffle(Packed,
+                                    getConstantIntVector(Indices, DL, DAG),
+                                    DL, DAG));
+  }
+
+  SDValue Words = getShuffle(Packed, getConstantIntVector(Compact, DL, DAG),
+                             DL, DAG);
+  return getMaskedStore(Words, getLeadingLaneMask(16 / PerWord, DAG), Store,
+                        DL, DAG);
+}
+
+//
+// Block loads require the address to be 64 byte aligned. The vectorizers
+// generally only guarantee that vector accesses are aligned to the element
+// size. Rather than letting the legalizer expand those through the stack,
+// convert them to a gather from consecutive addresses. Accesses that aren't
+// even aligned to the element size are split into scalar loads.
+//
+SDValue NyuziTargetLowering::LowerLOAD(SDValue Op, SelectionDAG &DAG) const {
+  LoadSDNode *Load = cast<LoadSDNode>(Op);
+  if (Load->getExtensionType() != ISD::NON_EXTLOAD)
+    return getExtendingVectorLoad(Load, SDLoc(Op), DAG);
+
+  unsigned Align = Load->getAlignment();
+  if (Align >= 64)
+    return SDValue(); // Use a block load
+
+  SDLoc DL(Op);
+  MVT VT = Op.getValueType().getSimpleVT();
+  SDValue Chain = Load->getChain();
+  SDValue Ptr = Load->getBasePtr();
+  if (Align >= 4) {
+    Intrinsic::ID Gather = VT == MVT::v16f32 ? Intrinsic::nyuzi_gather_loadf
+                                             : Intrinsic::nyuzi_gather_loadi;
+    SDValue Ops[] = { Chain, DAG.getConstant(Gather, MVT::i32),
+                      getElementAddresses(Ptr, DL, DAG) };
+    return DAG.getMemIntrinsicNode(ISD::INTRINSIC_W_CHAIN, DL,
+                                   DAG.getVTList(VT, MVT::Other), Ops,
+                                   Load->getMemoryVT(), Load->getMemOperand());
+  }
+
+  MVT ElemVT = VT.getVectorElementType();
+  SmallVector<SDValue, 16> Elems;
+  SmallVector<SDValue, 16> Chains;
+  for (int i = 0; i < 16; i++) {
+    SDValue ElemPtr = DAG.getNode(ISD::ADD, DL, MVT::i32, Ptr,
+                                  DAG.getConstant(i * 4, MVT::i32));
+    SDValue Elem = DAG.getLoad(ElemVT, DL, Chain, ElemPtr,
+                               Load->getPointerInfo().getWithOffset(i * 4),
+                               Load->isVolatile(), Load->isNonTemporal(),
+                               Load->isInvariant(), Align);
+    Elems.push_back(Elem);
+    Chains.push_back(Elem.getValue(1));
+  }
+
+  SDValue Ops[] = { DAG.getNode(ISD::BUILD_VECTOR, DL, VT, Elems),
+                    DAG.getNode(ISD::TokenFactor, DL, MVT::Other, Chains) };
+  return DAG.getMergeValues(Ops, DL);
+}
+
+// Stores are handled the same way as loads (see LowerLOAD).
+//
+// Stores of vectors with fewer than 16 elements are called while the type
+// legalizer widens the stored value. Concatenating it with undef values is
+// replaced by the widened value, and a masked store writes only the lanes of
+// the original vector.
+//
+SDValue NyuziTargetLowering::LowerSTORE(SDValue Op, SelectionDAG &DAG) const {
+  StoreSDNode *Store = cast<StoreSDNode>(Op);
+  SDLoc DL(Op);
+  SDValue Value = Store->getValue();
+  unsigned Align = Store->getAlignment();
+  if (Store->isTruncatingStore())
+    return getTruncatingVectorStore(Store, DL, DAG);
+
+  if (isNarrowVector(Value.getValueType())) {
+    if (Align < 4)
+      return SDValue();
+
+    EVT NarrowVT = Value.getValueType();
+    MVT WideVT = NarrowVT.isFloatingPoint() ? MVT::v16f32 : MVT::v16i32;
+    unsigned NumElems = NarrowVT.getVectorNumElements();
+    SmallVector<SDValue, 8> Parts(16 / NumElems, DAG.getUNDEF(NarrowVT));
+    Parts[0] = Value;
+    return getMaskedStore(
+        DAG.getNode(ISD::CONCAT_VECTORS, DL, WideVT, Parts),
+        getLeadingLaneMask(NumElems, DAG), Store, DL, DAG);
+  }
+
+  if (Align >= 64)
+    return SDValue(); // Use a block store
+
+  MVT VT = Value.getValueType().getSimpleVT();
+  SDValue Chain = Store->getChain();
+  SDValue Ptr = Store->getBasePtr();
+  if (Align >= 4) {
+    Intrinsic::ID Scatter = VT == MVT::v16f32
+                                ? Intrinsic::nyuzi_scatter_storef
+                                : Intrinsic::nyuzi_scatter_storei;
+    SDValue Ops[] = { Chain, DAG.getConstant(Scatter, MVT::i32),
+                      getElementAddresses(Ptr, DL, DAG), Value };
+    return DAG.getMemIntrinsicNode(ISD::INTRINSIC_VOID, DL,
+                                   DAG.getVTList(MVT::Other), Ops,
+                                   Store->getMemoryVT(), Store->getMemOperand());
+  }
+
+  MVT ElemVT = VT.getVectorElementType();
+  SmallVector<SDValue, 16> Chains;
+  for (int i = 0; i < 16; i++) {
+    SDValue ElemPtr = DAG.getNode(ISD::ADD, DL, MVT::i32, Ptr,
+                                  DAG.getConstant(i * 4, MVT::i32));
+    SDValue Elem = DAG.getNode(ISD::EXTRACT_VECTOR_ELT, DL, ElemVT, Value,
+                               DAG.getConstant(i, MVT::i32));
+    Chains.push_back(DAG.getStore(Chain, DL, Elem, ElemPtr,
+                                  Store->getPointerInfo().getWithOffset(i * 4),
+                                  Store->isVolatile(), Store->isNonTemporal(),
+                                  Align));
+  }
+
+  return DAG.getNode(ISD::TokenFactor, DL, MVT::Other, Chains);
+}
+
+//
+// Masked loads use a masked block load if the address is 64 byte aligned and
+// a masked gather otherwise (see LowerLOAD). Neither preserves the disabled
+// lanes of a register, so merge the pass-through value with a masked move.
+//
+SDValue NyuziTargetLowering::LowerMLOAD(SDValue Op, SelectionDAG &DAG) const {
+  MaskedLoadSDNode *Load = cast<MaskedLoadSDNode>(Op);
+  if (Load->getExtensionType() != ISD::NON_EXTLOAD)
+    return SDValue();
+
+  SDLoc DL(Op);
+  MVT VT = Op.getValueType().getSimpleVT();
+  SDValue Mask = getLaneMask(Load->getMask(), DL, DAG);
+  SDValue Result = getMaskedLoad(VT, Mask, Load, DL, DAG);
+  SDValue Value = Result;
+  if (Load->getSrc0().getOpcode() != ISD::UNDEF) {
+    Intrinsic::ID Mix = VT == MVT::v16f32 ? Intrinsic::nyuzi_vector_mixf
+                                          : Intrinsic::nyuzi_vector_mixi;
+    Value = DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, VT,
+                        DAG.getConstant(Mix, MVT::i32), Mask, Result,
+                        Load->getSrc0());
+  }
+
+  SDValue RetOps[] = { Value, Result.getValue(1) };
+  return DAG.getMergeValues(RetOps, DL);
+}
+
+// Masked stores are handled the same way as masked loads (see LowerMLOAD).
+SDValue NyuziTargetLowering::LowerMSTORE(SDValue Op, SelectionDAG &DAG) const {
+  MaskedStoreSDNode *Store = cast<MaskedStoreSDNode>(Op);
+  if (Store->isTruncatingStore())
+    return SDValue();
+
+  SDLoc DL(Op);
+  return getMaskedStore(Store->getValue(),
+                        getLaneMask(Store->getMask(), DL, DAG), Store, DL,
+                        DAG);
+}
+
+//
+// A horizontal reduction is a butterfly: each step shuffles the vector so
+// every lane gets the value from the lane whose index differs in one bit
+// (lane ^ 8, then 4, 2, and 1), and combines that with its own. After four
+// steps every lane holds the result, compared to fifteen steps for
+// extracting each lane and reducing them as scalars. The shuffle indices are
+// a single xor of the lane numbers (see getSwizzleBits). Minimum and maximum
+// compare the two vectors and merge them with a masked move.
+//
+SDValue NyuziTargetLowering::LowerINTRINSIC_WO_CHAIN(SDValue Op,
+                                                     SelectionDAG &DAG) const {
+  unsigned Opcode = 0;
+  ISD::CondCode CC = ISD::SETCC_INVALID;
+  switch (cast<ConstantSDNode>(Op.getOperand(0))->getZExtValue()) {
+  case Intrinsic::nyuzi_reduce_addi: Opcode = ISD::ADD; break;
+  case Intrinsic::nyuzi_reduce_muli: Opcode = ISD::MUL; break;
+  case Intrinsic::nyuzi_reduce_andi: Opcode = ISD::AND; break;
+  case Intrinsic::nyuzi_reduce_ori: Opcode = ISD::OR; break;
+  case Intrinsic::nyuzi_reduce_xori: Opcode = ISD::XOR; break;
+  case Intrinsic::nyuzi_reduce_addf: Opcode = ISD::FADD; break;
+  case Intrinsic::nyuzi_reduce_mulf: Opcode = ISD::FMUL; break;
+  case Intrinsic::nyuzi_reduce_smini: CC = ISD::SETLT; break;
+  case Intrinsic::nyuzi_reduce_smaxi: CC = ISD::SETGT; break;
+  case Intrinsic::nyuzi_reduce_umini: CC = ISD::SETULT; break;
+  case Intrinsic::nyuzi_reduce_umaxi: CC = ISD::SETUGT; break;
+  case Intrinsic::nyuzi_reduce_minf: CC = ISD::SETOLT; break;
+  case Intrinsic::nyuzi_reduce_maxf: CC = ISD::SETOGT; break;
+  default:
+    return SDValue(); // Other intrinsics are selected directly.
+  }
+
+  SDLoc DL(Op);
+  SDValue Vec = Op.getOperand(1);
+  MVT VT = Vec.getValueType().getSimpleVT();
+  bool IsFloat = VT == MVT::v16f32;
+  SDValue LaneNumVec = getLaneNumbers(DL, DAG);
+  for (int Distance = 8; Distance > 0; Distance /= 2) {
+    SDValue Indices =
+        DAG.getNode(ISD::XOR, DL, MVT::v16i32, LaneNumVec,
+                    DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32,
+                                DAG.getConstant(Distance, MVT::i32)));
+    SDValue Swapped = getShuffle(Vec, Indices, DL, DAG);
+    if (Opcode != 0) {
+      Vec = DAG.getNode(Opcode, DL, VT, Vec, Swapped);
+      continue;
+    }
+
+    SDValue Mask = DAG.getNode(
+        ISD::INTRINSIC_WO_CHAIN, DL, MVT::i32,
+        DAG.getConstant(intrinsicForVectorCompare(CC, IsFloat), MVT::i32), Vec,
+        Swapped);
+    Intrinsic::ID Mix = IsFloat ? Intrinsic::nyuzi_vector_mixf
+                                : Intrinsic::nyuzi_vector_mixi;
+    Vec = DAG.getNode(ISD::INTRINSIC_WO_CHAIN, DL, VT,
+                      DAG.getConstant(Mix, MVT::i32), Mask, Vec, Swapped);
+  }
+
+  return DAG.getNode(ISD::EXTRACT_VECTOR_ELT, DL, VT.getVectorElementType(),
+                     Vec, DAG.getConstant(0, MVT::i32));
+}
+
+//
+// There is no prefetch instruction, so prefetches are dropped by default. A
+// load would suspend the issuing thread until the line is filled, which
+// doesn't hide any latency from that thread, and it could fault or read a
+// device register where a prefetch wouldn't. With -nyuzi-prefetch-loads, a
+// data prefetch is a byte load into a register that is never read, which
+// lets the other hardware threads run while the line is filled. The load is
+// volatile so it isn't deleted for having no users. Instruction prefetches
+// are always dropped.
+//
+SDValue NyuziTargetLowering::LowerPREFETCH(SDValue Op,
+                                           SelectionDAG &DAG) const {
+  SDValue Chain = Op.getOperand(0);
+  if (!PrefetchLoads ||
+      cast<ConstantSDNode>(Op.getOperand(4))->getZExtValue() == 0)
+    return Chain;
+
+  SDValue Touch = DAG.getExtLoad(ISD::ZEXTLOAD, SDLoc(Op), MVT::i32, Chain,
+                                 Op.getOperand(1), MachinePointerInfo(),
+                                 MVT::i8, true, false, false, 1);
+  return Touch.getValue(1);
+}
+
+//
+// Shifts of 64 bit values. For a shift amount N, both halves are first
+// shifted by N & 31 as if N were less than 32, with the bits that cross
+// between halves funneled in. Shifting by (N & 31) ^ 31 after a shift by one
+// avoids an undefined shift by 32 when N & 31 is zero. Bit 5 of N, smeared
+// into a mask, then picks the results for N >= 32 without a branch.
+//
+SDValue NyuziTargetLowering::LowerShiftParts(SDValue Op,
+                                             SelectionDAG &DAG) const {
+  SDLoc DL(Op);
+  EVT VT = Op.getValueType();
+  SDValue Lo = Op.getOperand(0);
+  SDValue Hi = Op.getOperand(1);
+  SDValue Amt = DAG.getNode(ISD::AND, DL, VT, Op.getOperand(2),
+                            DAG.getConstant(31, VT));
+  SDValue InvAmt =
+      DAG.getNode(ISD::XOR, DL, VT, Amt, DAG.getConstant(31, VT));
+  SDValue One = DAG.getConstant(1, VT);
+  SDValue IsBig = DAG.getNode(
+      ISD::SRA, DL, VT,
+      DAG.getNode(ISD::SHL, DL, VT, Op.getOperand(2),
+                  DAG.getConstant(26, VT)),
+      DAG.getConstant(31, VT));
+  SDValue IsSmall =
+      DAG.getNode(ISD::XOR, DL, VT, IsBig, DAG.getConstant(-1, VT));
+
+  // (Big & IsBig) | (Small & ~IsBig)
+  auto choose = [&](SDValue Big, SDValue Small) {
+    return DAG.getNode(
+        ISD::XOR, DL, VT, Small,
+        DAG.getNode(ISD::AND, DL, VT,
+                    DAG.getNode(ISD::XOR, DL, VT, Small, Big), IsBig));
+  };
+
+  SDValue NewLo, NewHi;
+  if (Op.getOpcode() == ISD::SHL_PARTS) {
+    SDValue Shifted = DAG.getNode(ISD::SHL, DL, VT, Lo, Amt);
+    SDValue Carried = DAG.getNode(ISD::SRL, DL, VT,
+                                  DAG.getNode(ISD::SRL, DL, VT, Lo, One),
+                                  InvAmt);
+    SDValue HiSmall =
+        DAG.getNode(ISD::OR, DL, VT, DAG.getNode(ISD::SHL, DL, VT, Hi, Amt),
+                    Carried);
+    NewLo = DAG.getNode(ISD::AND, DL, VT, Shifted, IsSmall);
+    NewHi = choose(Shifted, HiSmall);
+  } else {
+    unsigned ShiftOp = Op.getOpcode() == ISD::SRA_PARTS ? ISD::SRA : ISD::SRL;
+    SDValue Shifted = DAG.getNode(ShiftOp, DL, VT, Hi, Amt);
+    SDValue Carried = DAG.getNode(ISD::SHL, DL, VT,
+                                  DAG.getNode(ISD::SHL, DL, VT, Hi, One),
+                                  InvAmt);
+    SDValue LoSmall =
+        DAG.getNode(ISD::OR, DL, VT, DAG.getNode(ISD::SRL, DL, VT, Lo, Amt),
+                    Carried);
+    NewLo = choose(Shifted, LoSmall);
+    if (ShiftOp == ISD::SRA)
+      NewHi = choose(DAG.getNode(ISD::SRA, DL, VT, Hi,
+                                 DAG.getConstant(31, VT)),
+                     Shifted);
+    else
+      NewHi = DAG.getNode(ISD::AND, DL, VT, Shifted, IsSmall);
+  }
+
+  SDValue Ops[] = {NewLo, NewHi};
+  return DAG.getMergeValues(Ops, DL);
+}
+
+//
+// 64 bit addition and subtraction. There are no carry flags, so the carry
+// out of the low word is an unsigned compare, which sets the low bit of a
+// register that can be added directly into the high word. The generic
+// expansion turns it into a select, which needs a branch.
+//
+void NyuziTargetLowering::ReplaceNodeResults(SDNode *N,
+                                             SmallVectorImpl<SDValue> &Results,
+                                             SelectionDAG &DAG) const {
+  SDLoc DL(N);
+  switch (N->getOpcode()) {
+  case ISD::ADD:
+  case ISD::SUB: {
+    SDValue Zero = DAG.getConstant(0, MVT::i32);
+    SDValue One = DAG.getConstant(1, MVT::i32);
+    SDValue ALo = DAG.getNode(ISD::EXTRACT_ELEMENT, DL, MVT::i32,
+                              N->getOperand(0), Zero);
+    SDValue AHi = DAG.getNode(ISD::EXTRACT_ELEMENT, DL, MVT::i32,
+                              N->getOperand(0), One);
+    SDValue BLo = DAG.getNode(ISD::EXTRACT_ELEMENT, DL, MVT::i32,
+                              N->getOperand(1), Zero);
+    SDValue BHi = DAG.getNode(ISD::EXTRACT_ELEMENT, DL, MVT::i32,
+                              N->getOperand(1), One);
+
+    SDValue Lo, Hi;
+    if (N->getOpcode() == ISD::ADD) {
+      Lo = DAG.getNode(ISD::ADD, DL, MVT::i32, ALo, BLo);
+      SDValue Carry = getCompareBit(Lo, ALo, ISD::SETULT, DL, DAG);
+      Hi = DAG.getNode(ISD::ADD, DL, MVT::i32,
+                       DAG.getNode(ISD::ADD, DL, MVT::i32, AHi, BHi), Carry);
+    } else {
+      Lo = DAG.getNode(ISD::SUB, DL, MVT::i32, ALo, BLo);
+      SDValue Borrow = getCompareBit(ALo, BLo, ISD::SETULT, DL, DAG);
+      Hi = DAG.getNode(ISD::SUB, DL, MVT::i32,
+                       DAG.getNode(ISD::SUB, DL, MVT::i32, AHi, BHi), Borrow);
+    }
+
+    Results.push_back(DAG.getNode(ISD::BUILD_PAIR, DL, MVT::i64, Lo, Hi));
+    break;
+  }
+
+  // Loads of vectors with fewer than 16 elements load the first lanes of a
+  // full vector, which the type legalizer uses as the widened result.
+  case ISD::LOAD: {
+    LoadSDNode *Load = cast<LoadSDNode>(N);
+    EVT VT = N->getValueType(0);
+    if (!isNarrowVector(VT) || Load->getExtensionType() != ISD::NON_EXTLOAD ||
+        Load->getAlignment() < 4)
+      break;
+
+    MVT WideVT = VT.isFloatingPoint() ? MVT::v16f32 : MVT::v16i32;
+    SDValue Result = getMaskedLoad(
+        WideVT, getLeadingLaneMask(VT.getVectorNumElements(), DAG), Load, DL,
+        DAG);
+    Results.push_back(Result);
+    Results.push_back(Result.getValue(1));
+    break;
+  }
+
+  default:
+    break;
+  }
+}
+
+SDValue NyuziTargetLowering::LowerOperation(SDValue Op,
+                                                 SelectionDAG &DAG) const {
+  switch (Op.getOpcode()) {
+  case ISD::VECTOR_SHUFFLE:
+    return LowerVECTOR_SHUFFLE(Op, DAG);
+  case ISD::BUILD_VECTOR:
+    return LowerBUILD_VECTOR(Op, DAG);
+  case ISD::INSERT_VECTOR_ELT:
+    return LowerINSERT_VECTOR_ELT(Op, DAG);
+  case ISD::SCALAR_TO_VECTOR:
+    return LowerSCALAR_TO_VECTOR(Op, DAG);
+  case ISD::GlobalAddress:
+    return LowerGlobalAddress(Op, DAG);
+  case ISD::BlockAddress:
+    return LowerBlockAddress(Op, DAG);
   case ISD::ConstantPool:
     return LowerConstantPool(Op, DAG);
   case ISD::Constant:
@@ -1064,18 +2688,53 @@ SDValue NyuziTargetLowering::LowerOperation(SDValue Op,
     return LowerSELECT_CC(Op, DAG);
   case ISD::FDIV:
     return LowerFDIV(Op, DAG);
+  case ISD::FSQRT:
+    return LowerFSQRT(Op, DAG);
+  case ISD::UDIV:
+  case ISD::SDIV:
+  case ISD::UREM:
+  case ISD::SREM:
+    return LowerDIVREM(Op, DAG);
+  case ISD::FSIN:
+  case ISD::FCOS:
+  case ISD::FPOW:
+  case ISD::FEXP:
+  case ISD::FEXP2:
+  case ISD::FLOG:
+  case ISD::FLOG2:
+  case ISD::FLOG10:
+    return LowerVectorMath(Op, DAG);
   case ISD::BR_JT:
     return LowerBR_JT(Op, DAG);
   case ISD::FNEG:
     return LowerFNEG(Op, DAG);
   case ISD::SETCC:
     return LowerSETCC(Op, DAG);
+  case ISD::VSELECT:
+    return LowerVSELECT(Op, DAG);
+  case ISD::MLOAD:
+    return LowerMLOAD(Op, DAG);
+  case ISD::MSTORE:
+    return LowerMSTORE(Op, DAG);
   case ISD::CTLZ_ZERO_UNDEF:
     return LowerCTLZ_ZERO_UNDEF(Op, DAG);
   case ISD::CTTZ_ZERO_UNDEF:
     return LowerCTTZ_ZERO_UNDEF(Op, DAG);
+  case ISD::CTPOP:
+    return LowerCTPOP(Op, DAG);
+  case ISD::BSWAP:
+    return LowerBSWAP(Op, DAG);
   case ISD::UINT_TO_FP:
     return LowerUINT_TO_FP(Op, DAG);
+  case ISD::FP_TO_UINT:
+    return LowerFP_TO_UINT(Op, DAG);
+  case ISD::FFLOOR:
+  case ISD::FCEIL:
+  case ISD::FTRUNC:
+  case ISD::FRINT:
+  case ISD::FNEARBYINT:
+  case ISD::FROUND:
+    return LowerFROUND(Op, DAG);
   case ISD::FRAMEADDR:
     return LowerFRAMEADDR(Op, DAG);
   case ISD::RETURNADDR:  
@@ -1086,11 +2745,65 @@ SDValue NyuziTargetLowering::LowerOperation(SDValue Op,
     return LowerVASTART(Op, DAG);
   case ISD::FABS:
     return LowerFABS(Op, DAG);
+  case ISD::LOAD:
+    return LowerLOAD(Op, DAG);
+  case ISD::STORE:
+    return LowerSTORE(Op, DAG);
+  case ISD::PREFETCH:
+    return LowerPREFETCH(Op, DAG);
+  case ISD::INTRINSIC_WO_CHAIN:
+    return LowerINTRINSIC_WO_CHAIN(Op, DAG);
+  case ISD::SHL_PARTS:
+  case ISD::SRL_PARTS:
+  case ISD::SRA_PARTS:
+    return LowerShiftParts(Op, DAG);
   default:
     llvm_unreachable("Should not custom lower this!");
   }
 }
 
+//
+// If both operands of a vector operation are splats, perform the operation
+// on the scalar values and splat the result. The instruction that uses the
+// splat can usually take the scalar register as an operand directly, which
+// saves an instruction and a vector register.
+//
+SDValue NyuziTargetLowering::PerformDAGCombine(SDNode *N,
+                                               DAGCombinerInfo &DCI) const {
+  if (N->getOpcode() == ISD::FDIV) {
+    // getReciprocalSqrt depends on the single precision format, and only
+    // handles full vectors.
+    EVT Type = N->getValueType(0);
+    if (N->getOperand(1).getOpcode() == ISD::FSQRT &&
+        (Type == MVT::f32 || Type == MVT::v16f32))
+      return getDivideBySqrt(N, DCI.DAG);
+
+    return SDValue();
+  }
+
+  EVT VT = N->getValueType(0);
+  if (!VT.isVector() || N->getNumOperands() != 2)
+    return SDValue();
+
+  SDValue Op0 = N->getOperand(0);
+  SDValue Op1 = N->getOperand(1);
+  if (Op0.getOpcode() != NyuziISD::SPLAT || Op1.getOpcode() != NyuziISD::SPLAT)
+    return SDValue();
+
+  // A splat of an integer constant is an immediate operand of the vector
+  // instruction, which is already a single instruction (and can be masked).
+  if (isa<ConstantSDNode>(Op0.getOperand(0)) ||
+      isa<ConstantSDNode>(Op1.getOperand(0)))
+    return SDValue();
+
+  SelectionDAG &DAG = DCI.DAG;
+  SDLoc DL(N);
+  EVT ElemVT = VT.getVectorElementType();
+  SDValue ScalarOp = DAG.getNode(N->getOpcode(), DL, ElemVT,
+                                 Op0.getOperand(0), Op1.getOperand(0));
+  return DAG.getNode(NyuziISD::SPLAT, DL, VT, ScalarOp);
+}
+
 EVT NyuziTargetLowering::getSetCCResultType(LLVMContext &Context,
                                                  EVT VT) const {
   if (!VT.isVector())
@@ -1138,7 +2851,35 @@ MachineBasicBlock *NyuziTargetLowering::EmitInstrWithCustomInserter(
   case Nyuzi::ATOMIC_LOAD_XORI:
     return EmitAtomicBinary(MI, BB, Nyuzi::XORSSI);
 
-  // XXX ATOMIC_LOAD_NAND is not supported
+  case Nyuzi::ATOMIC_LOAD_NANDR:
+    return EmitAtomicBinary(MI, BB, Nyuzi::ANDSSS, true);
+
+  case Nyuzi::ATOMIC_LOAD_NANDI:
+    return EmitAtomicBinary(MI, BB, Nyuzi::ANDSSI, true);
+
+  case Nyuzi::ATOMIC_LOAD_MINR:
+    return EmitAtomicMinMax(MI, BB, Nyuzi::SLESISS);
+
+  case Nyuzi::ATOMIC_LOAD_MINI:
+    return EmitAtomicMinMax(MI, BB, Nyuzi::SLESISI);
+
+  case Nyuzi::ATOMIC_LOAD_MAXR:
+    return EmitAtomicMinMax(MI, BB, Nyuzi::SGESISS);
+
+  case Nyuzi::ATOMIC_LOAD_MAXI:
+    return EmitAtomicMinMax(MI, BB, Nyuzi::SGESISI);
+
+  case Nyuzi::ATOMIC_LOAD_UMINR:
+    return EmitAtomicMinMax(MI, BB, Nyuzi::SLEUISS);
+
+  case Nyuzi::ATOMIC_LOAD_UMINI:
+    return EmitAtomicMinMax(MI, BB, Nyuzi::SLEUISI);
+
+  case Nyuzi::ATOMIC_LOAD_UMAXR:
+    return EmitAtomicMinMax(MI, BB, Nyuzi::SGEUISS);
+
+  case Nyuzi::ATOMIC_LOAD_UMAXI:
+    return EmitAtomicMinMax(MI, BB, Nyuzi::SGEUISI);
 
   case Nyuzi::ATOMIC_SWAP:
     return EmitAtomicBinary(MI, BB, 0);
@@ -1146,6 +2887,12 @@ MachineBasicBlock *NyuziTargetLowering::EmitInstrWithCustomInserter(
   case Nyuzi::ATOMIC_CMP_SWAP:
     return EmitAtomicCmpSwap(MI, BB);
 
+  case Nyuzi::SCATTER_ATOMIC_ADD:
+    return EmitScatterAtomicAdd(MI, BB, false);
+
+  case Nyuzi::SCATTER_ATOMIC_ADD_MASKED:
+    return EmitScatterAtomicAdd(MI, BB, true);
+
   default:
     llvm_unreachable("unknown atomic operation");
   }
@@ -1220,7 +2967,8 @@ NyuziTargetLowering::EmitSelectCC(MachineInstr *MI,
 
 MachineBasicBlock *
 NyuziTargetLowering::EmitAtomicBinary(MachineInstr *MI, MachineBasicBlock *BB,
-                                        unsigned Opcode) const {
+                                      unsigned Opcode,
+                                      bool InvertResult) const {
   const TargetInstrInfo *TII = getTargetMachine().getSubtargetImpl()->getInstrInfo();
 
   unsigned Dest = MI->getOperand(0).getReg();
@@ -1264,6 +3012,15 @@ NyuziTargetLowering::EmitAtomicBinary(MachineInstr *MI, MachineBasicBlock *BB,
       BuildMI(BB, DL, TII->get(Opcode), NewValue).addReg(OldValue).addImm(MI->getOperand(2).getImm());
     else
       llvm_unreachable("Unknown operand type");
+
+    // NAND is an AND followed by a NOT
+    if (InvertResult) {
+      unsigned Inverted = MRI.createVirtualRegister(&Nyuzi::GPR32RegClass);
+      BuildMI(BB, DL, TII->get(Nyuzi::XORSSI), Inverted)
+          .addReg(NewValue)
+          .addImm(-1);
+      NewValue = Inverted;
+    }
   }
   else
     NewValue = OldValue; // This is just swap: use old value
@@ -1284,6 +3041,258 @@ NyuziTargetLowering::EmitAtomicBinary(MachineInstr *MI, MachineBasicBlock *BB,
   return BB;
 }
 
+//
+// Atomic min/max. CompareOpcode is true when the value in memory should be
+// kept. In that case, memory would not change, so this skips the store.
+//
+MachineBasicBlock *
+NyuziTargetLowering::EmitAtomicMinMax(MachineInstr *MI, MachineBasicBlock *BB,
+                                      unsigned CompareOpcode) const {
+  MachineFunction *MF = BB->getParent();
+  MachineRegisterInfo &RegInfo = MF->getRegInfo();
+  const TargetRegisterClass *RC = getRegClassFor(MVT::i32);
+  const TargetInstrInfo *TII = getTargetMachine().getSubtargetImpl()->getInstrInfo();
+  DebugLoc DL = MI->getDebugLoc();
+
+  unsigned Dest = MI->getOperand(0).getReg();
+  unsigned Ptr = MI->getOperand(1).getReg();
+  MachineOperand &Amt = MI->getOperand(2);
+
+  unsigned OldValue = RegInfo.createVirtualRegister(RC);
+  unsigned KeepOld = RegInfo.createVirtualRegister(RC);
+  unsigned Success = RegInfo.createVirtualRegister(RC);
+
+  const BasicBlock *LLVM_BB = BB->getBasicBlock();
+  MachineBasicBlock *LoopMBB = MF->CreateMachineBasicBlock(LLVM_BB);
+  MachineBasicBlock *StoreMBB = MF->CreateMachineBasicBlock(LLVM_BB);
+  MachineBasicBlock *ExitMBB = MF->CreateMachineBasicBlock(LLVM_BB);
+  MachineFunction::iterator It = BB;
+  ++It;
+  MF->insert(It, LoopMBB);
+  MF->insert(It, StoreMBB);
+  MF->insert(It, ExitMBB);
+
+  // Transfer the remainder of BB and its successor edges to ExitMBB.
+  ExitMBB->splice(ExitMBB->begin(), BB,
+                  std::next(MachineBasicBlock::iterator(MI)), BB->end());
+  ExitMBB->transferSuccessorsAndUpdatePHIs(BB);
+
+  //  ThisMBB:
+  //    move newval, amt        ; if amt is an immediate
+  //    fallthrough --> LoopMBB
+  unsigned NewValue;
+  if (Amt.isReg())
+    NewValue = Amt.getReg();
+  else {
+    NewValue = RegInfo.createVirtualRegister(RC);
+    BuildMI(BB, DL, TII->get(Nyuzi::MOVESimm), NewValue).addImm(Amt.getImm());
+  }
+
+  BB->addSuccessor(LoopMBB);
+  LoopMBB->addSuccessor(ExitMBB);
+  LoopMBB->addSuccessor(StoreMBB);
+  StoreMBB->addSuccessor(LoopMBB);
+  StoreMBB->addSuccessor(ExitMBB);
+
+  // LoopMBB:
+  //   load.sync oldval, 0(Ptr)
+  //   move dest, oldval
+  //   cmpxx keepold, oldval, amt
+  //   btrue keepold, ExitMBB
+  BB = LoopMBB;
+  BuildMI(BB, DL, TII->get(Nyuzi::LOAD_SYNC), OldValue).addReg(Ptr).addImm(0);
+  BuildMI(BB, DL, TII->get(Nyuzi::MOVESS), Dest).addReg(OldValue);
+  if (Amt.isReg())
+    BuildMI(BB, DL, TII->get(CompareOpcode), KeepOld)
+        .addReg(OldValue)
+        .addReg(Amt.getReg());
+  else
+    BuildMI(BB, DL, TII->get(CompareOpcode), KeepOld)
+        .addReg(OldValue)
+        .addImm(Amt.getImm());
+
+  BuildMI(BB, DL, TII->get(Nyuzi::BTRUE)).addReg(KeepOld).addMBB(ExitMBB);
+
+  // StoreMBB:
+  //   store.sync success, 0(Ptr)	; success is a copy of newval
+  //   bfalse success, LoopMBB
+  BB = StoreMBB;
+  BuildMI(BB, DL, TII->get(Nyuzi::STORE_SYNC), Success)
+      .addReg(NewValue)
+      .addReg(Ptr)
+      .addImm(0);
+  BuildMI(BB, DL, TII->get(Nyuzi::BFALSE)).addReg(Success).addMBB(LoopMBB);
+
+  MI->eraseFromParent(); // The instruction is gone now.
+
+  return ExitMBB;
+}
+
+//
+// There is no vector synchronized load/store, so atomically add to each
+// lane's address in turn, from lane 15 down to lane 0, and collect the
+// previous values into the result vector. Lanes that are not set in the mask
+// (if there is one) are skipped and their result is undefined.
+//
+MachineBasicBlock *
+NyuziTargetLowering::EmitScatterAtomicAdd(MachineInstr *MI,
+                                          MachineBasicBlock *BB,
+                                          bool Masked) const {
+  MachineFunction *MF = BB->getParent();
+  MachineRegisterInfo &RegInfo = MF->getRegInfo();
+  const TargetRegisterClass *RC = getRegClassFor(MVT::i32);
+  const TargetRegisterClass *VRC = getRegClassFor(MVT::v16i32);
+  const TargetInstrInfo *TII = getTargetMachine().getSubtargetImpl()->getInstrInfo();
+  DebugLoc DL = MI->getDebugLoc();
+
+  unsigned Dest = MI->getOperand(0).getReg();
+  unsigned Ptrs = MI->getOperand(1).getReg();
+  unsigned Amts = MI->getOperand(2).getReg();
+
+  unsigned InitLane = RegInfo.createVirtualRegister(RC);
+  unsigned InitLaneMask = RegInfo.createVirtualRegister(RC);
+  unsigned InitResult = RegInfo.createVirtualRegister(VRC);
+  unsigned Lane = RegInfo.createVirtualRegister(RC);
+  unsigned LaneMask = RegInfo.createVirtualRegister(RC);
+  unsigned Result = RegInfo.createVirtualRegister(VRC);
+  unsigned Ptr = RegInfo.createVirtualRegister(RC);
+  unsigned Amt = RegInfo.createVirtualRegister(RC);
+  unsigned OldValue = RegInfo.createVirtualRegister(RC);
+  unsigned NewValue = RegInfo.createVirtualRegister(RC);
+  unsigned Success = RegInfo.createVirtualRegister(RC);
+  unsigned NextLane = RegInfo.createVirtualRegister(RC);
+  unsigned NextLaneMask = RegInfo.createVirtualRegister(RC);
+  unsigned NextResult = RegInfo.createVirtualRegister(VRC);
+  unsigned MoreLanes = RegInfo.createVirtualRegister(RC);
+
+  const BasicBlock *LLVM_BB = BB->getBasicBlock();
+  MachineBasicBlock *LaneMBB = MF->CreateMachineBasicBlock(LLVM_BB);
+  MachineBasicBlock *RetryMBB = MF->CreateMachineBasicBlock(LLVM_BB);
+  MachineBasicBlock *NextMBB = MF->CreateMachineBasicBlock(LLVM_BB);
+  MachineBasicBlock *ExitMBB = MF->CreateMachineBasicBlock(LLVM_BB);
+  MachineFunction::iterator It = BB;
+  ++It;
+  MF->insert(It, LaneMBB);
+  MF->insert(It, RetryMBB);
+  MF->insert(It, NextMBB);
+  MF->insert(It, ExitMBB);
+
+  // Transfer the remainder of BB and its successor edges to ExitMBB.
+  ExitMBB->splice(ExitMBB->begin(), BB,
+                  std::next(MachineBasicBlock::iterator(MI)), BB->end());
+  ExitMBB->transferSuccessorsAndUpdatePHIs(BB);
+
+  BB->addSuccessor(LaneMBB);
+  LaneMBB->addSuccessor(RetryMBB);
+  if (Masked)
+    LaneMBB->addSuccessor(NextMBB);
+
+  RetryMBB->addSuccessor(RetryMBB);
+  RetryMBB->addSuccessor(NextMBB);
+  NextMBB->addSuccessor(LaneMBB);
+  NextMBB->addSuccessor(ExitMBB);
+
+  // ThisMBB:
+  //   move initlane, 15
+  //   move initlanemask, 1
+  BuildMI(BB, DL, TII->get(Nyuzi::MOVESimm), InitLane).addImm(15);
+  BuildMI(BB, DL, TII->get(Nyuzi::MOVESimm), InitLaneMask).addImm(1);
+  BuildMI(BB, DL, TII->get(TargetOpcode::IMPLICIT_DEF), InitResult);
+  MachineBasicBlock *ThisMBB = BB;
+
+  // LaneMBB:
+  //   lane = phi [initlane, ThisMBB], [nextlane, NextMBB]
+  //   lanemask = phi [initlanemask, ThisMBB], [nextlanemask, NextMBB]
+  //   result = phi [initresult, ThisMBB], [nextresult, NextMBB]
+  //   getlane ptr, ptrs, lane
+  //   getlane amt, amts, lane
+  //   and updatemask, lanemask, mask   ; if masked
+  //   bfalse updatemask, NextMBB       ; if masked
+  BB = LaneMBB;
+  BuildMI(BB, DL, TII->get(Nyuzi::PHI), Lane)
+      .addReg(InitLane)
+      .addMBB(ThisMBB)
+      .addReg(NextLane)
+      .addMBB(NextMBB);
+  BuildMI(BB, DL, TII->get(Nyuzi::PHI), LaneMask)
+      .addReg(InitLaneMask)
+      .addMBB(ThisMBB)
+      .addReg(NextLaneMask)
+      .addMBB(NextMBB);
+  BuildMI(BB, DL, TII->get(Nyuzi::PHI), Result)
+      .addReg(InitResult)
+      .addMBB(ThisMBB)
+      .addReg(NextResult)
+      .addMBB(NextMBB);
+  BuildMI(BB, DL, TII->get(Nyuzi::GET_LANEI), Ptr).addReg(Ptrs).addReg(Lane);
+  BuildMI(BB, DL, TII->get(Nyuzi::GET_LANEI), Amt).addReg(Amts).addReg(Lane);
+  unsigned UpdateMask = LaneMask;
+  if (Masked) {
+    UpdateMask = RegInfo.createVirtualRegister(RC);
+    BuildMI(BB, DL, TII->get(Nyuzi::ANDSSS), UpdateMask)
+        .addReg(LaneMask)
+        .addReg(MI->getOperand(3).getReg());
+    BuildMI(BB, DL, TII->get(Nyuzi::BFALSE)).addReg(UpdateMask).addMBB(NextMBB);
+  }
+
+  // RetryMBB:
+  //   load.sync oldval, 0(ptr)
+  //   add_i newval, oldval, amt
+  //   store.sync success, 0(ptr)    ; success is a copy of newval
+  //   bfalse success, RetryMBB
+  BB = RetryMBB;
+  BuildMI(BB, DL, TII->get(Nyuzi::LOAD_SYNC), OldValue).addReg(Ptr).addImm(0);
+  BuildMI(BB, DL, TII->get(Nyuzi::ADDISSS), NewValue)
+      .addReg(OldValue)
+      .addReg(Amt);
+  BuildMI(BB, DL, TII->get(Nyuzi::STORE_SYNC), Success)
+      .addReg(NewValue)
+      .addReg(Ptr)
+      .addImm(0);
+  BuildMI(BB, DL, TII->get(Nyuzi::BFALSE)).addReg(Success).addMBB(RetryMBB);
+
+  // NextMBB:
+  //   laneval = phi [amt, LaneMBB], [oldval, RetryMBB]  ; if masked
+  //   move_mask nextresult, updatemask, laneval
+  //   sub_i nextlane, lane, 1
+  //   shl nextlanemask, lanemask, 1
+  //   cmpge_i more, nextlane, 0
+  //   btrue more, LaneMBB
+  BB = NextMBB;
+  unsigned LaneValue = OldValue;
+  if (Masked) {
+    // A skipped lane has a zero update mask, so its value is ignored.
+    LaneValue = RegInfo.createVirtualRegister(RC);
+    BuildMI(BB, DL, TII->get(Nyuzi::PHI), LaneValue)
+        .addReg(Amt)
+        .addMBB(LaneMBB)
+        .addReg(OldValue)
+        .addMBB(RetryMBB);
+  }
+
+  BuildMI(BB, DL, TII->get(Nyuzi::MOVEVSMI), NextResult)
+      .addReg(UpdateMask)
+      .addReg(LaneValue)
+      .addReg(Result);
+  BuildMI(BB, DL, TII->get(Nyuzi::SUBISSI), NextLane).addReg(Lane).addImm(1);
+  BuildMI(BB, DL, TII->get(Nyuzi::SLLSSI), NextLaneMask)
+      .addReg(LaneMask)
+      .addImm(1);
+  BuildMI(BB, DL, TII->get(Nyuzi::SGESISI), MoreLanes)
+      .addReg(NextLane)
+      .addImm(0);
+  BuildMI(BB, DL, TII->get(Nyuzi::BTRUE)).addReg(MoreLanes).addMBB(LaneMBB);
+
+  // ExitMBB:
+  //   move dest, nextresult
+  BuildMI(*ExitMBB, ExitMBB->begin(), DL, TII->get(TargetOpcode::COPY), Dest)
+      .addReg(NextResult);
+
+  MI->eraseFromParent(); // The instruction is gone now.
+
+  return ExitMBB;
+}
+
 MachineBasicBlock *
 NyuziTargetLowering::EmitAtomicCmpSwap(MachineInstr *MI,
                                             MachineBasicBlock *BB) const {
@@ -1400,3 +3409,35 @@ bool NyuziTargetLowering::isOffsetFoldingLegal(
   // The Nyuzi target isn't yet aware of offsets.
   return false;
 }
+
+//
+// Loads and stores take a base register plus a signed 13 bit offset (see
+// NyuziDAGToDAGISel::SelectADDRri). This is the same for scalar and block
+// accesses. There is no register + register or scaled index form, and
+// globals are loaded from the constant pool, so they can't be folded either.
+//
+bool NyuziTargetLowering::isLegalAddressingMode(const AddrMode &AM,
+                                                Type *Ty) const {
+  if (AM.BaseGV || !isInt<13>(AM.BaseOffs))
+    return false;
+
+  switch (AM.Scale) {
+  case 0: // base + offset
+    return true;
+
+  case 1: // index + offset, which is the same thing
+    return !AM.HasBaseReg;
+
+  default:
+    return false;
+  }
+}
+
+// Comparisons and adds have a 13 bit signed immediate form.
+bool NyuziTargetLowering::isLegalICmpImmediate(int64_t Imm) const {
+  return isInt<13>(Imm);
+}
+
+bool NyuziTargetLowering::isLegalAddImmediate(int64_t Imm) const {
+  return isInt<13>(Imm);
+}
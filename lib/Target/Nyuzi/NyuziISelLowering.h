@@ -26,6 +26,7 @@ namespace NyuziISD {
 enum {
   FIRST_NUMBER = ISD::BUILTIN_OP_END,
   CALL,     // A call instruction.
+  TAIL_CALL, // A call that replaces the current function's frame.
   RET_FLAG, // Return with a flag operand.
   SPLAT,    // Copy scalar register into all lanes of a vector
   SEL_COND_RESULT,
@@ -42,6 +43,10 @@ public:
 
   explicit NyuziTargetLowering(const TargetMachine &TM, const NyuziSubtarget &STI);
   virtual SDValue LowerOperation(SDValue Op, SelectionDAG &DAG) const override;
+  virtual void ReplaceNodeResults(SDNode *N, SmallVectorImpl<SDValue> &Results,
+                                  SelectionDAG &DAG) const override;
+  virtual SDValue PerformDAGCombine(SDNode *N,
+                                    DAGCombinerInfo &DCI) const override;
   virtual MachineBasicBlock *EmitInstrWithCustomInserter(MachineInstr *MI, 
   	                                                     MachineBasicBlock *MBB) const override;
   virtual const char *getTargetNodeName(unsigned Opcode) const override;
@@ -49,6 +54,10 @@ public:
   virtual std::pair<unsigned, const TargetRegisterClass *>
 	  getRegForInlineAsmConstraint(const std::string &Constraint, MVT VT) const override;
   virtual bool isOffsetFoldingLegal(const GlobalAddressSDNode *GA) const override;
+  virtual bool isLegalAddressingMode(const AddrMode &AM,
+                                     Type *Ty) const override;
+  virtual bool isLegalICmpImmediate(int64_t Imm) const override;
+  virtual bool isLegalAddImmediate(int64_t Imm) const override;
   virtual EVT getSetCCResultType(LLVMContext &Context, EVT VT) const override;
   virtual SDValue LowerReturn(SDValue Chain, CallingConv::ID CallConv,
                               bool isVarArg,
@@ -66,10 +75,19 @@ public:
   virtual bool isShuffleMaskLegal(const SmallVectorImpl<int> &M, EVT VT) const override;
 
 private:
+  bool isEligibleForTailCallOptimization(CCState &CCInfo,
+                                         TargetLowering::CallLoweringInfo &CLI,
+                                         MachineFunction &MF) const;
   MachineBasicBlock *EmitSelectCC(MachineInstr *MI,
                                   MachineBasicBlock *BB) const;
   MachineBasicBlock *EmitAtomicBinary(MachineInstr *MI, MachineBasicBlock *BB,
-                                   unsigned Opcode) const;
+                                      unsigned Opcode,
+                                      bool InvertResult = false) const;
+  MachineBasicBlock *EmitAtomicMinMax(MachineInstr *MI, MachineBasicBlock *BB,
+                                      unsigned CompareOpcode) const;
+  MachineBasicBlock *EmitScatterAtomicAdd(MachineInstr *MI,
+                                          MachineBasicBlock *BB,
+                                          bool Masked) const;
   MachineBasicBlock *EmitAtomicCmpSwap(MachineInstr *MI,
                                        MachineBasicBlock *BB) const;
 
@@ -82,21 +100,36 @@ private:
   SDValue LowerConstantPool(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerConstant(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerFDIV(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerFSQRT(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerDIVREM(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerVectorMath(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerBR_JT(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerBRIND(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerSCALAR_TO_VECTOR(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerFNEG(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerEXTRACT_VECTOR_ELT(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerSETCC(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerVSELECT(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerMLOAD(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerMSTORE(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerCTLZ_ZERO_UNDEF(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerCTTZ_ZERO_UNDEF(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerCTPOP(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerBSWAP(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerUINT_TO_FP(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerFP_TO_UINT(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerFROUND(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerFRAMEADDR(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerRETURNADDR(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerSIGN_EXTEND_INREG(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerBlockAddress(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerVASTART(SDValue Op, SelectionDAG &DAG) const;
   SDValue LowerFABS(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerLOAD(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerSTORE(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerPREFETCH(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerINTRINSIC_WO_CHAIN(SDValue Op, SelectionDAG &DAG) const;
+  SDValue LowerShiftParts(SDValue Op, SelectionDAG &DAG) const;
 
 private:
   const NyuziSubtarget &Subtarget;
@@ -19,6 +19,7 @@
 #include "NyuziSubtarget.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
@@ -33,6 +34,20 @@
 
 using namespace llvm;
 
+#define DEBUG_TYPE "nyuzi-instr-info"
+
+// Vector registers are 64 bytes, so each of their spills and reloads moves
+// sixteen times as much data as a scalar one. These count them separately
+// to show the effect of rematerialization.
+STATISTIC(NumScalarSpills, "Number of scalar registers spilled");
+STATISTIC(NumScalarReloads, "Number of scalar registers reloaded");
+STATISTIC(NumVectorSpills, "Number of vector registers spilled");
+STATISTIC(NumVectorReloads, "Number of vector registers reloaded");
+STATISTIC(NumSpillBytes, "Number of bytes stored by spills");
+STATISTIC(NumReloadBytes, "Number of bytes loaded by reloads");
+STATISTIC(NumScalarRemats, "Number of scalar values rematerialized");
+STATISTIC(NumVectorRemats, "Number of vector values rematerialized");
+
 const NyuziInstrInfo *NyuziInstrInfo::create(NyuziSubtarget &ST) {
 	return new NyuziInstrInfo(ST);
 }
@@ -81,6 +96,15 @@ unsigned NyuziInstrInfo::isStoreToStackSlot(const MachineInstr *MI,
   return 0;
 }
 
+static bool isCondBranchOpcode(unsigned Opcode) {
+  return Opcode == Nyuzi::BTRUE || Opcode == Nyuzi::BFALSE ||
+         Opcode == Nyuzi::BALL || Opcode == Nyuzi::BNALL;
+}
+
+//
+// Conditional branches are described by a two entry Cond: the opcode as an
+// immediate, followed by the register that it tests.
+//
 bool NyuziInstrInfo::AnalyzeBranch(MachineBasicBlock &MBB,
                                         MachineBasicBlock *&TBB,
                                         MachineBasicBlock *&FBB,
@@ -111,9 +135,12 @@ bool NyuziInstrInfo::AnalyzeBranch(MachineBasicBlock &MBB,
         continue;
       }
 
+      // Anything after the goto, including a conditional branch that was
+      // already analyzed, is unreachable.
       while (std::next(I) != MBB.end())
         std::next(I)->eraseFromParent();
 
+      Cond.clear();
       FBB = nullptr;
       if (MBB.isLayoutSuccessor(I->getOperand(0).getMBB())) {
         TBB = nullptr;
@@ -127,7 +154,15 @@ bool NyuziInstrInfo::AnalyzeBranch(MachineBasicBlock &MBB,
       continue;
     }
 
-    return true;
+    // Handle a conditional branch, possibly followed by an unconditional one.
+    // Give up if there is more than one.
+    if (!isCondBranchOpcode(I->getOpcode()) || !Cond.empty())
+      return true;
+
+    FBB = TBB;
+    TBB = I->getOperand(1).getMBB();
+    Cond.push_back(MachineOperand::CreateImm(I->getOpcode()));
+    Cond.push_back(I->getOperand(0));
   }
 
   return false;
@@ -138,22 +173,22 @@ unsigned NyuziInstrInfo::InsertBranch(
     MachineBasicBlock *FBB,                         // If false
     const SmallVectorImpl<MachineOperand> &Cond, DebugLoc DL) const {
   assert(TBB);
-  if (FBB) {
-    // Has a false block, this is a two way conditional branch
-    BuildMI(&MBB, DL, get(Nyuzi::BTRUE)).addMBB(TBB);
-    BuildMI(&MBB, DL, get(Nyuzi::GOTO)).addMBB(FBB);
-    return 2;
-  }
-
   if (Cond.empty()) {
     // Unconditional branch
+    assert(!FBB && "Unconditional branch with multiple successors!");
     BuildMI(&MBB, DL, get(Nyuzi::GOTO)).addMBB(TBB);
     return 1;
   }
 
-  // One-way conditional branch
-  BuildMI(&MBB, DL, get(Nyuzi::BTRUE)).addMBB(TBB);
-  return 1;
+  BuildMI(&MBB, DL, get(Cond[0].getImm()))
+      .addReg(Cond[1].getReg())
+      .addMBB(TBB);
+  if (!FBB)
+    return 1;
+
+  // Has a false block, this is a two way conditional branch
+  BuildMI(&MBB, DL, get(Nyuzi::GOTO)).addMBB(FBB);
+  return 2;
 }
 
 unsigned NyuziInstrInfo::RemoveBranch(MachineBasicBlock &MBB) const {
@@ -165,9 +200,7 @@ unsigned NyuziInstrInfo::RemoveBranch(MachineBasicBlock &MBB) const {
     if (I->isDebugValue())
       continue;
 
-    if (I->getOpcode() != Nyuzi::GOTO &&
-        I->getOpcode() != Nyuzi::BTRUE &&
-        I->getOpcode() != Nyuzi::BFALSE)
+    if (I->getOpcode() != Nyuzi::GOTO && !isCondBranchOpcode(I->getOpcode()))
       break; // Not a branch
 
     I->eraseFromParent();
@@ -177,6 +210,189 @@ unsigned NyuziInstrInfo::RemoveBranch(MachineBasicBlock &MBB) const {
   return Count;
 }
 
+bool NyuziInstrInfo::ReverseBranchCondition(
+    SmallVectorImpl<MachineOperand> &Cond) const {
+  assert(Cond.size() == 2 && "Invalid branch condition!");
+  switch (Cond[0].getImm()) {
+  case Nyuzi::BTRUE:
+    Cond[0].setImm(Nyuzi::BFALSE);
+    break;
+  case Nyuzi::BFALSE:
+    Cond[0].setImm(Nyuzi::BTRUE);
+    break;
+  case Nyuzi::BALL:
+    Cond[0].setImm(Nyuzi::BNALL);
+    break;
+  case Nyuzi::BNALL:
+    Cond[0].setImm(Nyuzi::BALL);
+    break;
+  default:
+    llvm_unreachable("Unknown branch opcode");
+  }
+
+  return false;
+}
+
+static bool isCompareResult(const MachineRegisterInfo &MRI, unsigned Reg) {
+  if (!TargetRegisterInfo::isVirtualRegister(Reg))
+    return false;
+
+  const MachineInstr *DefMI = MRI.getVRegDef(Reg);
+  return DefMI && DefMI->isCompare();
+}
+
+// Check if Reg is a move of the immediate Imm
+static bool isMoveImm(const MachineRegisterInfo &MRI, unsigned Reg,
+                      int64_t Imm) {
+  if (!TargetRegisterInfo::isVirtualRegister(Reg))
+    return false;
+
+  const MachineInstr *DefMI = MRI.getVRegDef(Reg);
+  return DefMI && DefMI->getOpcode() == Nyuzi::MOVESimm &&
+         DefMI->getOperand(1).isImm() && DefMI->getOperand(1).getImm() == Imm;
+}
+
+//
+// There is no scalar conditional move, so early if-conversion selects with
+// mask arithmetic. The branch condition is turned into a mask that is all
+// ones when BTRUE would be taken: a scalar compare result has bit 0 set when
+// true, so shifting that bit up to the sign bit and arithmetic shifting it back
+// down copies it to every bit. Other registers are compared against zero
+// first, which is what BTRUE tests. The result is then
+// FalseReg ^ ((TrueReg ^ FalseReg) & Mask). A vector select is a single
+// masked move, with the same mask enabling all lanes or none.
+//
+// Scalar selects of the constants 0 and -1 (for example, a sign extended
+// compare) fold into the mask: with a zero false value the result is
+// TrueReg & Mask, and with a -1 true value it is FalseReg | Mask. The compare
+// result is 0 or 1, so subtracting one from it gives the inverted mask in a
+// single instruction, which handles a zero true value or a -1 false value.
+//
+bool NyuziInstrInfo::canInsertSelect(
+    const MachineBasicBlock &MBB, const SmallVectorImpl<MachineOperand> &Cond,
+    unsigned TrueReg, unsigned FalseReg, int &CondCycles, int &TrueCycles,
+    int &FalseCycles) const {
+  // BALL and BNALL test a lane mask rather than a boolean.
+  if (Cond.size() != 2 ||
+      (Cond[0].getImm() != Nyuzi::BTRUE && Cond[0].getImm() != Nyuzi::BFALSE))
+    return false;
+
+  const MachineRegisterInfo &MRI = MBB.getParent()->getRegInfo();
+  const TargetRegisterClass *RC =
+      RI.getCommonSubClass(MRI.getRegClass(TrueReg), MRI.getRegClass(FalseReg));
+  if (!RC)
+    return false;
+
+  int MaskCycles = isCompareResult(MRI, Cond[1].getReg()) ? 2 : 3;
+  if (Nyuzi::GPR32RegClass.hasSubClassEq(RC)) {
+    CondCycles = MaskCycles + 2;
+    TrueCycles = 3;
+    FalseCycles = 3;
+    return true;
+  }
+
+  if (Nyuzi::VR512RegClass.hasSubClassEq(RC)) {
+    CondCycles = MaskCycles + 1;
+    TrueCycles = 1;
+    FalseCycles = 1;
+    return true;
+  }
+
+  return false;
+}
+
+void NyuziInstrInfo::insertSelect(MachineBasicBlock &MBB,
+                                  MachineBasicBlock::iterator I, DebugLoc DL,
+                                  unsigned DstReg,
+                                  const SmallVectorImpl<MachineOperand> &Cond,
+                                  unsigned TrueReg, unsigned FalseReg) const {
+  MachineRegisterInfo &MRI = MBB.getParent()->getRegInfo();
+  if (Cond[0].getImm() == Nyuzi::BFALSE)
+    std::swap(TrueReg, FalseReg);
+
+  unsigned CondReg = Cond[1].getReg();
+  if (!isCompareResult(MRI, CondReg)) {
+    unsigned IsTrue = MRI.createVirtualRegister(&Nyuzi::GPR32RegClass);
+    BuildMI(MBB, I, DL, get(Nyuzi::SNESISI), IsTrue)
+        .addReg(CondReg)
+        .addImm(0);
+    CondReg = IsTrue;
+  }
+
+  bool IsVector = Nyuzi::VR512RegClass.hasSubClassEq(MRI.getRegClass(DstReg));
+  bool TrueIsZero = !IsVector && isMoveImm(MRI, TrueReg, 0);
+  bool TrueIsOnes = !IsVector && isMoveImm(MRI, TrueReg, -1);
+  bool FalseIsZero = !IsVector && isMoveImm(MRI, FalseReg, 0);
+  bool FalseIsOnes = !IsVector && isMoveImm(MRI, FalseReg, -1);
+  if (TrueIsZero && FalseIsOnes) {
+    BuildMI(MBB, I, DL, get(Nyuzi::ADDISSI), DstReg)
+        .addReg(CondReg)
+        .addImm(-1);
+    return;
+  }
+
+  if (TrueIsZero || FalseIsOnes) {
+    unsigned InvMask = MRI.createVirtualRegister(&Nyuzi::GPR32RegClass);
+    BuildMI(MBB, I, DL, get(Nyuzi::ADDISSI), InvMask)
+        .addReg(CondReg)
+        .addImm(-1);
+    if (TrueIsZero) {
+      BuildMI(MBB, I, DL, get(Nyuzi::ANDSSS), DstReg)
+          .addReg(FalseReg)
+          .addReg(InvMask);
+    } else {
+      BuildMI(MBB, I, DL, get(Nyuzi::ORSSS), DstReg)
+          .addReg(TrueReg)
+          .addReg(InvMask);
+    }
+
+    return;
+  }
+
+  unsigned Shifted = MRI.createVirtualRegister(&Nyuzi::GPR32RegClass);
+  BuildMI(MBB, I, DL, get(Nyuzi::SLLSSI), Shifted).addReg(CondReg).addImm(31);
+  if (TrueIsOnes && FalseIsZero) {
+    BuildMI(MBB, I, DL, get(Nyuzi::SRASSI), DstReg).addReg(Shifted).addImm(31);
+    return;
+  }
+
+  unsigned Mask = MRI.createVirtualRegister(&Nyuzi::GPR32RegClass);
+  BuildMI(MBB, I, DL, get(Nyuzi::SRASSI), Mask).addReg(Shifted).addImm(31);
+  if (IsVector) {
+    BuildMI(MBB, I, DL, get(Nyuzi::MOVEVVMI), DstReg)
+        .addReg(Mask)
+        .addReg(TrueReg)
+        .addReg(FalseReg);
+    return;
+  }
+
+  if (FalseIsZero) {
+    BuildMI(MBB, I, DL, get(Nyuzi::ANDSSS), DstReg)
+        .addReg(TrueReg)
+        .addReg(Mask);
+    return;
+  }
+
+  if (TrueIsOnes) {
+    BuildMI(MBB, I, DL, get(Nyuzi::ORSSS), DstReg)
+        .addReg(FalseReg)
+        .addReg(Mask);
+    return;
+  }
+
+  unsigned Diff = MRI.createVirtualRegister(&Nyuzi::GPR32RegClass);
+  unsigned MaskedDiff = MRI.createVirtualRegister(&Nyuzi::GPR32RegClass);
+  BuildMI(MBB, I, DL, get(Nyuzi::XORSSS), Diff)
+      .addReg(TrueReg)
+      .addReg(FalseReg);
+  BuildMI(MBB, I, DL, get(Nyuzi::ANDSSS), MaskedDiff)
+      .addReg(Diff)
+      .addReg(Mask);
+  BuildMI(MBB, I, DL, get(Nyuzi::XORSSS), DstReg)
+      .addReg(MaskedDiff)
+      .addReg(FalseReg);
+}
+
 void NyuziInstrInfo::copyPhysReg(MachineBasicBlock &MBB,
                                       MachineBasicBlock::iterator I,
                                       DebugLoc DL, unsigned DestReg,
@@ -221,11 +437,15 @@ void NyuziInstrInfo::storeRegToStackSlot(MachineBasicBlock &MBB,
   MachineMemOperand *MMO = getMemOperand(MBB, FrameIndex, MachineMemOperand::MOStore);
   unsigned Opc = 0;
 
-  if (Nyuzi::GPR32RegClass.hasSubClassEq(RC))
+  if (Nyuzi::GPR32RegClass.hasSubClassEq(RC)) {
     Opc = Nyuzi::SW;
-  else if (Nyuzi::VR512RegClass.hasSubClassEq(RC))
+    ++NumScalarSpills;
+    NumSpillBytes += 4;
+  } else if (Nyuzi::VR512RegClass.hasSubClassEq(RC)) {
     Opc = Nyuzi::BLOCK_STOREI;
-  else
+    ++NumVectorSpills;
+    NumSpillBytes += 64;
+  } else
     llvm_unreachable("unknown register class in storeRegToStack");
 
   BuildMI(MBB, MBBI, DL, get(Opc))
@@ -247,11 +467,15 @@ void NyuziInstrInfo::loadRegFromStackSlot(MachineBasicBlock &MBB,
   MachineMemOperand *MMO = getMemOperand(MBB, FrameIndex, MachineMemOperand::MOLoad);
   unsigned Opc = 0;
 
-  if (Nyuzi::GPR32RegClass.hasSubClassEq(RC))
+  if (Nyuzi::GPR32RegClass.hasSubClassEq(RC)) {
     Opc = Nyuzi::LW;
-  else if (Nyuzi::VR512RegClass.hasSubClassEq(RC))
+    ++NumScalarReloads;
+    NumReloadBytes += 4;
+  } else if (Nyuzi::VR512RegClass.hasSubClassEq(RC)) {
     Opc = Nyuzi::BLOCK_LOADI;
-  else
+    ++NumVectorReloads;
+    NumReloadBytes += 64;
+  } else
     llvm_unreachable("unknown register class in storeRegToStack");
 
   BuildMI(MBB, MBBI, DL, get(Opc), DestReg)
@@ -261,6 +485,20 @@ void NyuziInstrInfo::loadRegFromStackSlot(MachineBasicBlock &MBB,
 }
 
 
+void NyuziInstrInfo::reMaterialize(MachineBasicBlock &MBB,
+                                   MachineBasicBlock::iterator MI,
+                                   unsigned DestReg, unsigned SubIdx,
+                                   const MachineInstr *Orig,
+                                   const TargetRegisterInfo &TRI) const {
+  if (Orig->getOpcode() == Nyuzi::MOVEVimm ||
+      Orig->getOpcode() == Nyuzi::BLOCK_LOADI)
+    ++NumVectorRemats;
+  else
+    ++NumScalarRemats;
+
+  TargetInstrInfo::reMaterialize(MBB, MI, DestReg, SubIdx, Orig, TRI);
+}
+
 void NyuziInstrInfo::adjustStackPointer(MachineBasicBlock &MBB, 
                                       MachineBasicBlock::iterator MBBI,
                                       int Amount) const {
@@ -294,9 +532,8 @@ unsigned int NyuziInstrInfo::loadConstant(MachineBasicBlock &MBB,
   
   if (isInt<13>(Value)) {
     // Can load directly into this register
-    BuildMI(MBB, MBBI, DL, get(Nyuzi::MOVESimm))
-        .addReg(Reg)
-        .addImm(Value >> 12);
+    BuildMI(MBB, MBBI, DL, get(Nyuzi::MOVESimm), Reg)
+        .addImm(Value);
   } else {
     // Load bits 23-12 into register
     BuildMI(MBB, MBBI, DL, get(Nyuzi::MOVESimm), Reg)
@@ -0,0 +1,243 @@
+//===-- NyuziLoopPrefetch.cpp - Prefetch array walks in loops -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Streaming loops spend most of their time waiting for cache misses. This pass
+// finds loads in innermost loops whose address advances by a constant stride
+// each iteration (scalar array walks and vector block loads), and inserts a
+// prefetch of the address that will be loaded a fixed number of bytes ahead.
+//
+// Only loads are prefetched. The data cache is write-through and doesn't
+// allocate lines on a store miss, so prefetching store targets wouldn't help.
+// Loads that fall in a cache line that another prefetch in the loop already
+// covers (for example, adjacent fields of a structure) share it.
+//
+// The prefetched address is clamped to the last address the load reads, so
+// the final iterations don't touch memory past the end (or, for negative
+// strides, before the start) of the array. Loads whose last address can't be
+// computed, or which don't execute on every iteration, aren't prefetched.
+//
+// This pass is off by default (-nyuzi-loop-prefetch). There is no prefetch
+// instruction, so prefetches are dropped unless they are also lowered to
+// loads (-nyuzi-prefetch-loads, see LowerPREFETCH).
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "nyuzi-loop-prefetch"
+#include "Nyuzi.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpander.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+using namespace llvm;
+
+STATISTIC(NumPrefetches, "Number of loop prefetches inserted");
+
+static cl::opt<unsigned> PrefetchDistance(
+    "nyuzi-prefetch-distance", cl::Hidden, cl::init(512),
+    cl::desc("Number of bytes ahead of a strided load to prefetch (0 to "
+             "disable loop prefetching)"));
+
+namespace {
+const int64_t kCacheLineSize = 64;
+
+class NyuziLoopPrefetch : public FunctionPass {
+public:
+  static char ID;
+
+  NyuziLoopPrefetch() : FunctionPass(ID), SE(nullptr), DT(nullptr) {}
+
+  virtual bool runOnFunction(Function &F) override;
+
+  virtual const char *getPassName() const override {
+    return "Nyuzi loop prefetch";
+  }
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.addPreserved<LoopInfoWrapperPass>();
+    AU.addRequired<ScalarEvolution>();
+    AU.addRequired<DominatorTreeWrapperPass>();
+  }
+
+private:
+  bool runOnLoop(Loop *L);
+  void insertPrefetch(Instruction *Load, Value *Ptr, int64_t Offset,
+                      Value *Last);
+
+  ScalarEvolution *SE;
+  DominatorTree *DT;
+};
+
+char NyuziLoopPrefetch::ID = 0;
+} // namespace
+
+FunctionPass *llvm::createNyuziLoopPrefetchPass() {
+  return new NyuziLoopPrefetch();
+}
+
+// Returns the address operand of a load that can be prefetched, or null.
+static Value *getLoadAddress(Instruction *I) {
+  if (LoadInst *Load = dyn_cast<LoadInst>(I))
+    return Load->isSimple() ? Load->getPointerOperand() : nullptr;
+
+  if (IntrinsicInst *II = dyn_cast<IntrinsicInst>(I)) {
+    if (II->getIntrinsicID() == Intrinsic::nyuzi_block_loadi_masked ||
+        II->getIntrinsicID() == Intrinsic::nyuzi_block_loadf_masked)
+      return II->getArgOperand(0);
+  }
+
+  return nullptr;
+}
+
+// Last is the address the load reads on the final iteration, which the
+// prefetched address must not go beyond.
+void NyuziLoopPrefetch::insertPrefetch(Instruction *Load, Value *Ptr,
+                                       int64_t Offset, Value *Last) {
+  IRBuilder<> Builder(Load);
+  PointerType *PtrTy = cast<PointerType>(Ptr->getType());
+  Type *BytePtrTy = Builder.getInt8PtrTy(PtrTy->getAddressSpace());
+  Value *BytePtr = Builder.CreateBitCast(Ptr, BytePtrTy);
+  Value *LastBytePtr = Builder.CreateBitCast(Last, BytePtrTy);
+
+  // The unclamped address may be past the end of the array, so this can't
+  // be an inbounds GEP.
+  Value *Addr = Builder.CreateGEP(BytePtr, Builder.getInt32(Offset));
+  Value *IsPastLast = Offset > 0 ? Builder.CreateICmpUGT(Addr, LastBytePtr)
+                                 : Builder.CreateICmpULT(Addr, LastBytePtr);
+  Addr = Builder.CreateSelect(IsPastLast, LastBytePtr, Addr);
+  Module *M = Load->getParent()->getParent()->getParent();
+  Builder.CreateCall4(Intrinsic::getDeclaration(M, Intrinsic::prefetch), Addr,
+                      Builder.getInt32(0), Builder.getInt32(3),
+                      Builder.getInt32(1));
+  ++NumPrefetches;
+}
+
+bool NyuziLoopPrefetch::runOnLoop(Loop *L) {
+  // Pointers already prefetched in this loop, and their strides.
+  SmallVector<std::pair<const SCEV *, int64_t>, 8> Prefetched;
+  SmallVector<std::pair<Instruction *, int64_t>, 8> ToPrefetch;
+  SmallVector<const SCEV *, 8> LastAddrs;
+  unsigned TripCount = SE->getSmallConstantTripCount(L);
+
+  // The last address of each load is computed from the number of
+  // iterations. That is only the last address the load reads if the load
+  // runs on every iteration, including the one that leaves the loop.
+  BasicBlock *Preheader = L->getLoopPreheader();
+  BasicBlock *Latch = L->getLoopLatch();
+  const SCEV *BackedgeTakenCount = SE->getBackedgeTakenCount(L);
+  if (!Preheader || !Latch || L->getExitingBlock() != Latch ||
+      isa<SCEVCouldNotCompute>(BackedgeTakenCount))
+    return false;
+
+  for (BasicBlock *BB : L->getBlocks()) {
+    if (!DT->dominates(BB, Latch))
+      continue;
+
+    for (Instruction &I : *BB) {
+      Value *Ptr = getLoadAddress(&I);
+      if (!Ptr)
+        continue;
+
+      const SCEVAddRecExpr *AddRec =
+          dyn_cast<SCEVAddRecExpr>(SE->getSCEV(Ptr));
+      if (!AddRec || AddRec->getLoop() != L || !AddRec->isAffine())
+        continue;
+
+      const SCEVConstant *StepConst =
+          dyn_cast<SCEVConstant>(AddRec->getStepRecurrence(*SE));
+      if (!StepConst)
+        continue;
+
+      int64_t Stride = StepConst->getValue()->getSExtValue();
+      if (Stride == 0)
+        continue;
+
+      // Prefetch a whole number of iterations ahead, so the prefetched
+      // address is one this load will actually use.
+      int64_t AbsStride = Stride < 0 ? -Stride : Stride;
+      int64_t ItersAhead = (PrefetchDistance + AbsStride - 1) / AbsStride;
+
+      // If the loop ends before the prefetched data is used, don't bother.
+      if (TripCount != 0 && int64_t(TripCount) <= ItersAhead)
+        continue;
+
+      bool SameLine = false;
+      for (const auto &Prev : Prefetched) {
+        if (Prev.second != Stride)
+          continue;
+
+        const SCEVConstant *Diff =
+            dyn_cast<SCEVConstant>(SE->getMinusSCEV(AddRec, Prev.first));
+        if (Diff && Diff->getValue()->getValue().abs().slt(kCacheLineSize)) {
+          SameLine = true;
+          break;
+        }
+      }
+
+      if (SameLine)
+        continue;
+
+      const SCEV *LastAddr =
+          AddRec->evaluateAtIteration(BackedgeTakenCount, *SE);
+      if (!isSafeToExpand(LastAddr, *SE))
+        continue;
+
+      Prefetched.push_back(std::make_pair(AddRec, Stride));
+      ToPrefetch.push_back(std::make_pair(&I, ItersAhead * Stride));
+      LastAddrs.push_back(LastAddr);
+    }
+  }
+
+  SCEVExpander Expander(*SE, "prefetch");
+  for (unsigned i = 0, e = ToPrefetch.size(); i != e; ++i) {
+    Instruction *Load = ToPrefetch[i].first;
+    Value *Ptr = getLoadAddress(Load);
+    DEBUG(dbgs() << "Prefetching " << ToPrefetch[i].second
+                 << " bytes ahead of " << *Load << "\n");
+    Value *Last = Expander.expandCodeFor(LastAddrs[i], Ptr->getType(),
+                                         Preheader->getTerminator());
+    insertPrefetch(Load, Ptr, ToPrefetch[i].second, Last);
+  }
+
+  return !ToPrefetch.empty();
+}
+
+bool NyuziLoopPrefetch::runOnFunction(Function &F) {
+  if (PrefetchDistance == 0)
+    return false;
+
+  LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  SE = &getAnalysis<ScalarEvolution>();
+  DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+
+  // The accesses in an outer loop are usually made by the loops it contains,
+  // so only innermost loops are prefetched.
+  SmallVector<Loop *, 8> Worklist(LI.begin(), LI.end());
+  bool Changed = false;
+  while (!Worklist.empty()) {
+    Loop *L = Worklist.pop_back_val();
+    if (L->empty())
+      Changed |= runOnLoop(L);
+    else
+      Worklist.append(L->begin(), L->end());
+  }
+
+  return Changed;
+}
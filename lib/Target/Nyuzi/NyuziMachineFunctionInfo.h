@@ -14,21 +14,31 @@
 #ifndef NYUZIMACHINEFUNCTIONINFO_H
 #define NYUZIMACHINEFUNCTIONINFO_H
 
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/CodeGen/MachineFunction.h"
 
 namespace llvm {
 
 class NyuziMachineFunctionInfo : public MachineFunctionInfo {
 public:
-  NyuziMachineFunctionInfo() : SRetReturnReg(0) {}
+  NyuziMachineFunctionInfo()
+      : SRetReturnReg(0), SaveBlock(nullptr), VectorSaveBlock(nullptr) {}
 
   explicit NyuziMachineFunctionInfo(MachineFunction &MF)
-      : SRetReturnReg(0) {}
+      : SRetReturnReg(0), SaveBlock(nullptr), VectorSaveBlock(nullptr) {}
 
   unsigned getSRetReturnReg() const { return SRetReturnReg; }
   void setSRetReturnReg(unsigned Reg) { SRetReturnReg = Reg; }
   int getVarArgsFrameIndex() const { return VarArgsFrameIndex; }
   void setVarArgsFrameIndex(int Index) { VarArgsFrameIndex = Index; }
+  MachineBasicBlock *getSaveBlock() const { return SaveBlock; }
+  void setSaveBlock(MachineBasicBlock *MBB) { SaveBlock = MBB; }
+  MachineBasicBlock *getVectorSaveBlock() const { return VectorSaveBlock; }
+  void setVectorSaveBlock(MachineBasicBlock *MBB) { VectorSaveBlock = MBB; }
+  SmallPtrSetImpl<MachineBasicBlock *> &getFrameBlocks() { return FrameBlocks; }
+  SmallPtrSetImpl<MachineBasicBlock *> &getVectorBlocks() {
+    return VectorBlocks;
+  }
 
 private:
   virtual void anchor();
@@ -37,6 +47,23 @@ private:
   /// argument is passed.
   unsigned SRetReturnReg;
   int VarArgsFrameIndex;
+
+  /// SaveBlock - Block where the stack frame is set up and scalar callee
+  /// saved registers are spilled (see NyuziFrameLowering).
+  MachineBasicBlock *SaveBlock;
+
+  /// VectorSaveBlock - Block where callee saved vector registers are
+  /// spilled. It is SaveBlock or is dominated by it.
+  MachineBasicBlock *VectorSaveBlock;
+
+  /// FrameBlocks - Blocks that run with the stack frame set up: SaveBlock
+  /// and everything reachable from it before control flow rejoins a path that
+  /// doesn't go through it.
+  SmallPtrSet<MachineBasicBlock *, 16> FrameBlocks;
+
+  /// VectorBlocks - Blocks where callee saved vector registers are saved,
+  /// computed the same way from VectorSaveBlock.
+  SmallPtrSet<MachineBasicBlock *, 16> VectorBlocks;
 };
 }
 
@@ -0,0 +1,293 @@
+//===-- NyuziMathLowering.cpp - Inline vector math functions --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Lowering for v16f32 transcendental functions. Without this, each of these
+// is split into 16 scalar library calls. Instead, they are expanded into
+// polynomial approximations that run on all lanes at once, using the
+// reduction steps and coefficients from the Cephes single precision math
+// library. Special inputs (zero, infinity, NaN, out of range values) are
+// patched with vector selects, which become masked moves.
+//
+// Denormal inputs are treated as if they were zero, and results that would
+// be denormal are flushed to zero.
+//
+//===----------------------------------------------------------------------===//
+
+#include "NyuziISelLowering.h"
+#include "llvm/CodeGen/SelectionDAG.h"
+using namespace llvm;
+
+namespace {
+
+// Helper for building arithmetic on v16f32 values and their v16i32 bit
+// patterns.
+class MathBuilder {
+public:
+  MathBuilder(SelectionDAG &DAG, SDLoc DL) : DAG(DAG), DL(DL) {}
+
+  SDValue floatConst(double Val) {
+    return DAG.getConstantFP(Val, MVT::v16f32);
+  }
+
+  SDValue intConst(uint32_t Val) { return DAG.getConstant(Val, MVT::v16i32); }
+
+  SDValue op(unsigned Opcode, SDValue A, SDValue B) {
+    return DAG.getNode(Opcode, DL, A.getValueType(), A, B);
+  }
+
+  SDValue bitsOf(SDValue V) {
+    return DAG.getNode(ISD::BITCAST, DL, MVT::v16i32, V);
+  }
+
+  SDValue fromBits(SDValue V) {
+    return DAG.getNode(ISD::BITCAST, DL, MVT::v16f32, V);
+  }
+
+  SDValue toInt(SDValue V) {
+    return DAG.getNode(ISD::FP_TO_SINT, DL, MVT::v16i32, V);
+  }
+
+  SDValue toFloat(SDValue V) {
+    return DAG.getNode(ISD::SINT_TO_FP, DL, MVT::v16f32, V);
+  }
+
+  // Evaluate a polynomial using Horner's method. Coefficients are ordered
+  // from the highest power to the constant term.
+  SDValue poly(SDValue X, ArrayRef<double> Coeffs) {
+    SDValue Result = floatConst(Coeffs[0]);
+    for (unsigned i = 1; i < Coeffs.size(); i++)
+      Result = op(ISD::FADD, op(ISD::FMUL, Result, X), floatConst(Coeffs[i]));
+
+    return Result;
+  }
+
+  // Return IfTrue in lanes where A CC B holds, and IfFalse in the others.
+  SDValue select(SDValue A, ISD::CondCode CC, SDValue B, SDValue IfTrue,
+                 SDValue IfFalse) {
+    SDValue Cond = DAG.getSetCC(DL, MVT::v16i32, A, B, CC);
+    return DAG.getNode(ISD::VSELECT, DL, IfTrue.getValueType(), Cond, IfTrue,
+                       IfFalse);
+  }
+
+  SDValue abs(SDValue X) {
+    return fromBits(op(ISD::AND, bitsOf(X), intConst(0x7fffffff)));
+  }
+
+  // Pass through NaN inputs. This compares the bit patterns, because the
+  // hardware has no unordered comparison.
+  SDValue propagateNaN(SDValue X, SDValue Result) {
+    return select(op(ISD::AND, bitsOf(X), intConst(0x7fffffff)), ISD::SETGT,
+                  intConst(0x7f800000), X, Result);
+  }
+
+  SDValue infinity() {
+    return DAG.getConstantFP(APFloat::getInf(APFloat::IEEEsingle),
+                             MVT::v16f32);
+  }
+
+  SDValue nan() {
+    return DAG.getConstantFP(APFloat::getNaN(APFloat::IEEEsingle),
+                             MVT::v16f32);
+  }
+
+private:
+  SelectionDAG &DAG;
+  SDLoc DL;
+};
+
+// Polynomial coefficients, from the highest power to the constant term.
+const double kExp2Coeffs[] = {
+    1.535336188319500E-4, 1.339887440266574E-3, 9.618437357674640E-3,
+    5.550332471162809E-2, 2.402264791363012E-1, 6.931472028550421E-1, 1.0};
+const double kLogCoeffs[] = {
+    7.0376836292E-2,  -1.1514610310E-1, 1.1676998740E-1,
+    -1.2420140846E-1, 1.4249322787E-1,  -1.6668057665E-1,
+    2.0000714765E-1,  -2.4999993993E-1, 3.3333331174E-1};
+const double kSinCoeffs[] = {-1.9515295891E-4, 8.3321608736E-3,
+                             -1.6666654611E-1};
+const double kCosCoeffs[] = {2.443315711809948E-5, -1.388731625493765E-3,
+                             4.166664568298827E-2};
+
+} // namespace
+
+// 2^x = 2^n * 2^f, where n is x rounded to the nearest integer and f is in
+// [-0.5, 0.5]. 2^n is built directly in the exponent field.
+static SDValue expandExp2(MathBuilder &B, SDValue X) {
+  SDValue Clamped = B.select(X, ISD::SETOGT, B.floatConst(128.0),
+                             B.floatConst(128.0), X);
+  Clamped = B.select(Clamped, ISD::SETOLT, B.floatConst(-125.0),
+                     B.floatConst(-125.0), Clamped);
+
+  // Conversion truncates towards zero, so adjust negative values to get
+  // the floor.
+  SDValue Rounded = B.op(ISD::FADD, Clamped, B.floatConst(0.5));
+  SDValue N = B.toInt(Rounded);
+  SDValue NFloat = B.toFloat(N);
+  SDValue Adjust = B.select(NFloat, ISD::SETOGT, Rounded, B.intConst(1),
+                            B.intConst(0));
+  N = B.op(ISD::SUB, N, Adjust);
+  NFloat = B.toFloat(N);
+
+  SDValue F = B.op(ISD::FSUB, Clamped, NFloat);
+  SDValue P = B.poly(F, kExp2Coeffs);
+
+  // Scale by 2^(n - 1) and 2, so the exponent field is in range for
+  // n = 128 (which overflows to infinity, as it should).
+  SDValue Scale = B.fromBits(
+      B.op(ISD::SHL, B.op(ISD::ADD, N, B.intConst(126)), B.intConst(23)));
+  SDValue Result = B.op(ISD::FMUL, B.op(ISD::FADD, P, P), Scale);
+  Result = B.select(X, ISD::SETOLT, B.floatConst(-125.0), B.floatConst(0.0),
+                    Result);
+  return B.propagateNaN(X, Result);
+}
+
+// ln(x) = ln(m) + e * ln(2), where x = m * 2^e and m is in
+// [sqrt(2) / 2, sqrt(2)).
+static SDValue expandLog(MathBuilder &B, SDValue X) {
+  SDValue Bits = B.bitsOf(X);
+  SDValue Exponent = B.op(ISD::SUB, B.op(ISD::SRL, Bits, B.intConst(23)),
+                          B.intConst(126));
+  SDValue E = B.toFloat(Exponent);
+
+  // Mantissa in [0.5, 1)
+  SDValue M = B.fromBits(B.op(ISD::OR, B.op(ISD::AND, Bits,
+                                            B.intConst(0x007fffff)),
+                              B.intConst(0x3f000000)));
+  SDValue SqrtHalf = B.floatConst(0.707106781186547524);
+  E = B.select(M, ISD::SETOLT, SqrtHalf,
+               B.op(ISD::FSUB, E, B.floatConst(1.0)), E);
+  SDValue One = B.floatConst(1.0);
+  M = B.select(M, ISD::SETOLT, SqrtHalf,
+               B.op(ISD::FSUB, B.op(ISD::FADD, M, M), One),
+               B.op(ISD::FSUB, M, One));
+
+  SDValue Z = B.op(ISD::FMUL, M, M);
+  SDValue Y = B.poly(M, kLogCoeffs);
+  Y = B.op(ISD::FMUL, B.op(ISD::FMUL, Y, M), Z);
+  Y = B.op(ISD::FADD, Y, B.op(ISD::FMUL, E, B.floatConst(-2.12194440e-4)));
+  Y = B.op(ISD::FSUB, Y, B.op(ISD::FMUL, Z, B.floatConst(0.5)));
+  SDValue Result = B.op(ISD::FADD, M, Y);
+  Result = B.op(ISD::FADD, Result,
+                B.op(ISD::FMUL, E, B.floatConst(0.693359375)));
+
+  SDValue Zero = B.floatConst(0.0);
+  SDValue Inf = B.infinity();
+  Result = B.select(X, ISD::SETOEQ, Zero, B.op(ISD::FSUB, Zero, Inf), Result);
+  Result = B.select(X, ISD::SETOLT, Zero, B.nan(), Result);
+  Result = B.select(X, ISD::SETOEQ, Inf, Inf, Result);
+  return B.propagateNaN(X, Result);
+}
+
+// x^y = 2^(y * log2(|x|)). If x is negative, y must be an integer, and the
+// sign of the result depends on whether it is odd.
+static SDValue expandPow(MathBuilder &B, SDValue X, SDValue Y) {
+  SDValue Log2X = B.op(ISD::FMUL, expandLog(B, B.abs(X)),
+                       B.floatConst(1.44269504088896341));
+  SDValue Result = expandExp2(B, B.op(ISD::FMUL, Y, Log2X));
+
+  // Every float with a magnitude of 2^24 or more is an even integer.
+  SDValue YInt = B.toInt(Y);
+  SDValue AbsY = B.abs(Y);
+  SDValue Large = B.floatConst(16777216.0);
+  SDValue IsInt = B.select(B.toFloat(YInt), ISD::SETOEQ, Y, B.intConst(1),
+                           B.intConst(0));
+  IsInt = B.select(AbsY, ISD::SETOGE, Large, B.intConst(1), IsInt);
+  SDValue OddBit = B.select(AbsY, ISD::SETOGE, Large, B.intConst(0),
+                            B.op(ISD::AND, YInt, B.intConst(1)));
+
+  SDValue Negated = B.fromBits(B.op(ISD::XOR, B.bitsOf(Result),
+                                    B.op(ISD::SHL, OddBit, B.intConst(31))));
+  SDValue NegativeResult = B.select(IsInt, ISD::SETNE, B.intConst(0), Negated,
+                                    B.nan());
+  Result = B.select(X, ISD::SETOLT, B.floatConst(0.0), NegativeResult, Result);
+
+  SDValue One = B.floatConst(1.0);
+  Result = B.select(X, ISD::SETOEQ, One, One, Result);
+  return B.select(Y, ISD::SETOEQ, B.floatConst(0.0), One, Result);
+}
+
+// Reduce |x| to the range [-pi/4, pi/4] by subtracting a multiple j of pi/4,
+// where j is even, then use the sine or cosine polynomial depending on the
+// octant. The sign of the result is computed separately and applied with
+// an xor.
+static SDValue expandSinCos(MathBuilder &B, SDValue X, bool IsCos) {
+  SDValue AbsX = B.abs(X);
+  SDValue J = B.toInt(B.op(ISD::FMUL, AbsX, B.floatConst(1.27323954473516)));
+  J = B.op(ISD::AND, B.op(ISD::ADD, J, B.intConst(1)), B.intConst(~1u));
+  SDValue JFloat = B.toFloat(J);
+
+  // Extended precision modular arithmetic
+  SDValue R = B.op(ISD::FSUB, AbsX,
+                   B.op(ISD::FMUL, JFloat, B.floatConst(0.78515625)));
+  R = B.op(ISD::FSUB, R,
+           B.op(ISD::FMUL, JFloat, B.floatConst(2.4187564849853515625e-4)));
+  R = B.op(ISD::FSUB, R,
+           B.op(ISD::FMUL, JFloat, B.floatConst(3.77489497744594108e-8)));
+  SDValue Z = B.op(ISD::FMUL, R, R);
+
+  SDValue SinPoly = B.poly(Z, kSinCoeffs);
+  SinPoly = B.op(ISD::FADD, B.op(ISD::FMUL, B.op(ISD::FMUL, SinPoly, Z), R),
+                 R);
+  SDValue CosPoly = B.poly(Z, kCosCoeffs);
+  CosPoly = B.op(ISD::FMUL, B.op(ISD::FMUL, CosPoly, Z), Z);
+  CosPoly = B.op(ISD::FSUB, CosPoly, B.op(ISD::FMUL, Z, B.floatConst(0.5)));
+  CosPoly = B.op(ISD::FADD, CosPoly, B.floatConst(1.0));
+
+  SDValue Octant = B.op(ISD::AND, J, B.intConst(2));
+  SDValue SignBit;
+  SDValue Result;
+  if (IsCos) {
+    Result = B.select(Octant, ISD::SETNE, B.intConst(0), SinPoly, CosPoly);
+    SignBit = B.op(ISD::AND, B.op(ISD::ADD, J, B.intConst(2)), B.intConst(4));
+  } else {
+    Result = B.select(Octant, ISD::SETNE, B.intConst(0), CosPoly, SinPoly);
+    SignBit = B.op(ISD::XOR, B.op(ISD::AND, J, B.intConst(4)),
+                   B.op(ISD::SRL, B.bitsOf(X), B.intConst(29)));
+    SignBit = B.op(ISD::AND, SignBit, B.intConst(4));
+  }
+
+  Result = B.fromBits(B.op(ISD::XOR, B.bitsOf(Result),
+                           B.op(ISD::SHL, SignBit, B.intConst(29))));
+  Result = B.select(AbsX, ISD::SETOEQ, B.infinity(), B.nan(), Result);
+  return B.propagateNaN(X, Result);
+}
+
+SDValue NyuziTargetLowering::LowerVectorMath(SDValue Op,
+                                             SelectionDAG &DAG) const {
+  MathBuilder B(DAG, SDLoc(Op));
+  SDValue X = Op.getOperand(0);
+  switch (Op.getOpcode()) {
+  case ISD::FSIN:
+    return expandSinCos(B, X, false);
+
+  case ISD::FCOS:
+    return expandSinCos(B, X, true);
+
+  case ISD::FEXP2:
+    return expandExp2(B, X);
+
+  case ISD::FEXP:
+    return expandExp2(B, B.op(ISD::FMUL, X, B.floatConst(1.44269504088896341)));
+
+  case ISD::FLOG:
+    return expandLog(B, X);
+
+  case ISD::FLOG2:
+    return B.op(ISD::FMUL, expandLog(B, X), B.floatConst(1.44269504088896341));
+
+  case ISD::FLOG10:
+    return B.op(ISD::FMUL, expandLog(B, X), B.floatConst(0.434294481903251828));
+
+  case ISD::FPOW:
+    return expandPow(B, X, Op.getOperand(1));
+
+  default:
+    llvm_unreachable("unexpected math operation");
+  }
+}
@@ -0,0 +1,80 @@
+//===-- NyuziMemBarMerge.cpp - Remove redundant memory barriers ----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Fences for atomic operations are inserted independently for each operation,
+// so back to back atomics produce adjacent membar instructions (for example,
+// the trailing fence of one seq_cst operation and the leading fence of the
+// next). A membar only orders memory accesses before it with ones after it, so
+// a second membar with no memory access since the previous one has no effect
+// and is removed.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "nyuzi-membar-merge"
+#include "Nyuzi.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineFunction.h"
+using namespace llvm;
+
+STATISTIC(NumMemBarsRemoved, "Number of redundant membars removed");
+
+namespace {
+class NyuziMemBarMerge : public MachineFunctionPass {
+public:
+  static char ID;
+
+  NyuziMemBarMerge() : MachineFunctionPass(ID) {}
+
+  virtual bool runOnMachineFunction(MachineFunction &MF) override;
+
+  virtual const char *getPassName() const override {
+    return "Nyuzi membar merge";
+  }
+
+private:
+  bool runOnMachineBasicBlock(MachineBasicBlock &MBB);
+};
+
+char NyuziMemBarMerge::ID = 0;
+} // namespace
+
+FunctionPass *llvm::createNyuziMemBarMergePass() {
+  return new NyuziMemBarMerge();
+}
+
+bool NyuziMemBarMerge::runOnMachineFunction(MachineFunction &MF) {
+  bool Changed = false;
+  for (auto &MBB : MF)
+    Changed |= runOnMachineBasicBlock(MBB);
+
+  return Changed;
+}
+
+bool NyuziMemBarMerge::runOnMachineBasicBlock(MachineBasicBlock &MBB) {
+  bool Changed = false;
+  bool SawMemBar = false;
+  MachineBasicBlock::iterator MBBI = MBB.begin();
+  while (MBBI != MBB.end()) {
+    MachineInstr *MI = MBBI++;
+    if (MI->getOpcode() == Nyuzi::MEMBAR) {
+      if (SawMemBar) {
+        MI->eraseFromParent();
+        ++NumMemBarsRemoved;
+        Changed = true;
+      }
+
+      SawMemBar = true;
+    } else if (MI->mayLoad() || MI->mayStore() || MI->isCall() ||
+               MI->hasUnmodeledSideEffects())
+      SawMemBar = false;
+  }
+
+  return Changed;
+}
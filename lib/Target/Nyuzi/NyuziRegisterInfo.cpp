@@ -22,6 +22,7 @@
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/IR/Function.h"
 #include "llvm/IR/Type.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Target/TargetInstrInfo.h"
@@ -39,11 +40,17 @@ NyuziRegisterInfo::NyuziRegisterInfo(NyuziSubtarget &st,
 
 const uint16_t *
 NyuziRegisterInfo::getCalleeSavedRegs(const MachineFunction *MF) const {
+  if (MF && MF->getFunction()->getCallingConv() == CallingConv::Fast)
+    return NyuziCSR_Fast_SaveList;
+
   return NyuziCSR_SaveList;
 }
 
 const uint32_t *
-NyuziRegisterInfo::getCallPreservedMask(CallingConv::ID) const {
+NyuziRegisterInfo::getCallPreservedMask(CallingConv::ID CC) const {
+  if (CC == CallingConv::Fast)
+    return NyuziCSR_Fast_RegMask;
+
   return NyuziCSR_RegMask;
 }
 
@@ -63,6 +70,13 @@ NyuziRegisterInfo::getPointerRegClass(const MachineFunction &MF,
   return &Nyuzi::GPR32RegClass;
 }
 
+// Masked memory instructions only have a 10 bit offset field (see
+// NyuziDAGToDAGISel::SelectMaskedADDRri).
+static bool isMaskedMemoryOp(unsigned Opcode) {
+  return Opcode == Nyuzi::INT_BLOCK_LOADI_MASKED ||
+         Opcode == Nyuzi::INT_BLOCK_STOREI_MASKED;
+}
+
 void NyuziRegisterInfo::eliminateFrameIndex(MachineBasicBlock::iterator MBBI,
                                                  int SPAdj,
                                                  unsigned FIOperandNum,
@@ -103,17 +117,37 @@ void NyuziRegisterInfo::eliminateFrameIndex(MachineBasicBlock::iterator MBBI,
     FrameReg = getFrameRegister(MF);
 
   // Replace frame index with a frame pointer reference.
-  if (isInt<13>(Offset)) {
+  bool IsMasked = isMaskedMemoryOp(MI.getOpcode());
+  if (IsMasked ? isInt<10>(Offset) : isInt<13>(Offset)) {
     // If the offset is small enough to fit in the immediate field, directly
     // encode it.
     MI.getOperand(FIOperandNum).ChangeToRegister(FrameReg, false);
     MI.getOperand(FIOperandNum + 1).ChangeToImmediate(Offset);
+  } else if (isInt<13>(Offset)) {
+    // Only masked instructions get here. Add the part of the offset that
+    // doesn't fit to the frame register.
+    DebugLoc DL = MBBI->getDebugLoc();
+    MachineBasicBlock &MBB = *MBBI->getParent();
+    const NyuziInstrInfo &TII =
+        *static_cast<const NyuziInstrInfo*>(MBB.getParent()->getTarget().getSubtargetImpl()->getInstrInfo());
+
+    MachineRegisterInfo &RegInfo = MBB.getParent()->getRegInfo();
+    unsigned Reg = RegInfo.createVirtualRegister(&Nyuzi::GPR32RegClass);
+    BuildMI(MBB, MBBI, DL, TII.get(Nyuzi::ADDISSI), Reg)
+        .addReg(FrameReg)
+        .addImm(Offset & ~0x1ff);
+    MI.getOperand(FIOperandNum).ChangeToRegister(Reg, false);
+    MI.getOperand(FIOperandNum + 1).ChangeToImmediate(Offset & 0x1ff);
   } else if (isInt<25>(Offset)){
     DebugLoc DL = MBBI->getDebugLoc();
     MachineBasicBlock &MBB = *MBBI->getParent();
     const NyuziInstrInfo &TII =
         *static_cast<const NyuziInstrInfo*>(MBB.getParent()->getTarget().getSubtargetImpl()->getInstrInfo());
 
+    // The low bits that are left in the immediate field must fit in the
+    // masked form's field. The rest of the low 12 bits are added
+    // separately.
+    int LowMask = IsMasked ? 0x1ff : 0xfff;
     MachineRegisterInfo &RegInfo = MBB.getParent()->getRegInfo();
     unsigned Reg = RegInfo.createVirtualRegister(&Nyuzi::GPR32RegClass);
     BuildMI(MBB, MBBI, DL, TII.get(Nyuzi::MOVESimm), Reg)
@@ -121,11 +155,17 @@ void NyuziRegisterInfo::eliminateFrameIndex(MachineBasicBlock::iterator MBBI,
     BuildMI(MBB, MBBI, DL, TII.get(Nyuzi::SLLSSS), Reg)
         .addReg(Reg)
         .addImm(12);
+    if (Offset & 0xfff & ~LowMask) {
+      BuildMI(MBB, MBBI, DL, TII.get(Nyuzi::ADDISSI), Reg)
+          .addReg(Reg)
+          .addImm(Offset & 0xfff & ~LowMask);
+    }
+
     BuildMI(MBB, MBBI, DL, TII.get(Nyuzi::ADDISSS), Reg)
         .addReg(FrameReg)
         .addReg(Reg);
     MI.getOperand(FIOperandNum).ChangeToRegister(Reg, false);
-    MI.getOperand(FIOperandNum + 1).ChangeToImmediate(Offset & 0xfff);
+    MI.getOperand(FIOperandNum + 1).ChangeToImmediate(Offset & LowMask);
   }
   else
     report_fatal_error("frame index out of bounds: frame too large");
@@ -44,6 +44,13 @@ struct NyuziRegisterInfo : public NyuziGenRegisterInfo {
   virtual bool requiresRegisterScavenging(const MachineFunction &MF) const override;
   virtual bool trackLivenessAfterRegAlloc(const MachineFunction &MF) const override;
   virtual bool requiresFrameIndexScavenging(const MachineFunction &MF) const override;
+
+  // The cost is compared against block frequencies, where the entry block is
+  // 1 << 14. The first use of a callee saved register costs a save and a
+  // restore, which run as often as the entry block. Keeping callee saved
+  // registers off early exit paths also lets NyuziFrameLowering skip setting
+  // up the frame there.
+  virtual unsigned getCSRFirstUseCost() const override { return 2 << 14; }
 };
 
 } // end namespace llvm
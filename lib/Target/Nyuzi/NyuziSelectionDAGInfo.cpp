@@ -10,14 +10,260 @@
 //
 // This file implements the NyuziSelectionDAGInfo class.
 //
+// memcpy, memmove, and memset with a constant size are expanded inline into
+// 64 byte block loads and stores when the destination (and source) are
+// at a known offset from a 64 byte aligned address. Partial blocks at either
+// end are written with a masked block store.
+//
 //===----------------------------------------------------------------------===//
 
 #define DEBUG_TYPE "nyuzi-selectiondag-info"
 #include "NyuziTargetMachine.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/CodeGen/SelectionDAG.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/Support/CommandLine.h"
 using namespace llvm;
 
+static cl::opt<unsigned> MemcpyInlineLimit(
+    "nyuzi-memcpy-inline-limit", cl::Hidden, cl::init(512),
+    cl::desc("Maximum number of bytes to copy inline for memcpy/memmove"));
+
+static cl::opt<unsigned> MemsetInlineLimit(
+    "nyuzi-memset-inline-limit", cl::Hidden, cl::init(1024),
+    cl::desc("Maximum number of bytes to fill inline for memset"));
+
+namespace {
+const unsigned kBlockSize = 64;
+}
+
 NyuziSelectionDAGInfo::NyuziSelectionDAGInfo(
     const DataLayout &DL)
     : TargetSelectionDAGInfo(&DL) {}
 
 NyuziSelectionDAGInfo::~NyuziSelectionDAGInfo() {}
+
+// Split Ptr into a base address that is known to be 64 byte aligned and an
+// offset from it that is less than 64. Returns false if there is no such base.
+static bool getBlockBase(SelectionDAG &DAG, SDLoc DL, SDValue Ptr,
+                         unsigned Align, SDValue &Base, unsigned &Offset) {
+  if (Align >= kBlockSize) {
+    Base = Ptr;
+    Offset = 0;
+    return true;
+  }
+
+  if (Ptr.getOpcode() != ISD::ADD)
+    return false;
+
+  ConstantSDNode *C = dyn_cast<ConstantSDNode>(Ptr.getOperand(1));
+  if (!C || DAG.InferPtrAlignment(Ptr.getOperand(0)) < kBlockSize)
+    return false;
+
+  int64_t BlockOffset = C->getSExtValue() & ~int64_t(kBlockSize - 1);
+  Base = Ptr.getOperand(0);
+  if (BlockOffset != 0)
+    Base = DAG.getNode(ISD::ADD, DL, MVT::i32, Base,
+                       DAG.getConstant(BlockOffset, MVT::i32));
+
+  Offset = C->getSExtValue() & (kBlockSize - 1);
+  return true;
+}
+
+static SDValue getAddress(SelectionDAG &DAG, SDLoc DL, SDValue Base,
+                          uint64_t Offset) {
+  if (Offset == 0)
+    return Base;
+
+  return DAG.getNode(ISD::ADD, DL, MVT::i32, Base,
+                     DAG.getConstant(Offset, MVT::i32));
+}
+
+// Return pointer info for the 64 byte aligned block that contains the access
+// described by PtrInfo, which starts Offset bytes into it. A memory operand's
+// alignment is derived from its offset, so this is relative to the object that
+// the IR pointer is derived from, at which the offsets of the blocks are
+// multiples of 64. If there is no such object, the IR pointer is dropped.
+static MachinePointerInfo getBlockPtrInfo(SelectionDAG &DAG,
+                                          MachinePointerInfo PtrInfo,
+                                          unsigned Offset) {
+  if (Offset == 0)
+    return PtrInfo;
+
+  if (PtrInfo.V.isNull() || !PtrInfo.V.is<const Value *>())
+    return MachinePointerInfo();
+
+  int64_t BaseOffset = 0;
+  const Value *Base = GetPointerBaseWithConstantOffset(
+      PtrInfo.V.get<const Value *>(), BaseOffset,
+      DAG.getTargetLoweringInfo().getDataLayout());
+  BaseOffset += PtrInfo.Offset - Offset;
+  if (!Base || BaseOffset % kBlockSize != 0)
+    return MachinePointerInfo();
+
+  return MachinePointerInfo(Base, BaseOffset);
+}
+
+//
+// Copy Size bytes from SrcBase + Offset to DstBase + Offset, or fill them with
+// FillVal if SrcBase is null. Both bases are 64 byte aligned. All loads are
+// issued before any store, so this also works for overlapping memmoves.
+// A partial block is loaded in its entirety: an aligned block never crosses
+// a page boundary, so this can't fault.
+//
+static SDValue emitBlockOps(SelectionDAG &DAG, SDLoc DL, SDValue Chain,
+                            SDValue DstBase, SDValue SrcBase, SDValue FillVal,
+                            unsigned Offset, uint64_t Size,
+                            MachinePointerInfo DstPtrInfo,
+                            MachinePointerInfo SrcPtrInfo) {
+  DstPtrInfo = getBlockPtrInfo(DAG, DstPtrInfo, Offset);
+  SrcPtrInfo = getBlockPtrInfo(DAG, SrcPtrInfo, Offset);
+
+  // With fewer than four bytes, there are no whole words, so there is no
+  // block to write, even if the bytes start partway into one.
+  uint64_t WordEnd = Offset + (Size & ~uint64_t(3));
+  uint64_t BlockEnd = WordEnd > Offset ? WordEnd : 0;
+  uint64_t End = Offset + Size;
+  SDValue BlockFill;
+  if (!SrcBase.getNode())
+    BlockFill = DAG.getNode(NyuziISD::SPLAT, DL, MVT::v16i32, FillVal);
+
+  SmallVector<SDValue, 16> Values;
+  SmallVector<SDValue, 16> LoadChains;
+  for (uint64_t Block = 0; Block < BlockEnd; Block += kBlockSize) {
+    if (SrcBase.getNode()) {
+      SDValue Load = DAG.getLoad(
+          MVT::v16i32, DL, Chain, getAddress(DAG, DL, SrcBase, Block),
+          SrcPtrInfo.getWithOffset(Block), false, false,
+          false, kBlockSize);
+      Values.push_back(Load);
+      LoadChains.push_back(Load.getValue(1));
+    } else
+      Values.push_back(BlockFill);
+  }
+
+  // Trailing bytes that don't fill a whole word.
+  for (uint64_t Byte = WordEnd; Byte < End; Byte++) {
+    if (SrcBase.getNode()) {
+      SDValue Load = DAG.getExtLoad(
+          ISD::ZEXTLOAD, DL, MVT::i32, Chain,
+          getAddress(DAG, DL, SrcBase, Byte),
+          SrcPtrInfo.getWithOffset(Byte), MVT::i8, false, false,
+          false, 1);
+      Values.push_back(Load);
+      LoadChains.push_back(Load.getValue(1));
+    } else
+      Values.push_back(FillVal);
+  }
+
+  if (!LoadChains.empty())
+    Chain = DAG.getNode(ISD::TokenFactor, DL, MVT::Other, LoadChains);
+
+  SmallVector<SDValue, 16> StoreChains;
+  unsigned ValueIndex = 0;
+  for (uint64_t Block = 0; Block < BlockEnd; Block += kBlockSize) {
+    SDValue Addr = getAddress(DAG, DL, DstBase, Block);
+    MachinePointerInfo PtrInfo = DstPtrInfo.getWithOffset(Block);
+    SDValue Value = Values[ValueIndex++];
+    uint64_t FirstLane = Block < Offset ? (Offset - Block) / 4 : 0;
+    uint64_t LastLane = std::min(WordEnd - Block, uint64_t(kBlockSize)) / 4;
+    if (FirstLane == 0 && LastLane == 16) {
+      StoreChains.push_back(
+          DAG.getStore(Chain, DL, Value, Addr, PtrInfo, false, false,
+                       kBlockSize));
+    } else {
+      unsigned Mask = 0;
+      for (uint64_t Lane = FirstLane; Lane < LastLane; Lane++)
+        Mask |= 0x8000 >> Lane;
+
+      SDValue Ops[] = {
+          Chain, DAG.getConstant(Intrinsic::nyuzi_block_storei_masked, MVT::i32),
+          Addr, Value, DAG.getConstant(Mask, MVT::i32)};
+      StoreChains.push_back(DAG.getMemIntrinsicNode(
+          ISD::INTRINSIC_VOID, DL, DAG.getVTList(MVT::Other), Ops,
+          MVT::v16i32, PtrInfo, kBlockSize, false, false, true));
+    }
+  }
+
+  for (uint64_t Byte = WordEnd; Byte < End; Byte++) {
+    StoreChains.push_back(DAG.getTruncStore(
+        Chain, DL, Values[ValueIndex++], getAddress(DAG, DL, DstBase, Byte),
+        DstPtrInfo.getWithOffset(Byte), MVT::i8, false, false, 1));
+  }
+
+  return DAG.getNode(ISD::TokenFactor, DL, MVT::Other, StoreChains);
+}
+
+static SDValue emitCopy(SelectionDAG &DAG, SDLoc DL, SDValue Chain,
+                        SDValue Dst, SDValue Src, SDValue Size, unsigned Align,
+                        bool isVolatile, bool AlwaysInline,
+                        MachinePointerInfo DstPtrInfo,
+                        MachinePointerInfo SrcPtrInfo) {
+  ConstantSDNode *ConstantSize = dyn_cast<ConstantSDNode>(Size);
+  if (!ConstantSize || isVolatile)
+    return SDValue();
+
+  uint64_t SizeVal = ConstantSize->getZExtValue();
+  if (SizeVal > MemcpyInlineLimit && !AlwaysInline)
+    return SDValue();
+
+  SDValue DstBase;
+  SDValue SrcBase;
+  unsigned DstOffset;
+  unsigned SrcOffset;
+  if (!getBlockBase(DAG, DL, Dst, Align, DstBase, DstOffset) ||
+      !getBlockBase(DAG, DL, Src, Align, SrcBase, SrcOffset) ||
+      DstOffset != SrcOffset || (DstOffset & 3) != 0)
+    return SDValue();
+
+  return emitBlockOps(DAG, DL, Chain, DstBase, SrcBase, SDValue(), DstOffset,
+                      SizeVal, DstPtrInfo, SrcPtrInfo);
+}
+
+SDValue NyuziSelectionDAGInfo::EmitTargetCodeForMemcpy(
+    SelectionDAG &DAG, SDLoc DL, SDValue Chain, SDValue Dst, SDValue Src,
+    SDValue Size, unsigned Align, bool isVolatile, bool AlwaysInline,
+    MachinePointerInfo DstPtrInfo, MachinePointerInfo SrcPtrInfo) const {
+  return emitCopy(DAG, DL, Chain, Dst, Src, Size, Align, isVolatile,
+                  AlwaysInline, DstPtrInfo, SrcPtrInfo);
+}
+
+SDValue NyuziSelectionDAGInfo::EmitTargetCodeForMemmove(
+    SelectionDAG &DAG, SDLoc DL, SDValue Chain, SDValue Dst, SDValue Src,
+    SDValue Size, unsigned Align, bool isVolatile,
+    MachinePointerInfo DstPtrInfo, MachinePointerInfo SrcPtrInfo) const {
+  return emitCopy(DAG, DL, Chain, Dst, Src, Size, Align, isVolatile, false,
+                  DstPtrInfo, SrcPtrInfo);
+}
+
+SDValue NyuziSelectionDAGInfo::EmitTargetCodeForMemset(
+    SelectionDAG &DAG, SDLoc DL, SDValue Chain, SDValue Dst, SDValue Src,
+    SDValue Size, unsigned Align, bool isVolatile,
+    MachinePointerInfo DstPtrInfo) const {
+  ConstantSDNode *ConstantSize = dyn_cast<ConstantSDNode>(Size);
+  if (!ConstantSize || isVolatile)
+    return SDValue();
+
+  uint64_t SizeVal = ConstantSize->getZExtValue();
+  if (SizeVal > MemsetInlineLimit)
+    return SDValue();
+
+  SDValue DstBase;
+  unsigned DstOffset;
+  if (!getBlockBase(DAG, DL, Dst, Align, DstBase, DstOffset) ||
+      (DstOffset & 3) != 0)
+    return SDValue();
+
+  // Replicate the byte value into all four bytes of a word.
+  SDValue FillVal;
+  if (ConstantSDNode *C = dyn_cast<ConstantSDNode>(Src))
+    FillVal = DAG.getConstant((C->getZExtValue() & 0xff) * 0x01010101,
+                              MVT::i32);
+  else
+    FillVal = DAG.getNode(ISD::MUL, DL, MVT::i32,
+                          DAG.getZExtOrTrunc(Src, DL, MVT::i32),
+                          DAG.getConstant(0x01010101, MVT::i32));
+
+  return emitBlockOps(DAG, DL, Chain, DstBase, SDValue(), FillVal, DstOffset,
+                      SizeVal, DstPtrInfo, MachinePointerInfo());
+}
@@ -43,4 +43,8 @@ NyuziSubtarget::NyuziSubtarget(const std::string &TT,
 
   // Parse features string.
   ParseSubtargetFeatures(CPUName, FS);
+
+  // The base class picked the scheduling model before the default CPU was
+  // filled in.
+  InitCPUSchedModel(CPUName);
 }
@@ -55,6 +55,11 @@ public:
   virtual const NyuziSelectionDAGInfo *getSelectionDAGInfo() const override {
     return &TSInfo;
   }
+  virtual bool enableMachineScheduler() const override { return true; }
+  virtual bool enableEarlyIfConversion() const override { return true; }
+  virtual bool enableInOrderEarlyIfConversionCost() const override {
+    return true;
+  }
 };
 
 } // end namespace llvm
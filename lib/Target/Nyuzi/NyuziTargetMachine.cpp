@@ -13,11 +13,17 @@
 
 #include "NyuziTargetMachine.h"
 #include "Nyuzi.h"
+#include "NyuziTargetTransformInfo.h"
 #include "llvm/CodeGen/Passes.h"
 #include "llvm/PassManager.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/TargetRegistry.h"
 using namespace llvm;
 
+static cl::opt<bool> EnableLoopPrefetch(
+    "nyuzi-loop-prefetch", cl::Hidden, cl::init(false),
+    cl::desc("Prefetch strided loads in innermost loops"));
+
 extern "C" void LLVMInitializeNyuziTarget() {
   // Register the target.
   RegisterTargetMachine<NyuziTargetMachine> X(TheNyuziTarget);
@@ -30,7 +36,7 @@ NyuziTargetMachine::NyuziTargetMachine(const Target &T, StringRef TT,
                                                  CodeModel::Model CM,
                                                  CodeGenOpt::Level OL)
     : LLVMTargetMachine(T, TT, CPU, FS, Options, RM, CM, OL),
-      DL("e-m:e-p:32:32"),
+      DL("e-m:e-p:32:32-n32"),
       TLOF(make_unique<NyuziTargetObjectFile>()),
       Subtarget(TT, CPU, FS, *this) {
   initAsmInfo();
@@ -47,17 +53,52 @@ public:
     return getTM<NyuziTargetMachine>();
   }
 
+  virtual void addIRPasses() override;
   virtual bool addInstSelector() override;
+  virtual bool addILPOpts() override;
+  virtual void addPreEmitPass() override;
 };
 } // namespace
 
+TargetIRAnalysis NyuziTargetMachine::getTargetIRAnalysis() {
+  return TargetIRAnalysis(
+      [this](Function &) { return TargetTransformInfo(NyuziTTIImpl(this)); });
+}
+
 TargetPassConfig *
 NyuziTargetMachine::createPassConfig(PassManagerBase &PM) {
   return new NyuziPassConfig(this, PM);
 }
 
+void NyuziPassConfig::addIRPasses() {
+  addPass(createAtomicExpandPass(&getNyuziTargetMachine()));
+  if (getOptLevel() != CodeGenOpt::None) {
+    addPass(createNyuziGatherScatterFormationPass());
+    if (EnableLoopPrefetch)
+      addPass(createNyuziLoopPrefetchPass());
+  }
+
+  TargetPassConfig::addIRPasses();
+}
+
 bool NyuziPassConfig::addInstSelector() {
   addPass(createNyuziISelDag(getNyuziTargetMachine()));
   return false;
 }
 
+// The SELECT pseudo instructions are expanded into branches by the custom
+// inserter. Early if-conversion turns short diamonds (from those or from the
+// source) back into branch-free code where the trace metrics say it is cheaper.
+bool NyuziPassConfig::addILPOpts() {
+  addPass(&EarlyIfConverterID);
+  return true;
+}
+
+void NyuziPassConfig::addPreEmitPass() {
+  if (getOptLevel() != CodeGenOpt::None)
+    addPass(createNyuziMemBarMergePass());
+
+  // This must run after block placement.
+  addPass(createNyuziCFIFixupPass());
+}
+
@@ -36,6 +36,7 @@ public:
 
   // Pass Pipeline Configuration
   virtual TargetPassConfig *createPassConfig(PassManagerBase &PM) override;
+  virtual TargetIRAnalysis getTargetIRAnalysis() override;
   virtual const NyuziSubtarget *getSubtargetImpl() const override {
     return &Subtarget;
   }
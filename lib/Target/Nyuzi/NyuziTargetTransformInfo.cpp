@@ -0,0 +1,279 @@
+//===-- NyuziTargetTransformInfo.cpp - Nyuzi specific TTI -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Costs are in units of issue cycles.  The vector unit issues one 16 lane
+// operation per cycle and the floating point pipeline is fully pipelined, so
+// most legal operations cost 1 regardless of whether they are scalar or vector.
+//
+//===----------------------------------------------------------------------===//
+
+#include "NyuziTargetTransformInfo.h"
+#include "llvm/CodeGen/BasicTTIImpl.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Target/CostTable.h"
+#include "llvm/Target/TargetLowering.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "nyuzitti"
+
+namespace {
+
+// Number of instructions in the inline unsigned division sequence.
+const unsigned kIntDivCost = 30;
+
+// Division by a constant is a multiply high and a few shifts and adds.
+const unsigned kIntDivByConstantCost = 4;
+
+// Gather and scatter transfer one lane per cycle.
+const unsigned kGatherScatterCost = 16;
+
+// Each step of a horizontal reduction computes the shuffle indices and
+// shuffles, followed by the operation itself.
+const unsigned kReductionStepCost = 2;
+
+const CostTblEntry<MVT::SimpleValueType> NyuziCostTable[] = {
+  // There is no floating point divider.  LowerFDIV computes a reciprocal
+  // estimate, refines it with two Newton-Raphson iterations (three operations
+  // each), and multiplies by the dividend.
+  { ISD::FDIV, MVT::f32, 8 },
+  { ISD::FDIV, MVT::v16f32, 8 },
+
+  // LowerFSQRT refines an integer estimate (about 5 bits) with three
+  // Newton-Raphson iterations (four operations each), then fixes up infinity,
+  // negative numbers, zero and denormals.
+  { ISD::FSQRT, MVT::f32, 24 },
+  { ISD::FSQRT, MVT::v16f32, 24 },
+
+  // Vector transcendental functions are expanded into polynomials by
+  // NyuziMathLowering.  Scalar ones are library calls.
+  { ISD::FSIN, MVT::v16f32, 35 },
+  { ISD::FCOS, MVT::v16f32, 35 },
+  { ISD::FEXP, MVT::v16f32, 30 },
+  { ISD::FEXP2, MVT::v16f32, 30 },
+  { ISD::FLOG, MVT::v16f32, 40 },
+  { ISD::FLOG2, MVT::v16f32, 40 },
+  { ISD::FLOG10, MVT::v16f32, 40 },
+  { ISD::FPOW, MVT::v16f32, 90 },
+
+  // LowerFROUND converts to an integer and back, then corrects the result
+  // with comparisons. Scalar corrections are bitwise operations on the
+  // comparison result, where vectors can use a masked move.
+  { ISD::FTRUNC, MVT::f32, 11 },
+  { ISD::FFLOOR, MVT::f32, 16 },
+  { ISD::FCEIL, MVT::f32, 16 },
+  { ISD::FROUND, MVT::f32, 20 },
+  { ISD::FRINT, MVT::f32, 22 },
+  { ISD::FNEARBYINT, MVT::f32, 22 },
+  { ISD::FTRUNC, MVT::v16f32, 7 },
+  { ISD::FFLOOR, MVT::v16f32, 10 },
+  { ISD::FCEIL, MVT::v16f32, 10 },
+  { ISD::FROUND, MVT::v16f32, 13 },
+  { ISD::FRINT, MVT::v16f32, 16 },
+  { ISD::FNEARBYINT, MVT::v16f32, 16 },
+
+  // LowerCTPOP and LowerBSWAP are sequences of shifts and masks, with the
+  // mask constants loaded from the constant pool. They are the same length
+  // for vectors and scalars.
+  { ISD::CTPOP, MVT::i32, 16 },
+  { ISD::CTPOP, MVT::v16i32, 16 },
+  { ISD::BSWAP, MVT::i32, 10 },
+  { ISD::BSWAP, MVT::v16i32, 10 },
+
+  // There is no integer divider.  LowerDIVREM uses a floating point
+  // reciprocal estimate, refined with integer arithmetic.
+  { ISD::SDIV, MVT::i32, kIntDivCost + 6 },
+  { ISD::UDIV, MVT::i32, kIntDivCost },
+  { ISD::SREM, MVT::i32, kIntDivCost + 6 },
+  { ISD::UREM, MVT::i32, kIntDivCost },
+  { ISD::SDIV, MVT::v16i32, kIntDivCost + 6 },
+  { ISD::UDIV, MVT::v16i32, kIntDivCost },
+  { ISD::SREM, MVT::v16i32, kIntDivCost + 6 },
+  { ISD::UREM, MVT::v16i32, kIntDivCost },
+};
+
+} // namespace
+
+// Cost of moving every element of a vector into or out of scalar registers.
+unsigned NyuziTTIImpl::getLaneByLaneCost(Type *Ty, bool Insert, bool Extract) {
+  unsigned Cost = 0;
+  for (unsigned i = 0, e = Ty->getVectorNumElements(); i < e; ++i) {
+    if (Insert)
+      Cost += getVectorInstrCost(Instruction::InsertElement, Ty, i);
+    if (Extract)
+      Cost += getVectorInstrCost(Instruction::ExtractElement, Ty, i);
+  }
+
+  return Cost;
+}
+
+unsigned NyuziTTIImpl::getArithmeticInstrCost(
+    unsigned Opcode, Type *Ty, TTI::OperandValueKind Opd1Info,
+    TTI::OperandValueKind Opd2Info, TTI::OperandValueProperties Opd1PropInfo,
+    TTI::OperandValueProperties Opd2PropInfo) {
+  std::pair<unsigned, MVT> LT = TLI->getTypeLegalizationCost(Ty);
+  int ISD = TLI->InstructionOpcodeToISD(Opcode);
+
+  if ((ISD == ISD::SDIV || ISD == ISD::UDIV || ISD == ISD::SREM ||
+       ISD == ISD::UREM) &&
+      Opd2Info == TTI::OK_UniformConstantValue)
+    return LT.first * kIntDivByConstantCost;
+
+  int Idx = CostTableLookup(NyuziCostTable, ISD, LT.second);
+  if (Idx != -1)
+    return LT.first * NyuziCostTable[Idx].Cost;
+
+  // The default implementation assumes floating point operations are twice
+  // as expensive as integer ones, which isn't true here.
+  if (TLI->isOperationLegalOrPromote(ISD, LT.second))
+    return LT.first;
+
+  return BaseT::getArithmeticInstrCost(Opcode, Ty, Opd1Info, Opd2Info,
+                                       Opd1PropInfo, Opd2PropInfo);
+}
+
+unsigned NyuziTTIImpl::getShuffleCost(TTI::ShuffleKind Kind, Type *Tp,
+                                      int Index, Type *SubTp) {
+  if (!Tp->isVectorTy())
+    return BaseT::getShuffleCost(Kind, Tp, Index, SubTp);
+
+  std::pair<unsigned, MVT> LT = TLI->getTypeLegalizationCost(Tp);
+
+  // A broadcast is a single move from a scalar register.
+  if (Kind == TTI::SK_Broadcast)
+    return LT.first;
+
+  // Alternating lanes from two vectors are a masked move, and a reversal is
+  // a shuffle instruction. Each also needs its mask or index vector.
+  // Extracting or inserting a subvector is likewise a single shuffle or
+  // masked move, or two shuffles that share an index vector when the
+  // inserted lanes move (see NyuziTargetLowering::LowerVECTOR_SHUFFLE).
+  return LT.first * 2;
+}
+
+unsigned NyuziTTIImpl::getCmpSelInstrCost(unsigned Opcode, Type *ValTy,
+                                          Type *CondTy) {
+  if (!ValTy->isVectorTy())
+    return BaseT::getCmpSelInstrCost(Opcode, ValTy, CondTy);
+
+  std::pair<unsigned, MVT> LT = TLI->getTypeLegalizationCost(ValTy);
+
+  // A vector comparison produces a scalar bitmask.  Turning that into a
+  // vector of booleans takes two splats and a masked move.
+  if (Opcode == Instruction::ICmp || Opcode == Instruction::FCmp)
+    return LT.first * 4;
+
+  // A vector select is a masked move, which is often folded into the
+  // instruction that computes one of the operands.
+  if (Opcode == Instruction::Select)
+    return LT.first;
+
+  return BaseT::getCmpSelInstrCost(Opcode, ValTy, CondTy);
+}
+
+unsigned NyuziTTIImpl::getVectorInstrCost(unsigned Opcode, Type *Val,
+                                          unsigned Index) {
+  // Reading a lane is a single getlane instruction.  Writing one needs the
+  // lane mask in a register and a masked move.
+  if (Opcode == Instruction::ExtractElement)
+    return 1;
+
+  if (Opcode == Instruction::InsertElement)
+    return 2;
+
+  return BaseT::getVectorInstrCost(Opcode, Val, Index);
+}
+
+unsigned NyuziTTIImpl::getMemoryOpCost(unsigned Opcode, Type *Src,
+                                       unsigned Alignment,
+                                       unsigned AddressSpace) {
+  std::pair<unsigned, MVT> LT = TLI->getTypeLegalizationCost(Src);
+  if (!LT.second.isVector() || LT.second.getSizeInBits() != 512)
+    return BaseT::getMemoryOpCost(Opcode, Src, Alignment, AddressSpace);
+
+  // Block loads and stores require the address to be 64 byte aligned.
+  // NyuziTargetLowering turns accesses that are only element aligned (which
+  // is what the vectorizers usually produce) into a gather or scatter.
+  if (Alignment == 0 || Alignment >= 64)
+    return LT.first;
+
+  if (Alignment >= 4)
+    return LT.first * (kGatherScatterCost + 1);
+
+  // Anything less aligned is split into scalar accesses, each of which is
+  // taken apart one byte at a time.
+  bool IsLoad = Opcode == Instruction::Load;
+  return LT.first * (getLaneByLaneCost(Src, IsLoad, !IsLoad) +
+                     LT.second.getVectorNumElements() * 4);
+}
+
+unsigned NyuziTTIImpl::getIntrinsicInstrCost(Intrinsic::ID IID, Type *RetTy,
+                                             ArrayRef<Type *> Tys) {
+  unsigned ISD = 0;
+  switch (IID) {
+  case Intrinsic::sqrt: ISD = ISD::FSQRT; break;
+  case Intrinsic::sin: ISD = ISD::FSIN; break;
+  case Intrinsic::cos: ISD = ISD::FCOS; break;
+  case Intrinsic::exp: ISD = ISD::FEXP; break;
+  case Intrinsic::exp2: ISD = ISD::FEXP2; break;
+  case Intrinsic::log: ISD = ISD::FLOG; break;
+  case Intrinsic::log2: ISD = ISD::FLOG2; break;
+  case Intrinsic::log10: ISD = ISD::FLOG10; break;
+  case Intrinsic::pow: ISD = ISD::FPOW; break;
+  case Intrinsic::trunc: ISD = ISD::FTRUNC; break;
+  case Intrinsic::floor: ISD = ISD::FFLOOR; break;
+  case Intrinsic::ceil: ISD = ISD::FCEIL; break;
+  case Intrinsic::round: ISD = ISD::FROUND; break;
+  case Intrinsic::rint: ISD = ISD::FRINT; break;
+  case Intrinsic::nearbyint: ISD = ISD::FNEARBYINT; break;
+  case Intrinsic::ctpop: ISD = ISD::CTPOP; break;
+  case Intrinsic::bswap: ISD = ISD::BSWAP; break;
+  default: break;
+  }
+
+  if (ISD) {
+    std::pair<unsigned, MVT> LT = TLI->getTypeLegalizationCost(RetTy);
+    int Idx = CostTableLookup(NyuziCostTable, ISD, LT.second);
+    if (Idx != -1)
+      return LT.first * NyuziCostTable[Idx].Cost;
+  }
+
+  return BaseT::getIntrinsicInstrCost(IID, RetTy, Tys);
+}
+
+// A reduction of a 16 lane vector takes four shuffle and combine steps, then a
+// read of lane 0 (see LowerINTRINSIC_WO_CHAIN). Wider vectors are first
+// combined into one. The pairwise form, which the SLP vectorizer also
+// considers, needs general shuffles, so leave that to the default.
+unsigned NyuziTTIImpl::getReductionCost(unsigned Opcode, Type *Ty,
+                                        bool IsPairwise) {
+  std::pair<unsigned, MVT> LT = TLI->getTypeLegalizationCost(Ty);
+  if (IsPairwise || !LT.second.isVector() ||
+      LT.second.getVectorNumElements() != 16)
+    return BaseT::getReductionCost(Opcode, Ty, IsPairwise);
+
+  Type *LegalTy = VectorType::get(Ty->getVectorElementType(), 16);
+  unsigned OpCost = getArithmeticInstrCost(Opcode, LegalTy);
+  return (LT.first - 1) * OpCost + 4 * (kReductionStepCost + OpCost) +
+         getVectorInstrCost(Instruction::ExtractElement, LegalTy, 0);
+}
+
+// Consecutive masked accesses to full vectors are a masked block load/store or
+// a masked gather/scatter, depending on alignment (see LowerMLOAD).
+bool NyuziTTIImpl::isLegalMaskedLoad(Type *DataType, int Consecutive) {
+  if (Consecutive != 1 || !DataType->isVectorTy())
+    return false;
+
+  Type *ElemTy = DataType->getVectorElementType();
+  return DataType->getVectorNumElements() == 16 &&
+         (ElemTy->isIntegerTy(32) || ElemTy->isFloatTy());
+}
+
+bool NyuziTTIImpl::isLegalMaskedStore(Type *DataType, int Consecutive) {
+  return isLegalMaskedLoad(DataType, Consecutive);
+}
@@ -0,0 +1,100 @@
+//===-- NyuziTargetTransformInfo.h - Nyuzi specific TTI ---------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+/// \file
+/// This file defines a TargetTransformInfo::Concept conforming object specific
+/// to the Nyuzi target machine. It describes the 16 lane vector unit to the
+/// loop and SLP vectorizers, while letting the target independent and default
+/// TTI implementations handle the rest.
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_TARGET_NYUZI_NYUZITARGETTRANSFORMINFO_H
+#define LLVM_LIB_TARGET_NYUZI_NYUZITARGETTRANSFORMINFO_H
+
+#include "Nyuzi.h"
+#include "NyuziTargetMachine.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/CodeGen/BasicTTIImpl.h"
+#include "llvm/Target/TargetLowering.h"
+
+namespace llvm {
+
+class NyuziTTIImpl : public BasicTTIImplBase<NyuziTTIImpl> {
+  typedef BasicTTIImplBase<NyuziTTIImpl> BaseT;
+  typedef TargetTransformInfo TTI;
+  friend BaseT;
+
+  const NyuziSubtarget *ST;
+  const NyuziTargetLowering *TLI;
+
+  const NyuziSubtarget *getST() const { return ST; }
+  const NyuziTargetLowering *getTLI() const { return TLI; }
+
+  unsigned getLaneByLaneCost(Type *Ty, bool Insert, bool Extract);
+
+public:
+  explicit NyuziTTIImpl(const NyuziTargetMachine *TM)
+      : BaseT(TM), ST(TM->getSubtargetImpl()), TLI(ST->getTargetLowering()) {}
+
+  // Provide value semantics. MSVC requires that we spell all of these out.
+  NyuziTTIImpl(const NyuziTTIImpl &Arg)
+      : BaseT(static_cast<const BaseT &>(Arg)), ST(Arg.ST), TLI(Arg.TLI) {}
+  NyuziTTIImpl(NyuziTTIImpl &&Arg)
+      : BaseT(std::move(static_cast<BaseT &>(Arg))), ST(std::move(Arg.ST)),
+        TLI(std::move(Arg.TLI)) {}
+  NyuziTTIImpl &operator=(const NyuziTTIImpl &RHS) {
+    BaseT::operator=(static_cast<const BaseT &>(RHS));
+    ST = RHS.ST;
+    TLI = RHS.TLI;
+    return *this;
+  }
+  NyuziTTIImpl &operator=(NyuziTTIImpl &&RHS) {
+    BaseT::operator=(std::move(static_cast<BaseT &>(RHS)));
+    ST = std::move(RHS.ST);
+    TLI = std::move(RHS.TLI);
+    return *this;
+  }
+
+  /// \name Vector TTI Implementations
+  /// @{
+
+  // S0-S27 are allocatable (FP, SP, RA and PC are reserved).  All 32 vector
+  // registers are allocatable.
+  unsigned getNumberOfRegisters(bool Vector) { return Vector ? 32 : 28; }
+
+  unsigned getRegisterBitWidth(bool Vector) { return Vector ? 512 : 32; }
+
+  // Floating point operations have multi-cycle latency, but are fully
+  // pipelined, so interleaving two iterations helps hide it.
+  unsigned getMaxInterleaveFactor() { return 2; }
+
+  unsigned getArithmeticInstrCost(
+      unsigned Opcode, Type *Ty,
+      TTI::OperandValueKind Opd1Info = TTI::OK_AnyValue,
+      TTI::OperandValueKind Opd2Info = TTI::OK_AnyValue,
+      TTI::OperandValueProperties Opd1PropInfo = TTI::OP_None,
+      TTI::OperandValueProperties Opd2PropInfo = TTI::OP_None);
+  unsigned getShuffleCost(TTI::ShuffleKind Kind, Type *Tp, int Index,
+                          Type *SubTp);
+  unsigned getCmpSelInstrCost(unsigned Opcode, Type *ValTy, Type *CondTy);
+  unsigned getVectorInstrCost(unsigned Opcode, Type *Val, unsigned Index);
+  unsigned getMemoryOpCost(unsigned Opcode, Type *Src, unsigned Alignment,
+                           unsigned AddressSpace);
+  unsigned getIntrinsicInstrCost(Intrinsic::ID IID, Type *RetTy,
+                                 ArrayRef<Type *> Tys);
+  unsigned getReductionCost(unsigned Opcode, Type *Ty, bool IsPairwise);
+  bool isLegalMaskedLoad(Type *DataType, int Consecutive);
+  bool isLegalMaskedStore(Type *DataType, int Consecutive);
+
+  /// @}
+};
+
+} // end namespace llvm
+
+#endif
@@ -0,0 +1,65 @@
+; RUN: opt < %s -cost-model -analyze -mtriple=nyuzi-elf | FileCheck %s
+
+define void @arith(<16 x float> %a, <16 x float> %b, <16 x i32> %c, <16 x i32> %d, i32 %e, i32 %f) {
+  ; CHECK: cost of 1 {{.*}} fadd <16 x float>
+  %1 = fadd <16 x float> %a, %b
+  ; CHECK: cost of 1 {{.*}} fmul <16 x float>
+  %2 = fmul <16 x float> %a, %b
+  ; CHECK: cost of 8 {{.*}} fdiv <16 x float>
+  %3 = fdiv <16 x float> %a, %b
+  ; CHECK: cost of 1 {{.*}} mul <16 x i32>
+  %4 = mul <16 x i32> %c, %d
+  ; CHECK: cost of 36 {{.*}} sdiv i32
+  %5 = sdiv i32 %e, %f
+  ; CHECK: cost of 36 {{.*}} sdiv <16 x i32>
+  %6 = sdiv <16 x i32> %c, %d
+  ; CHECK: cost of 4 {{.*}} udiv <16 x i32>
+  %7 = udiv <16 x i32> %c, <i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7>
+  ret void
+}
+
+define void @memory(<16 x float>* %p) {
+  ; CHECK: cost of 1 {{.*}} load <16 x float>* %p, align 64
+  %1 = load <16 x float>* %p, align 64
+  ; CHECK: cost of 17 {{.*}} load <16 x float>* %p, align 4
+  %2 = load <16 x float>* %p, align 4
+  ; CHECK: cost of 17 {{.*}} store <16 x float> %2, <16 x float>* %p, align 4
+  store <16 x float> %2, <16 x float>* %p, align 4
+  ret void
+}
+
+define void @shuffle(<16 x float> %a, <16 x float> %b) {
+  ; CHECK: cost of 2 {{.*}} shufflevector
+  %1 = shufflevector <16 x float> %a, <16 x float> undef, <16 x i32> <i32 15, i32 14, i32 13, i32 12, i32 11, i32 10, i32 9, i32 8, i32 7, i32 6, i32 5, i32 4, i32 3, i32 2, i32 1, i32 0>
+  ; CHECK: cost of 2 {{.*}} shufflevector
+  %2 = shufflevector <16 x float> %a, <16 x float> %b, <16 x i32> <i32 0, i32 17, i32 2, i32 19, i32 4, i32 21, i32 6, i32 23, i32 8, i32 25, i32 10, i32 27, i32 12, i32 29, i32 14, i32 31>
+  ret void
+}
+
+declare <16 x float> @llvm.floor.v16f32(<16 x float>)
+declare float @llvm.floor.f32(float)
+
+define void @rounding(<16 x float> %a, float %b) {
+  ; CHECK: cost of 10 {{.*}} @llvm.floor.v16f32
+  %1 = call <16 x float> @llvm.floor.v16f32(<16 x float> %a)
+  ; CHECK: cost of 16 {{.*}} @llvm.floor.f32
+  %2 = call float @llvm.floor.f32(float %b)
+  ret void
+}
+
+declare <16 x i32> @llvm.ctpop.v16i32(<16 x i32>)
+declare i32 @llvm.ctpop.i32(i32)
+declare <16 x i32> @llvm.bswap.v16i32(<16 x i32>)
+declare i32 @llvm.bswap.i32(i32)
+
+define void @bits(<16 x i32> %a, i32 %b) {
+  ; CHECK: cost of 16 {{.*}} @llvm.ctpop.v16i32
+  %1 = call <16 x i32> @llvm.ctpop.v16i32(<16 x i32> %a)
+  ; CHECK: cost of 16 {{.*}} @llvm.ctpop.i32
+  %2 = call i32 @llvm.ctpop.i32(i32 %b)
+  ; CHECK: cost of 10 {{.*}} @llvm.bswap.v16i32
+  %3 = call <16 x i32> @llvm.bswap.v16i32(<16 x i32> %a)
+  ; CHECK: cost of 10 {{.*}} @llvm.bswap.i32
+  %4 = call i32 @llvm.bswap.i32(i32 %b)
+  ret void
+}
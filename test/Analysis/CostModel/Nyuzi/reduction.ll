@@ -0,0 +1,16 @@
+; RUN: opt < %s -cost-model -costmodel-reduxcost=true -analyze -mtriple=nyuzi-elf | FileCheck %s
+
+; A reduction is four shuffle and combine steps and a lane read.
+define i32 @reduce_add(<16 x i32> %a) {
+  %r8 = shufflevector <16 x i32> %a, <16 x i32> undef, <16 x i32> <i32 8, i32 9, i32 10, i32 11, i32 12, i32 13, i32 14, i32 15, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef>
+  %s8 = add <16 x i32> %a, %r8
+  %r4 = shufflevector <16 x i32> %s8, <16 x i32> undef, <16 x i32> <i32 4, i32 5, i32 6, i32 7, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef>
+  %s4 = add <16 x i32> %s8, %r4
+  %r2 = shufflevector <16 x i32> %s4, <16 x i32> undef, <16 x i32> <i32 2, i32 3, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef>
+  %s2 = add <16 x i32> %s4, %r2
+  %r1 = shufflevector <16 x i32> %s2, <16 x i32> undef, <16 x i32> <i32 1, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef>
+  %s1 = add <16 x i32> %s2, %r1
+  ; CHECK: cost of 13 {{.*}} extractelement
+  %res = extractelement <16 x i32> %s1, i32 0
+  ret i32 %res
+}
@@ -0,0 +1,102 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+; Loop strength reduction should use a pointer induction variable and fold
+; the constant part of each index into the memory offset.
+define i32 @fold_offsets(i32* %a, i32 %n) { ; CHECK-LABEL: fold_offsets:
+entry:
+	br label %loop
+
+; CHECK: [[LOOP:\.LBB[0-9_]+]]:
+; CHECK-NOT: shl
+; CHECK: load_32 s{{[0-9]+}}, -16([[PTR:s[0-9]+]])
+; CHECK: load_32 s{{[0-9]+}}, ([[PTR]])
+; CHECK: add_i [[PTR]], [[PTR]], 4
+; CHECK: btrue s{{[0-9]+}}, [[LOOP]]
+
+loop:
+	%i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+	%sum = phi i32 [ 0, %entry ], [ %sum.next, %loop ]
+	%idx1 = add i32 %i, 3
+	%p1 = getelementptr i32* %a, i32 %idx1
+	%v1 = load i32* %p1
+	%idx2 = add i32 %i, 7
+	%p2 = getelementptr i32* %a, i32 %idx2
+	%v2 = load i32* %p2
+	%s = add i32 %v1, %v2
+	%sum.next = add i32 %sum, %s
+	%i.next = add i32 %i, 1
+	%cmp = icmp slt i32 %i.next, %n
+	br i1 %cmp, label %loop, label %exit
+
+exit:
+	ret i32 %sum.next
+}
+
+define void @block_offsets(<16 x i32>* %dst, <16 x i32>* %src, i32 %n) { ; CHECK-LABEL: block_offsets:
+entry:
+	br label %loop
+
+; CHECK: [[LOOP:\.LBB[0-9_]+]]:
+; CHECK-NOT: shl
+; CHECK-DAG: store_v [[VAL:v[0-9]+]], -64([[DST:s[0-9]+]])
+; CHECK-DAG: store_v [[VAL]], ([[DST]])
+; CHECK: add_i [[DST]], [[DST]], 128
+; CHECK: btrue s{{[0-9]+}}, [[LOOP]]
+
+loop:
+	%i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+	%s1 = getelementptr <16 x i32>* %src, i32 %i
+	%v = load <16 x i32>* %s1
+	%d1 = getelementptr <16 x i32>* %dst, i32 %i
+	%i2 = add i32 %i, 1
+	%d2 = getelementptr <16 x i32>* %dst, i32 %i2
+	store <16 x i32> %v, <16 x i32>* %d1
+	store <16 x i32> %v, <16 x i32>* %d2
+	%i.next = add i32 %i, 2
+	%cmp = icmp slt i32 %i.next, %n
+	br i1 %cmp, label %loop, label %exit
+
+exit:
+	ret void
+}
+
+declare <16 x i32> @llvm.nyuzi.__builtin_nyuzi_block_loadi_masked(<16 x i32>*, i32)
+
+; Masked memory instructions only have a 10 bit offset field.
+define <16 x i32> @masked_offsets(<16 x i32>* %p, i32 %mask) { ; CHECK-LABEL: masked_offsets:
+	%p1 = getelementptr <16 x i32>* %p, i32 4
+	%v1 = call <16 x i32> @llvm.nyuzi.__builtin_nyuzi_block_loadi_masked(<16 x i32>* %p1, i32 %mask)
+	%p2 = getelementptr <16 x i32>* %p, i32 16
+	%v2 = call <16 x i32> @llvm.nyuzi.__builtin_nyuzi_block_loadi_masked(<16 x i32>* %p2, i32 %mask)
+	%sum = add <16 x i32> %v1, %v2
+
+; CHECK-DAG: load_v_mask v{{[0-9]+}}, s1, 256(s0)
+; CHECK-DAG: add_i [[PTR:s[0-9]+]], s0, 1024
+; CHECK-DAG: load_v_mask v{{[0-9]+}}, s1, ([[PTR]])
+
+	ret <16 x i32> %sum
+}
+
+declare void @llvm.nyuzi.__builtin_nyuzi_block_storei_masked(<16 x i32>*, <16 x i32>, i32)
+declare void @use(i8*)
+
+; The same applies to stack objects, whose offsets are only known after frame
+; layout.
+define void @masked_frame_offsets(i32 %mask) { ; CHECK-LABEL: masked_frame_offsets:
+	%vec = alloca <16 x i32>, align 64
+	%buf = alloca [1024 x i8], align 64
+	%bufptr = bitcast [1024 x i8]* %buf to i8*
+	call void @use(i8* %bufptr)
+	%vecptr = bitcast <16 x i32>* %vec to i8*
+	call void @use(i8* %vecptr)
+	%v = call <16 x i32> @llvm.nyuzi.__builtin_nyuzi_block_loadi_masked(<16 x i32>* %vec, i32 %mask)
+	call void @llvm.nyuzi.__builtin_nyuzi_block_storei_masked(<16 x i32>* %vec, <16 x i32> %v, i32 %mask)
+
+; CHECK: lea s0, 1024(sp)
+; CHECK: add_i [[PTR1:s[0-9]+]], sp, 1024
+; CHECK: add_i [[PTR2:s[0-9]+]], sp, 1024
+; CHECK: load_v_mask v{{[0-9]+}}, s{{[0-9]+}}, ([[PTR1]])
+; CHECK: store_v_mask v{{[0-9]+}}, s{{[0-9]+}}, ([[PTR2]])
+
+	ret void
+}
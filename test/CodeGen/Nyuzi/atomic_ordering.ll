@@ -0,0 +1,116 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+target triple = "nyuzi"
+
+define i32 @load_monotonic(i32* %ptr) { ; CHECK-LABEL: load_monotonic:
+  %tmp = load atomic i32* %ptr monotonic, align 4
+
+; CHECK-NOT: membar
+; CHECK: load_32 s0, (s0)
+; CHECK-NOT: membar
+; CHECK: ret
+
+  ret i32 %tmp
+}
+
+define i32 @load_acquire(i32* %ptr) { ; CHECK-LABEL: load_acquire:
+  %tmp = load atomic i32* %ptr acquire, align 4
+
+; CHECK-NOT: membar
+; CHECK: load_32 s0, (s0)
+; CHECK-NEXT: membar
+; CHECK: ret
+
+  ret i32 %tmp
+}
+
+define i32 @load_u8(i8* %ptr) { ; CHECK-LABEL: load_u8:
+  %tmp = load atomic i8* %ptr monotonic, align 1
+  %ext = zext i8 %tmp to i32
+
+; CHECK: load_u8 s0, (s0)
+
+  ret i32 %ext
+}
+
+define void @store_monotonic(i32* %ptr, i32 %value) { ; CHECK-LABEL: store_monotonic:
+  store atomic i32 %value, i32* %ptr monotonic, align 4
+
+; CHECK-NOT: membar
+; CHECK: store_32 s1, (s0)
+; CHECK-NOT: membar
+; CHECK: ret
+
+  ret void
+}
+
+define void @store_release(i32* %ptr, i32 %value) { ; CHECK-LABEL: store_release:
+  store atomic i32 %value, i32* %ptr release, align 4
+
+; CHECK: membar
+; CHECK-NEXT: store_32 s1, (s0)
+; CHECK-NOT: membar
+; CHECK: ret
+
+  ret void
+}
+
+define void @store_seq_cst(i32* %ptr, i32 %value) { ; CHECK-LABEL: store_seq_cst:
+  store atomic i32 %value, i32* %ptr seq_cst, align 4
+
+; CHECK: membar
+; CHECK-NEXT: store_32 s1, (s0)
+; CHECK-NEXT: membar
+
+  ret void
+}
+
+define i32 @add_monotonic(i32* %ptr, i32 %value) { ; CHECK-LABEL: add_monotonic:
+  %tmp = atomicrmw add i32* %ptr, i32 %value monotonic
+
+; CHECK-NOT: membar
+; CHECK: load_sync
+; CHECK: store_sync
+; CHECK-NOT: membar
+; CHECK: ret
+
+  ret i32 %tmp
+}
+
+define i32 @add_seq_cst(i32* %ptr, i32 %value) { ; CHECK-LABEL: add_seq_cst:
+  %tmp = atomicrmw add i32* %ptr, i32 %value seq_cst
+
+; CHECK: membar
+; CHECK: load_sync
+; CHECK: store_sync
+; CHECK: membar
+; CHECK: ret
+
+  ret i32 %tmp
+}
+
+; The trailing fence of the first operation and the leading fence of the
+; second are merged.
+define void @merge_fences(i32* %ptr1, i32* %ptr2, i32 %value) { ; CHECK-LABEL: merge_fences:
+  store atomic i32 %value, i32* %ptr1 seq_cst, align 4
+  store atomic i32 %value, i32* %ptr2 seq_cst, align 4
+
+; CHECK: membar
+; CHECK-NEXT: store_32 s2, (s0)
+; CHECK-NEXT: membar
+; CHECK-NEXT: store_32 s2, (s1)
+; CHECK-NEXT: membar
+
+  ret void
+}
+
+define void @fence_merge(i32* %ptr, i32 %value) { ; CHECK-LABEL: fence_merge:
+  fence seq_cst
+  fence seq_cst
+
+; CHECK: membar
+; CHECK-NOT: membar
+; CHECK: ret
+
+  ret void
+}
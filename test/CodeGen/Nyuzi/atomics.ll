@@ -165,3 +165,97 @@ define { i32, i1 } @atomic_cmpxchg(i32* %ptr, i32 %cmp, i32 %newvalue) { ; CHECK
 
 	ret { i32, i1 } %tmp
 }
+
+define i32 @atomic_nand_reg(i32* %ptr, i32 %value) { ; CHECK: atomic_nand_reg:
+	%tmp = atomicrmw volatile nand i32* %ptr, i32 %value monotonic
+
+; CHECK: load_sync s{{[0-9]+}}, (s0)
+; CHECK: and [[ANDRES:s[0-9]+]], s{{[0-9]+}}, s1
+; CHECK: xor [[NANDRES:s[0-9]+]], [[ANDRES]], -1
+; CHECK: store_sync [[NANDRES]], (s0)
+; CHECK: bfalse s{{[0-9]+}},
+
+	ret i32 %tmp
+}
+
+define i32 @atomic_nand_imm(i32* %ptr) { ; CHECK: atomic_nand_imm:
+	%tmp = atomicrmw volatile nand i32* %ptr, i32 13 monotonic
+
+; CHECK: and [[ANDRES:s[0-9]+]], s{{[0-9]+}}, 13
+; CHECK: xor s{{[0-9]+}}, [[ANDRES]], -1
+
+	ret i32 %tmp
+}
+
+; If the value in memory is already the minimum, don't store anything.
+define i32 @atomic_min_reg(i32* %ptr, i32 %value) { ; CHECK: atomic_min_reg:
+	%tmp = atomicrmw volatile min i32* %ptr, i32 %value monotonic
+
+; CHECK: [[LOOP:\.LBB[0-9_]+]]:
+; CHECK: load_sync [[OLD:s[0-9]+]], (s0)
+; CHECK: cmple_i [[KEEP:s[0-9]+]], [[OLD]], s1
+; CHECK: btrue [[KEEP]],
+; CHECK: store_sync s{{[0-9]+}}, (s0)
+; CHECK: bfalse s{{[0-9]+}}, [[LOOP]]
+
+	ret i32 %tmp
+}
+
+define i32 @atomic_max_imm(i32* %ptr) { ; CHECK: atomic_max_imm:
+	%tmp = atomicrmw volatile max i32* %ptr, i32 13 monotonic
+
+; CHECK: load_sync [[OLD:s[0-9]+]], (s0)
+; CHECK: cmpge_i [[KEEP:s[0-9]+]], [[OLD]], 13
+; CHECK: btrue [[KEEP]],
+; CHECK: move [[NEW:s[0-9]+]], 13
+; CHECK: store_sync [[NEW]], (s0)
+
+	ret i32 %tmp
+}
+
+define i32 @atomic_umin_reg(i32* %ptr, i32 %value) { ; CHECK: atomic_umin_reg:
+	%tmp = atomicrmw volatile umin i32* %ptr, i32 %value monotonic
+
+; CHECK: cmple_u s{{[0-9]+}}, s{{[0-9]+}}, s1
+
+	ret i32 %tmp
+}
+
+define i32 @atomic_umax_reg(i32* %ptr, i32 %value) { ; CHECK: atomic_umax_reg:
+	%tmp = atomicrmw volatile umax i32* %ptr, i32 %value monotonic
+
+; CHECK: cmpge_u s{{[0-9]+}}, s{{[0-9]+}}, s1
+
+	ret i32 %tmp
+}
+
+declare <16 x i32> @llvm.nyuzi.__builtin_nyuzi_scatter_atomic_addi(<16 x i32>, <16 x i32>)
+declare <16 x i32> @llvm.nyuzi.__builtin_nyuzi_scatter_atomic_addi_masked(<16 x i32>, <16 x i32>, i32)
+
+define <16 x i32> @scatter_atomic_add(<16 x i32> %ptrs, <16 x i32> %values) { ; CHECK: scatter_atomic_add:
+	%tmp = call <16 x i32> @llvm.nyuzi.__builtin_nyuzi_scatter_atomic_addi(<16 x i32> %ptrs, <16 x i32> %values)
+
+; CHECK: getlane [[PTR:s[0-9]+]], v0, [[LANE:s[0-9]+]]
+; CHECK: getlane [[AMT:s[0-9]+]], v1, [[LANE]]
+; CHECK: [[RETRY:\.LBB[0-9_]+]]:
+; CHECK: load_sync [[OLD:s[0-9]+]], ([[PTR]])
+; CHECK: add_i s{{[0-9]+}}, [[OLD]], [[AMT]]
+; CHECK: store_sync s{{[0-9]+}}, ([[PTR]])
+; CHECK: bfalse s{{[0-9]+}}, [[RETRY]]
+; CHECK: move_mask v{{[0-9]+}}, s{{[0-9]+}}, [[OLD]]
+; CHECK: btrue
+
+	ret <16 x i32> %tmp
+}
+
+define <16 x i32> @scatter_atomic_add_masked(<16 x i32> %ptrs, <16 x i32> %values, i32 %mask) { ; CHECK: scatter_atomic_add_masked:
+	%tmp = call <16 x i32> @llvm.nyuzi.__builtin_nyuzi_scatter_atomic_addi_masked(<16 x i32> %ptrs, <16 x i32> %values, i32 %mask)
+
+; CHECK: and [[ENABLED:s[0-9]+]], s{{[0-9]+}}, s0
+; CHECK: bfalse [[ENABLED]],
+; CHECK: load_sync
+; CHECK: store_sync
+; CHECK: move_mask v{{[0-9]+}}, [[ENABLED]], s{{[0-9]+}}
+
+	ret <16 x i32> %tmp
+}
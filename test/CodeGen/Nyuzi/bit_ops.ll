@@ -0,0 +1,93 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+target triple = "nyuzi"
+
+; Population count, byte swap and rotates are built from shifts and masks.
+; Vector forms use the same sequences as scalars rather than being split
+; into lanes.
+
+declare i32 @llvm.ctpop.i32(i32)
+declare <16 x i32> @llvm.ctpop.v16i32(<16 x i32>)
+declare i32 @llvm.bswap.i32(i32)
+declare <16 x i32> @llvm.bswap.v16i32(<16 x i32>)
+
+define i32 @ctpop(i32 %a) { ; CHECK-LABEL: ctpop:
+  %r = call i32 @llvm.ctpop.i32(i32 %a)
+
+  ; CHECK: shr {{s[0-9]+}}, s0, 1
+  ; CHECK: sub_i
+  ; CHECK: shr {{s[0-9]+}}, {{s[0-9]+}}, 2
+  ; CHECK: shr {{s[0-9]+}}, {{s[0-9]+}}, 4
+  ; CHECK: mull_i
+  ; CHECK: shr s0, {{s[0-9]+}}, 24
+  ; CHECK-NEXT: ret
+  ret i32 %r
+}
+
+define <16 x i32> @vctpop(<16 x i32> %a) { ; CHECK-LABEL: vctpop:
+  %r = call <16 x i32> @llvm.ctpop.v16i32(<16 x i32> %a)
+
+  ; CHECK: shr {{v[0-9]+}}, v0, 1
+  ; CHECK: sub_i
+  ; CHECK: shr {{v[0-9]+}}, {{v[0-9]+}}, 2
+  ; CHECK: shr {{v[0-9]+}}, {{v[0-9]+}}, 4
+  ; CHECK: mull_i
+  ; CHECK: shr v0, {{v[0-9]+}}, 24
+  ; CHECK-NOT: getlane
+  ; CHECK: ret
+  ret <16 x i32> %r
+}
+
+define i32 @bswap(i32 %a) { ; CHECK-LABEL: bswap:
+  %r = call i32 @llvm.bswap.i32(i32 %a)
+
+  ; CHECK: shr {{s[0-9]+}}, s0, 8
+  ; CHECK: shl [[LOW:s[0-9]+]], {{s[0-9]+}}, 8
+  ; CHECK: or [[HALVES:s[0-9]+]], [[LOW]]
+  ; CHECK-DAG: shr [[TOP:s[0-9]+]], [[HALVES]], 16
+  ; CHECK-DAG: shl [[BOTTOM:s[0-9]+]], [[HALVES]], 16
+  ; CHECK: or s0
+  ; CHECK-NEXT: ret
+  ret i32 %r
+}
+
+define <16 x i32> @vbswap(<16 x i32> %a) { ; CHECK-LABEL: vbswap:
+  %r = call <16 x i32> @llvm.bswap.v16i32(<16 x i32> %a)
+
+  ; CHECK: shr {{v[0-9]+}}, v0, 8
+  ; CHECK: shl [[LOW:v[0-9]+]], {{v[0-9]+}}, 8
+  ; CHECK: or [[HALVES:v[0-9]+]], [[LOW]]
+  ; CHECK-DAG: shr [[TOP:v[0-9]+]], [[HALVES]], 16
+  ; CHECK-DAG: shl [[BOTTOM:v[0-9]+]], [[HALVES]], 16
+  ; CHECK: or v0
+  ; CHECK-NOT: getlane
+  ; CHECK: ret
+  ret <16 x i32> %r
+}
+
+define <16 x i32> @vrotl(<16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: vrotl:
+  %s = sub <16 x i32> <i32 32, i32 32, i32 32, i32 32, i32 32, i32 32, i32 32, i32 32, i32 32, i32 32, i32 32, i32 32, i32 32, i32 32, i32 32, i32 32>, %b
+  %x = shl <16 x i32> %a, %b
+  %y = lshr <16 x i32> %a, %s
+  %r = or <16 x i32> %x, %y
+
+  ; CHECK: sub_i [[INVAMT:v[0-9]+]], {{v[0-9]+}}, v1
+  ; CHECK-DAG: shl [[HIGH:v[0-9]+]], v0, v1
+  ; CHECK-DAG: shr [[LOW:v[0-9]+]], v0, [[INVAMT]]
+  ; CHECK: or v0
+  ; CHECK-NOT: getlane
+  ; CHECK: ret
+  ret <16 x i32> %r
+}
+
+define i32 @rotr(i32 %a) { ; CHECK-LABEL: rotr:
+  %x = lshr i32 %a, 7
+  %y = shl i32 %a, 25
+  %r = or i32 %x, %y
+
+  ; CHECK-DAG: shr [[LOW:s[0-9]+]], s0, 7
+  ; CHECK-DAG: shl [[HIGH:s[0-9]+]], s0, 25
+  ; CHECK: or s0
+  ; CHECK-NEXT: ret
+  ret i32 %r
+}
@@ -0,0 +1,49 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+target triple = "nyuzi"
+
+; Constant vectors with many distinct values come from the constant pool.
+define <16 x i32> @constant_vector() { ; CHECK: constant_vector:
+	; CHECK: load_v v0, {{.*}}.LCPI
+	; CHECK-NOT: store
+	ret <16 x i32> <i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7, i32 8, i32 9, i32 10, i32 11, i32 12, i32 13, i32 14, i32 15>
+}
+
+define <16 x float> @constant_fvector() { ; CHECK: constant_fvector:
+	; CHECK: load_v v0, {{.*}}.LCPI
+	; CHECK-NOT: store
+	ret <16 x float> <float 1.0, float 2.0, float 3.0, float 4.0, float 5.0, float 6.0, float 7.0, float 8.0, float 9.0, float 10.0, float 11.0, float 12.0, float 13.0, float 14.0, float 15.0, float 16.0>
+}
+
+; Mostly uniform vectors are a splat and masked moves.
+define <16 x i32> @mostly_uniform() { ; CHECK: mostly_uniform:
+	; CHECK-DAG: move v0, 7
+	; CHECK-DAG: move [[MASK:s[0-9]+]], 1
+	; CHECK: move_mask v0, [[MASK]], 9
+	; CHECK-NOT: load_v
+	ret <16 x i32> <i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 7, i32 9>
+}
+
+define <16 x i32> @two_values(i32 %a, i32 %b) { ; CHECK: two_values:
+	%v0 = insertelement <16 x i32> undef, i32 %a, i32 0
+	%v1 = insertelement <16 x i32> %v0, i32 %a, i32 1
+	%v2 = insertelement <16 x i32> %v1, i32 %a, i32 2
+	%v3 = insertelement <16 x i32> %v2, i32 %a, i32 3
+	%v4 = insertelement <16 x i32> %v3, i32 %a, i32 4
+	%v5 = insertelement <16 x i32> %v4, i32 %a, i32 5
+	%v6 = insertelement <16 x i32> %v5, i32 %a, i32 6
+	%v7 = insertelement <16 x i32> %v6, i32 %a, i32 7
+	%v8 = insertelement <16 x i32> %v7, i32 %b, i32 8
+	%v9 = insertelement <16 x i32> %v8, i32 %b, i32 9
+	%v10 = insertelement <16 x i32> %v9, i32 %b, i32 10
+	%v11 = insertelement <16 x i32> %v10, i32 %b, i32 11
+	%v12 = insertelement <16 x i32> %v11, i32 %b, i32 12
+	%v13 = insertelement <16 x i32> %v12, i32 %b, i32 13
+	%v14 = insertelement <16 x i32> %v13, i32 %b, i32 14
+	%v15 = insertelement <16 x i32> %v14, i32 %b, i32 15
+	; CHECK: move v0, s0
+	; CHECK: move [[MASK:s[0-9]+]], 255
+	; CHECK: move_mask v0, [[MASK]], s1
+	; CHECK-NOT: store
+	ret <16 x i32> %v15
+}
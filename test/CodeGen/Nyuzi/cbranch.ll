@@ -1,8 +1,9 @@
-; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+; RUN: llc -mtriple nyuzi-elf -disable-early-ifcvt %s -o - | FileCheck %s
 
 target triple = "nyuzi"
 
-; Do a scalar comparison and branch on the result.
+; Do a scalar comparison and branch on the result. Early if-conversion would
+; turn this into a select (see select.ll).
 define i32 @max(i32 %a, i32 %b) #0 {
 entry:
   %cmp = icmp sgt i32 %a, %b
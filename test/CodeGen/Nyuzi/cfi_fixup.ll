@@ -0,0 +1,39 @@
+; RUN: llc -mtriple nyuzi-elf -print-machineinstrs %s -o /dev/null 2>&1 | FileCheck %s
+
+target triple = "nyuzi"
+
+declare i32 @work(i32)
+
+; The likely return is laid out before the rest of the function, which still
+; uses the frame that its epilogue tears down. The frame state (the saved
+; return address and the CFA offset) is described again at the start of the
+; next block.
+define i32 @return_then_frame(i32 %a) {
+entry:
+  %v = call i32 @work(i32 %a)
+  %c = icmp sgt i32 %v, 0
+  br i1 %c, label %pos, label %neg, !prof !0
+
+pos:
+  ret i32 %v
+
+neg:
+  %w = call i32 @work(i32 %v)
+  %x = call i32 @work(i32 %w)
+  ret i32 %x
+}
+
+; CHECK: # After Nyuzi CFI fixup:
+; CHECK: derived from LLVM BB %pos
+; CHECK: %RA_REG<def> = LW
+; CHECK-NEXT: CFI_INSTRUCTION
+; CHECK-NEXT: ADDISSI %SP_REG, 64
+; CHECK-NEXT: CFI_INSTRUCTION
+; CHECK-NEXT: RET
+; CHECK: derived from LLVM BB %neg
+; CHECK: Predecessors according to CFG
+; CHECK-NEXT: CFI_INSTRUCTION
+; CHECK-NEXT: CFI_INSTRUCTION
+; CHECK-NEXT: CALLSYM
+
+!0 = !{!"branch_weights", i32 100, i32 1}
@@ -0,0 +1,102 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+target triple = "nyuzi"
+
+; Short hammocks are if-converted into a mask and xor/and/xor select.
+
+; A clamp inside a loop.
+define void @clamp_loop(i32* %p, i32 %n, i32 %limit) { ; CHECK-LABEL: clamp_loop:
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %store ]
+  %addr = getelementptr i32* %p, i32 %i
+  %val = load i32* %addr
+  %cmp = icmp sgt i32 %val, %limit
+  br i1 %cmp, label %clamp, label %store
+
+; CHECK: cmp{{gt|le}}_i [[PRED:s[0-9]+]]
+; CHECK-NOT: b{{true|false}}
+; CHECK: shl [[SHIFTED:s[0-9]+]], [[PRED]], 31
+; CHECK: ashr [[MASK:s[0-9]+]], [[SHIFTED]], 31
+; CHECK: and {{s[0-9]+}}, {{s[0-9]+}}, [[MASK]]
+; CHECK: xor
+; CHECK: store_32
+
+clamp:
+  br label %store
+
+store:
+  %res = phi i32 [ %limit, %clamp ], [ %val, %loop ]
+  store i32 %res, i32* %addr
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+; Converting this would execute more than a mispredicted branch costs.
+define i32 @diamond(i32 %a, i32 %b, i32 %c) { ; CHECK-LABEL: diamond:
+entry:
+  %cmp = icmp sgt i32 %a, %b
+  br i1 %cmp, label %then, label %else
+
+; CHECK: b{{true|false}}
+
+then:
+  %t1 = mul i32 %a, %c
+  %t2 = add i32 %t1, %b
+  %t3 = mul i32 %t2, %a
+  br label %done
+
+else:
+  %e1 = mul i32 %b, %c
+  %e2 = sub i32 %e1, %a
+  %e3 = mul i32 %e2, %b
+  br label %done
+
+done:
+  %res = phi i32 [ %t3, %then ], [ %e3, %else ]
+  ret i32 %res
+}
+
+; Selects of 0 and -1 fold into the mask.
+define i32 @sext_compare(i32 %a, i32 %b) { ; CHECK-LABEL: sext_compare:
+  %cmp = icmp sgt i32 %a, %b
+  %res = sext i1 %cmp to i32
+
+; CHECK: cmpgt_i [[PRED:s[0-9]+]], s0, s1
+; CHECK-NEXT: shl [[SHIFTED:s[0-9]+]], [[PRED]], 31
+; CHECK-NEXT: ashr s0, [[SHIFTED]], 31
+; CHECK-NEXT: ret
+
+  ret i32 %res
+}
+
+define i32 @select_zero_true(i32 %a, i32 %b) { ; CHECK-LABEL: select_zero_true:
+  %cmp = icmp sgt i32 %a, %b
+  %res = select i1 %cmp, i32 0, i32 %a
+
+; CHECK: cmpgt_i [[PRED:s[0-9]+]], s0, s1
+; CHECK-NEXT: add_i [[INVMASK:s[0-9]+]], [[PRED]], -1
+; CHECK-NEXT: and s0, s0, [[INVMASK]]
+; CHECK-NEXT: ret
+
+  ret i32 %res
+}
+
+define i32 @select_ones_true(i32 %a, i32 %b) { ; CHECK-LABEL: select_ones_true:
+  %cmp = icmp sgt i32 %a, %b
+  %res = select i1 %cmp, i32 -1, i32 %a
+
+; CHECK: cmpgt_i [[PRED:s[0-9]+]], s0, s1
+; CHECK-NEXT: shl [[SHIFTED:s[0-9]+]], [[PRED]], 31
+; CHECK-NEXT: ashr [[MASK:s[0-9]+]], [[SHIFTED]], 31
+; CHECK-NEXT: or s0, s0, [[MASK]]
+; CHECK-NEXT: ret
+
+  ret i32 %res
+}
@@ -0,0 +1,56 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+; Internal functions get the fast calling convention, which passes more
+; arguments in registers and doesn't preserve vector registers.
+
+define fastcc <16 x i32> @callee(i32 %a0, i32 %a1, i32 %a2, i32 %a3, i32 %a4, i32 %a5, i32 %a6, i32 %a7, i32 %a8, i32 %a9, <16 x i32> %v0, <16 x i32> %v1, <16 x i32> %v2, <16 x i32> %v3, <16 x i32> %v4, <16 x i32> %v5, <16 x i32> %v6, <16 x i32> %v7, <16 x i32> %v8) { ; CHECK-LABEL: callee:
+  %r = add <16 x i32> %v0, %v8
+  call void asm sideeffect "", "~{v26},~{v27}"()
+
+; CHECK-NOT: store_v
+; CHECK: add_i v0, v0, v8
+; CHECK-NOT: load_v
+
+  ret <16 x i32> %r
+}
+
+define fastcc { <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32> } @return_many(<16 x i32> %v) { ; CHECK-LABEL: return_many:
+  %r0 = insertvalue { <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32> } undef, <16 x i32> %v, 0
+  %r1 = insertvalue { <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32> } %r0, <16 x i32> %v, 7
+
+; CHECK: move v7, v0
+; CHECK-NEXT: ret
+
+  ret { <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32>, <16 x i32> } %r1
+}
+
+define <16 x i32> @caller(<16 x i32> %v) { ; CHECK-LABEL: caller:
+  %r = call fastcc <16 x i32> @callee(i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7, i32 8, i32 9, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v)
+
+; CHECK-DAG: move s9, 9
+; CHECK-DAG: move v8, v0
+; CHECK: call callee
+
+  %q = add <16 x i32> %r, %v
+  ret <16 x i32> %q
+}
+
+; A function using the standard convention must preserve v26-v31 for its
+; caller, so it can't tail call a function that doesn't.
+define <16 x i32> @no_tail_call(<16 x i32> %v) { ; CHECK-LABEL: no_tail_call:
+  %r = tail call fastcc <16 x i32> @callee(i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7, i32 8, i32 9, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v)
+
+; CHECK: call callee
+; CHECK: ret
+
+  ret <16 x i32> %r
+}
+
+define fastcc <16 x i32> @tail_call(<16 x i32> %v) { ; CHECK-LABEL: tail_call:
+  %r = tail call fastcc <16 x i32> @callee(i32 0, i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7, i32 8, i32 9, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v, <16 x i32> %v)
+
+; CHECK-NOT: call callee
+; CHECK: goto callee
+
+  ret <16 x i32> %r
+}
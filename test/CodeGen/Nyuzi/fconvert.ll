@@ -17,4 +17,88 @@ entry:
 ; CHECK: itof [[DEST1:s[0-9]+]], s{{[0-9]}}
 ; CHECK: ftoi s{{[0-9]+}}, [[DEST1]]
 
-; XXX do this with vectors too...
+; Unsigned conversions adjust the signed conversion with a mask, rather than
+; selecting between two results.
+define float @utof(i32 %a) { ; CHECK-LABEL: utof:
+  %r = uitofp i32 %a to float
+
+  ; CHECK: itof [[CONV:s[0-9]+]], s0
+  ; CHECK: ashr [[NEG:s[0-9]+]], s0, 31
+  ; CHECK: and [[ADJ:s[0-9]+]], [[NEG]]
+  ; CHECK: add_f s0, [[CONV]], [[ADJ]]
+  ; CHECK-NOT: b{{true|false}}
+  ; CHECK: ret
+  ret float %r
+}
+
+define i32 @ftou(float %a) { ; CHECK-LABEL: ftou:
+  %r = fptoui float %a to i32
+
+  ; CHECK: cmpge_f [[LARGE:s[0-9]+]], s0
+  ; CHECK: sub_f
+  ; CHECK: ftoi
+  ; CHECK: xor s0
+  ; CHECK-NOT: b{{true|false}}
+  ; CHECK: ret
+  ret i32 %r
+}
+
+define <16 x float> @vutof(<16 x i32> %a) { ; CHECK-LABEL: vutof:
+  %r = uitofp <16 x i32> %a to <16 x float>
+
+  ; CHECK: itof [[CONV:v[0-9]+]], v0
+  ; CHECK: ashr [[NEG:v[0-9]+]], v0, 31
+  ; CHECK: and [[ADJ:v[0-9]+]], [[NEG]]
+  ; CHECK: add_f v0, [[CONV]], [[ADJ]]
+  ; CHECK-NOT: getlane
+  ; CHECK: ret
+  ret <16 x float> %r
+}
+
+define <16 x i32> @vftou(<16 x float> %a) { ; CHECK-LABEL: vftou:
+  %r = fptoui <16 x float> %a to <16 x i32>
+
+  ; CHECK: cmpge_f [[LARGE:s[0-9]+]], v0
+  ; CHECK: sub_f_mask {{v[0-9]+}}, [[LARGE]]
+  ; CHECK: ftoi
+  ; CHECK: xor_mask v0, [[LARGE]]
+  ; CHECK-NOT: getlane
+  ; CHECK: ret
+  ret <16 x i32> %r
+}
+
+; The result of the unsigned conversion is an integer vector, and must be
+; usable as one.
+define <16 x i32> @vftou_compare(<16 x float> %a, <16 x i32> %b) { ; CHECK-LABEL: vftou_compare:
+  %conv = fptoui <16 x float> %a to <16 x i32>
+  %cmp = icmp ugt <16 x i32> %conv, %b
+  %r = select <16 x i1> %cmp, <16 x i32> %conv, <16 x i32> %b
+
+  ; CHECK: ftoi
+  ; CHECK: xor_mask [[CONV:v[0-9]+]]
+  ; CHECK: cmpgt_u {{s[0-9]+}}, [[CONV]], v1
+  ; CHECK-NOT: cmpgt_f
+  ; CHECK: ret
+  ret <16 x i32> %r
+}
+
+define <16 x float> @vftou_utof(<16 x float> %a) { ; CHECK-LABEL: vftou_utof:
+  %conv = fptoui <16 x float> %a to <16 x i32>
+  %r = uitofp <16 x i32> %conv to <16 x float>
+
+  ; CHECK: ftoi
+  ; CHECK: xor_mask [[CONV:v[0-9]+]]
+  ; CHECK: itof {{v[0-9]+}}, [[CONV]]
+  ; CHECK: ret
+  ret <16 x float> %r
+}
+
+define <16 x float> @vftou_bitcast(<16 x float> %a) { ; CHECK-LABEL: vftou_bitcast:
+  %conv = fptoui <16 x float> %a to <16 x i32>
+  %r = bitcast <16 x i32> %conv to <16 x float>
+
+  ; CHECK: ftoi [[CONV:v[0-9]+]]
+  ; CHECK: xor_mask [[CONV]]
+  ; CHECK: ret
+  ret <16 x float> %r
+}
@@ -4,13 +4,15 @@ target triple = "nyuzi"
 
 define i32 @fib(i32 %a) #0 {	; CHECK: fib:
 entry:
+	; The frame is only set up on the path that makes calls.
+	; CHECK: btrue
 	; CHECK: add_i sp, sp, -
 
   %cmp = icmp sge i32 %a, 2				
   br i1 %cmp, label %if.then, label %return
 
 if.then: 
-  %sub = sub nsw i32 %a, 1				; CHECK: add_i s0, s{{[0-9]+}}, -1
+  %sub = sub nsw i32 %a, 1				; CHECK: add_i s{{[0-9]+}}, s{{[0-9]+}}, -1
   %call = call i32 @fib(i32 %sub)		; CHECK: call fib
   
   ; CHECK: move s{{[0-9]+}}, s0
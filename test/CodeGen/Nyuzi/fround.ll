@@ -0,0 +1,151 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+target triple = "nyuzi"
+
+; Rounding to an integral value converts to an integer and back, then
+; corrects the result without a branch or a library call.
+
+declare float @llvm.floor.f32(float)
+declare float @llvm.ceil.f32(float)
+declare float @llvm.trunc.f32(float)
+declare float @llvm.rint.f32(float)
+declare float @llvm.round.f32(float)
+declare <16 x float> @llvm.floor.v16f32(<16 x float>)
+declare <16 x float> @llvm.ceil.v16f32(<16 x float>)
+declare <16 x float> @llvm.trunc.v16f32(<16 x float>)
+declare <16 x float> @llvm.rint.v16f32(<16 x float>)
+declare <16 x float> @llvm.nearbyint.v16f32(<16 x float>)
+declare <16 x float> @llvm.round.v16f32(<16 x float>)
+
+define float @truncf(float %a) { ; CHECK-LABEL: truncf:
+  %r = call float @llvm.trunc.f32(float %a)
+
+  ; CHECK: ftoi [[INT:s[0-9]+]], s0
+  ; CHECK: cmplt_f
+  ; CHECK: itof {{s[0-9]+}}, [[INT]]
+  ; CHECK-NOT: call
+  ; CHECK-NOT: b{{true|false}}
+  ; CHECK: ret
+  ret float %r
+}
+
+define float @floorf(float %a) { ; CHECK-LABEL: floorf:
+  %r = call float @llvm.floor.f32(float %a)
+
+  ; CHECK: ftoi
+  ; CHECK: itof
+  ; CHECK: cmpgt_f
+  ; CHECK: sub_f
+  ; CHECK-NOT: call
+  ; CHECK-NOT: b{{true|false}}
+  ; CHECK: ret
+  ret float %r
+}
+
+define float @ceilf(float %a) { ; CHECK-LABEL: ceilf:
+  %r = call float @llvm.ceil.f32(float %a)
+
+  ; CHECK: ftoi
+  ; CHECK: itof
+  ; CHECK: cmplt_f
+  ; CHECK: sub_f
+  ; CHECK-NOT: call
+  ; CHECK-NOT: b{{true|false}}
+  ; CHECK: ret
+  ret float %r
+}
+
+define float @rintf(float %a) { ; CHECK-LABEL: rintf:
+  %r = call float @llvm.rint.f32(float %a)
+
+  ; CHECK: ftoi
+  ; CHECK: cmpge_f
+  ; CHECK-NOT: call
+  ; CHECK-NOT: b{{true|false}}
+  ; CHECK: ret
+  ret float %r
+}
+
+define float @roundf(float %a) { ; CHECK-LABEL: roundf:
+  %r = call float @llvm.round.f32(float %a)
+
+  ; CHECK: ftoi
+  ; CHECK: cmpge_f
+  ; CHECK-NOT: call
+  ; CHECK-NOT: b{{true|false}}
+  ; CHECK: ret
+  ret float %r
+}
+
+; Values too large to have a fraction keep their original value, which is a
+; masked move.
+define <16 x float> @vtrunc(<16 x float> %a) { ; CHECK-LABEL: vtrunc:
+  %r = call <16 x float> @llvm.trunc.v16f32(<16 x float> %a)
+
+  ; CHECK: ftoi [[INT:v[0-9]+]], v0
+  ; CHECK: itof [[CONV:v[0-9]+]], [[INT]]
+  ; CHECK: cmplt_f [[SMALL:s[0-9]+]]
+  ; CHECK: move_mask v0, [[SMALL]]
+  ; CHECK-NOT: getlane
+  ; CHECK: ret
+  ret <16 x float> %r
+}
+
+define <16 x float> @vfloor(<16 x float> %a) { ; CHECK-LABEL: vfloor:
+  %r = call <16 x float> @llvm.floor.v16f32(<16 x float> %a)
+
+  ; CHECK: ftoi
+  ; CHECK: itof
+  ; CHECK: cmpgt_f [[DOWN:s[0-9]+]], [[TRUNC:v[0-9]+]], v0
+  ; CHECK: add_f_mask [[TRUNC]], [[DOWN]], [[TRUNC]], {{s[0-9]+}}
+  ; CHECK-NOT: getlane
+  ; CHECK: ret
+  ret <16 x float> %r
+}
+
+define <16 x float> @vceil(<16 x float> %a) { ; CHECK-LABEL: vceil:
+  %r = call <16 x float> @llvm.ceil.v16f32(<16 x float> %a)
+
+  ; CHECK: ftoi
+  ; CHECK: itof
+  ; CHECK: cmplt_f [[UP:s[0-9]+]], [[TRUNC:v[0-9]+]], v0
+  ; CHECK: add_f_mask [[TRUNC]], [[UP]], [[TRUNC]], {{s[0-9]+}}
+  ; CHECK-NOT: getlane
+  ; CHECK: ret
+  ret <16 x float> %r
+}
+
+define <16 x float> @vround(<16 x float> %a) { ; CHECK-LABEL: vround:
+  %r = call <16 x float> @llvm.round.v16f32(<16 x float> %a)
+
+  ; CHECK: ftoi
+  ; CHECK: cmpge_f [[AWAY:s[0-9]+]]
+  ; CHECK: add_f_mask {{v[0-9]+}}, [[AWAY]]
+  ; CHECK-NOT: getlane
+  ; CHECK: ret
+  ret <16 x float> %r
+}
+
+; Ties go to the even neighbor, so the threshold depends on the low bit of
+; the truncated value.
+define <16 x float> @vrint(<16 x float> %a) { ; CHECK-LABEL: vrint:
+  %r = call <16 x float> @llvm.rint.v16f32(<16 x float> %a)
+
+  ; CHECK: ftoi [[INT:v[0-9]+]], v0
+  ; CHECK: and {{v[0-9]+}}, [[INT]], 1
+  ; CHECK: cmpge_f [[AWAY:s[0-9]+]]
+  ; CHECK: add_f_mask {{v[0-9]+}}, [[AWAY]]
+  ; CHECK-NOT: getlane
+  ; CHECK: ret
+  ret <16 x float> %r
+}
+
+define <16 x float> @vnearbyint(<16 x float> %a) { ; CHECK-LABEL: vnearbyint:
+  %r = call <16 x float> @llvm.nearbyint.v16f32(<16 x float> %a)
+
+  ; CHECK: cmpge_f [[AWAY:s[0-9]+]]
+  ; CHECK: add_f_mask {{v[0-9]+}}, [[AWAY]]
+  ; CHECK-NOT: getlane
+  ; CHECK: ret
+  ret <16 x float> %r
+}
@@ -0,0 +1,288 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+; Every third word
+define <16 x i32> @strided_load(i32* %p) { ; CHECK-LABEL: strided_load:
+	%a0 = getelementptr i32* %p, i32 0
+	%l0 = load i32* %a0, align 4
+	%v0 = insertelement <16 x i32> undef, i32 %l0, i32 0
+	%a1 = getelementptr i32* %p, i32 3
+	%l1 = load i32* %a1, align 4
+	%v1 = insertelement <16 x i32> %v0, i32 %l1, i32 1
+	%a2 = getelementptr i32* %p, i32 6
+	%l2 = load i32* %a2, align 4
+	%v2 = insertelement <16 x i32> %v1, i32 %l2, i32 2
+	%a3 = getelementptr i32* %p, i32 9
+	%l3 = load i32* %a3, align 4
+	%v3 = insertelement <16 x i32> %v2, i32 %l3, i32 3
+	%a4 = getelementptr i32* %p, i32 12
+	%l4 = load i32* %a4, align 4
+	%v4 = insertelement <16 x i32> %v3, i32 %l4, i32 4
+	%a5 = getelementptr i32* %p, i32 15
+	%l5 = load i32* %a5, align 4
+	%v5 = insertelement <16 x i32> %v4, i32 %l5, i32 5
+	%a6 = getelementptr i32* %p, i32 18
+	%l6 = load i32* %a6, align 4
+	%v6 = insertelement <16 x i32> %v5, i32 %l6, i32 6
+	%a7 = getelementptr i32* %p, i32 21
+	%l7 = load i32* %a7, align 4
+	%v7 = insertelement <16 x i32> %v6, i32 %l7, i32 7
+	%a8 = getelementptr i32* %p, i32 24
+	%l8 = load i32* %a8, align 4
+	%v8 = insertelement <16 x i32> %v7, i32 %l8, i32 8
+	%a9 = getelementptr i32* %p, i32 27
+	%l9 = load i32* %a9, align 4
+	%v9 = insertelement <16 x i32> %v8, i32 %l9, i32 9
+	%a10 = getelementptr i32* %p, i32 30
+	%l10 = load i32* %a10, align 4
+	%v10 = insertelement <16 x i32> %v9, i32 %l10, i32 10
+	%a11 = getelementptr i32* %p, i32 33
+	%l11 = load i32* %a11, align 4
+	%v11 = insertelement <16 x i32> %v10, i32 %l11, i32 11
+	%a12 = getelementptr i32* %p, i32 36
+	%l12 = load i32* %a12, align 4
+	%v12 = insertelement <16 x i32> %v11, i32 %l12, i32 12
+	%a13 = getelementptr i32* %p, i32 39
+	%l13 = load i32* %a13, align 4
+	%v13 = insertelement <16 x i32> %v12, i32 %l13, i32 13
+	%a14 = getelementptr i32* %p, i32 42
+	%l14 = load i32* %a14, align 4
+	%v14 = insertelement <16 x i32> %v13, i32 %l14, i32 14
+	%a15 = getelementptr i32* %p, i32 45
+	%l15 = load i32* %a15, align 4
+	%v15 = insertelement <16 x i32> %v14, i32 %l15, i32 15
+
+; CHECK: load_v [[OFFSETS:v[0-9]+]], .LCPI
+; CHECK: add_i [[ADDRS:v[0-9]+]], [[OFFSETS]], s0
+; CHECK: load_gath v0, ([[ADDRS]])
+; CHECK-NOT: load_32
+
+	ret <16 x i32> %v15
+}
+; The second field of an array of four element structures
+define <16 x float> @field_load(float* %p) { ; CHECK-LABEL: field_load:
+	%a0 = getelementptr float* %p, i32 1
+	%l0 = load float* %a0, align 4
+	%v0 = insertelement <16 x float> undef, float %l0, i32 0
+	%a1 = getelementptr float* %p, i32 5
+	%l1 = load float* %a1, align 4
+	%v1 = insertelement <16 x float> %v0, float %l1, i32 1
+	%a2 = getelementptr float* %p, i32 9
+	%l2 = load float* %a2, align 4
+	%v2 = insertelement <16 x float> %v1, float %l2, i32 2
+	%a3 = getelementptr float* %p, i32 13
+	%l3 = load float* %a3, align 4
+	%v3 = insertelement <16 x float> %v2, float %l3, i32 3
+	%a4 = getelementptr float* %p, i32 17
+	%l4 = load float* %a4, align 4
+	%v4 = insertelement <16 x float> %v3, float %l4, i32 4
+	%a5 = getelementptr float* %p, i32 21
+	%l5 = load float* %a5, align 4
+	%v5 = insertelement <16 x float> %v4, float %l5, i32 5
+	%a6 = getelementptr float* %p, i32 25
+	%l6 = load float* %a6, align 4
+	%v6 = insertelement <16 x float> %v5, float %l6, i32 6
+	%a7 = getelementptr float* %p, i32 29
+	%l7 = load float* %a7, align 4
+	%v7 = insertelement <16 x float> %v6, float %l7, i32 7
+	%a8 = getelementptr float* %p, i32 33
+	%l8 = load float* %a8, align 4
+	%v8 = insertelement <16 x float> %v7, float %l8, i32 8
+	%a9 = getelementptr float* %p, i32 37
+	%l9 = load float* %a9, align 4
+	%v9 = insertelement <16 x float> %v8, float %l9, i32 9
+	%a10 = getelementptr float* %p, i32 41
+	%l10 = load float* %a10, align 4
+	%v10 = insertelement <16 x float> %v9, float %l10, i32 10
+	%a11 = getelementptr float* %p, i32 45
+	%l11 = load float* %a11, align 4
+	%v11 = insertelement <16 x float> %v10, float %l11, i32 11
+	%a12 = getelementptr float* %p, i32 49
+	%l12 = load float* %a12, align 4
+	%v12 = insertelement <16 x float> %v11, float %l12, i32 12
+	%a13 = getelementptr float* %p, i32 53
+	%l13 = load float* %a13, align 4
+	%v13 = insertelement <16 x float> %v12, float %l13, i32 13
+	%a14 = getelementptr float* %p, i32 57
+	%l14 = load float* %a14, align 4
+	%v14 = insertelement <16 x float> %v13, float %l14, i32 14
+	%a15 = getelementptr float* %p, i32 61
+	%l15 = load float* %a15, align 4
+	%v15 = insertelement <16 x float> %v14, float %l15, i32 15
+
+; CHECK: load_gath v0, (v{{[0-9]+}})
+; CHECK-NOT: load_32
+
+	ret <16 x float> %v15
+}
+; A permuted block that isn't aligned doesn't need a shuffle, because the
+; gather can load the lanes in any order.
+define <16 x i32> @reversed_load(i32* %p) { ; CHECK-LABEL: reversed_load:
+	%a0 = getelementptr i32* %p, i32 15
+	%l0 = load i32* %a0, align 4
+	%v0 = insertelement <16 x i32> undef, i32 %l0, i32 0
+	%a1 = getelementptr i32* %p, i32 14
+	%l1 = load i32* %a1, align 4
+	%v1 = insertelement <16 x i32> %v0, i32 %l1, i32 1
+	%a2 = getelementptr i32* %p, i32 13
+	%l2 = load i32* %a2, align 4
+	%v2 = insertelement <16 x i32> %v1, i32 %l2, i32 2
+	%a3 = getelementptr i32* %p, i32 12
+	%l3 = load i32* %a3, align 4
+	%v3 = insertelement <16 x i32> %v2, i32 %l3, i32 3
+	%a4 = getelementptr i32* %p, i32 11
+	%l4 = load i32* %a4, align 4
+	%v4 = insertelement <16 x i32> %v3, i32 %l4, i32 4
+	%a5 = getelementptr i32* %p, i32 10
+	%l5 = load i32* %a5, align 4
+	%v5 = insertelement <16 x i32> %v4, i32 %l5, i32 5
+	%a6 = getelementptr i32* %p, i32 9
+	%l6 = load i32* %a6, align 4
+	%v6 = insertelement <16 x i32> %v5, i32 %l6, i32 6
+	%a7 = getelementptr i32* %p, i32 8
+	%l7 = load i32* %a7, align 4
+	%v7 = insertelement <16 x i32> %v6, i32 %l7, i32 7
+	%a8 = getelementptr i32* %p, i32 7
+	%l8 = load i32* %a8, align 4
+	%v8 = insertelement <16 x i32> %v7, i32 %l8, i32 8
+	%a9 = getelementptr i32* %p, i32 6
+	%l9 = load i32* %a9, align 4
+	%v9 = insertelement <16 x i32> %v8, i32 %l9, i32 9
+	%a10 = getelementptr i32* %p, i32 5
+	%l10 = load i32* %a10, align 4
+	%v10 = insertelement <16 x i32> %v9, i32 %l10, i32 10
+	%a11 = getelementptr i32* %p, i32 4
+	%l11 = load i32* %a11, align 4
+	%v11 = insertelement <16 x i32> %v10, i32 %l11, i32 11
+	%a12 = getelementptr i32* %p, i32 3
+	%l12 = load i32* %a12, align 4
+	%v12 = insertelement <16 x i32> %v11, i32 %l12, i32 12
+	%a13 = getelementptr i32* %p, i32 2
+	%l13 = load i32* %a13, align 4
+	%v13 = insertelement <16 x i32> %v12, i32 %l13, i32 13
+	%a14 = getelementptr i32* %p, i32 1
+	%l14 = load i32* %a14, align 4
+	%v14 = insertelement <16 x i32> %v13, i32 %l14, i32 14
+	%a15 = getelementptr i32* %p, i32 0
+	%l15 = load i32* %a15, align 4
+	%v15 = insertelement <16 x i32> %v14, i32 %l15, i32 15
+
+; CHECK: load_gath v0, (v{{[0-9]+}})
+; CHECK-NOT: shuffle
+
+	ret <16 x i32> %v15
+}
+; An aligned permuted block is a block load and a shuffle.
+define <16 x i32> @reversed_block_load(i32* %p) { ; CHECK-LABEL: reversed_block_load:
+	%a0 = getelementptr i32* %p, i32 15
+	%l0 = load i32* %a0, align 4
+	%v0 = insertelement <16 x i32> undef, i32 %l0, i32 0
+	%a1 = getelementptr i32* %p, i32 14
+	%l1 = load i32* %a1, align 4
+	%v1 = insertelement <16 x i32> %v0, i32 %l1, i32 1
+	%a2 = getelementptr i32* %p, i32 13
+	%l2 = load i32* %a2, align 4
+	%v2 = insertelement <16 x i32> %v1, i32 %l2, i32 2
+	%a3 = getelementptr i32* %p, i32 12
+	%l3 = load i32* %a3, align 4
+	%v3 = insertelement <16 x i32> %v2, i32 %l3, i32 3
+	%a4 = getelementptr i32* %p, i32 11
+	%l4 = load i32* %a4, align 4
+	%v4 = insertelement <16 x i32> %v3, i32 %l4, i32 4
+	%a5 = getelementptr i32* %p, i32 10
+	%l5 = load i32* %a5, align 4
+	%v5 = insertelement <16 x i32> %v4, i32 %l5, i32 5
+	%a6 = getelementptr i32* %p, i32 9
+	%l6 = load i32* %a6, align 4
+	%v6 = insertelement <16 x i32> %v5, i32 %l6, i32 6
+	%a7 = getelementptr i32* %p, i32 8
+	%l7 = load i32* %a7, align 4
+	%v7 = insertelement <16 x i32> %v6, i32 %l7, i32 7
+	%a8 = getelementptr i32* %p, i32 7
+	%l8 = load i32* %a8, align 4
+	%v8 = insertelement <16 x i32> %v7, i32 %l8, i32 8
+	%a9 = getelementptr i32* %p, i32 6
+	%l9 = load i32* %a9, align 4
+	%v9 = insertelement <16 x i32> %v8, i32 %l9, i32 9
+	%a10 = getelementptr i32* %p, i32 5
+	%l10 = load i32* %a10, align 4
+	%v10 = insertelement <16 x i32> %v9, i32 %l10, i32 10
+	%a11 = getelementptr i32* %p, i32 4
+	%l11 = load i32* %a11, align 4
+	%v11 = insertelement <16 x i32> %v10, i32 %l11, i32 11
+	%a12 = getelementptr i32* %p, i32 3
+	%l12 = load i32* %a12, align 4
+	%v12 = insertelement <16 x i32> %v11, i32 %l12, i32 12
+	%a13 = getelementptr i32* %p, i32 2
+	%l13 = load i32* %a13, align 4
+	%v13 = insertelement <16 x i32> %v12, i32 %l13, i32 13
+	%a14 = getelementptr i32* %p, i32 1
+	%l14 = load i32* %a14, align 4
+	%v14 = insertelement <16 x i32> %v13, i32 %l14, i32 14
+	%a15 = getelementptr i32* %p, i32 0
+	%l15 = load i32* %a15, align 64
+	%v15 = insertelement <16 x i32> %v14, i32 %l15, i32 15
+
+; CHECK: load_v [[BLOCK:v[0-9]+]], (s0)
+; CHECK: shuffle v0, [[BLOCK]], v{{[0-9]+}}
+; CHECK-NOT: load_gath
+
+	ret <16 x i32> %v15
+}
+; Every other word
+define void @strided_store(i32* %p, <16 x i32> %v) { ; CHECK-LABEL: strided_store:
+	%a0 = getelementptr i32* %p, i32 0
+	%e0 = extractelement <16 x i32> %v, i32 0
+	store i32 %e0, i32* %a0, align 4
+	%a1 = getelementptr i32* %p, i32 2
+	%e1 = extractelement <16 x i32> %v, i32 1
+	store i32 %e1, i32* %a1, align 4
+	%a2 = getelementptr i32* %p, i32 4
+	%e2 = extractelement <16 x i32> %v, i32 2
+	store i32 %e2, i32* %a2, align 4
+	%a3 = getelementptr i32* %p, i32 6
+	%e3 = extractelement <16 x i32> %v, i32 3
+	store i32 %e3, i32* %a3, align 4
+	%a4 = getelementptr i32* %p, i32 8
+	%e4 = extractelement <16 x i32> %v, i32 4
+	store i32 %e4, i32* %a4, align 4
+	%a5 = getelementptr i32* %p, i32 10
+	%e5 = extractelement <16 x i32> %v, i32 5
+	store i32 %e5, i32* %a5, align 4
+	%a6 = getelementptr i32* %p, i32 12
+	%e6 = extractelement <16 x i32> %v, i32 6
+	store i32 %e6, i32* %a6, align 4
+	%a7 = getelementptr i32* %p, i32 14
+	%e7 = extractelement <16 x i32> %v, i32 7
+	store i32 %e7, i32* %a7, align 4
+	%a8 = getelementptr i32* %p, i32 16
+	%e8 = extractelement <16 x i32> %v, i32 8
+	store i32 %e8, i32* %a8, align 4
+	%a9 = getelementptr i32* %p, i32 18
+	%e9 = extractelement <16 x i32> %v, i32 9
+	store i32 %e9, i32* %a9, align 4
+	%a10 = getelementptr i32* %p, i32 20
+	%e10 = extractelement <16 x i32> %v, i32 10
+	store i32 %e10, i32* %a10, align 4
+	%a11 = getelementptr i32* %p, i32 22
+	%e11 = extractelement <16 x i32> %v, i32 11
+	store i32 %e11, i32* %a11, align 4
+	%a12 = getelementptr i32* %p, i32 24
+	%e12 = extractelement <16 x i32> %v, i32 12
+	store i32 %e12, i32* %a12, align 4
+	%a13 = getelementptr i32* %p, i32 26
+	%e13 = extractelement <16 x i32> %v, i32 13
+	store i32 %e13, i32* %a13, align 4
+	%a14 = getelementptr i32* %p, i32 28
+	%e14 = extractelement <16 x i32> %v, i32 14
+	store i32 %e14, i32* %a14, align 4
+	%a15 = getelementptr i32* %p, i32 30
+	%e15 = extractelement <16 x i32> %v, i32 15
+	store i32 %e15, i32* %a15, align 4
+
+; CHECK: load_v [[OFFSETS:v[0-9]+]], .LCPI
+; CHECK: add_i [[ADDRS:v[0-9]+]], [[OFFSETS]], s0
+; CHECK: store_scat v0, ([[ADDRS]])
+; CHECK-NOT: store_32
+
+	ret void
+}
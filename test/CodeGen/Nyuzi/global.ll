@@ -15,9 +15,9 @@ define void @test() #0 {
 	%1 = load i32* @foo, align 4
 	store i32 %1, i32* @bar, align 4
 
-	; CHECK: load_32 [[FOO_PTR:s[0-9]+]], [[FOO_LBL]]
+	; CHECK-DAG: load_32 [[FOO_PTR:s[0-9]+]], [[FOO_LBL]]
+	; CHECK-DAG: load_32 [[BAR_PTR:s[0-9]+]], [[BAR_LBL]]
 	; CHECK: load_32 {{s[0-9]+}}, ([[FOO_PTR]])
-	; CHECK: load_32 [[BAR_PTR:s[0-9]+]], [[BAR_LBL]]
 	; CHECK: store_32 {{s[0-9]+}}, ([[BAR_PTR]])
 
 
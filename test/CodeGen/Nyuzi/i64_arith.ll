@@ -0,0 +1,92 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+target triple = "nyuzi"
+
+; The carry out of the low word is an unsigned compare, added into the high
+; word without a branch.
+define i64 @add64(i64 %a, i64 %b) {	; CHECK-LABEL: add64:
+  %r = add i64 %a, %b
+
+  ; CHECK: add_i [[LO:s[0-9]+]], s0, s2
+  ; CHECK: cmplt_u [[CARRY:s[0-9]+]], [[LO]], s0
+  ; CHECK: and [[CARRY]], [[CARRY]], 1
+  ; CHECK: add_i s1, s1, [[CARRY]]
+  ; CHECK-NOT: btrue
+  ; CHECK: ret
+  ret i64 %r
+}
+
+define i64 @sub64(i64 %a, i64 %b) {	; CHECK-LABEL: sub64:
+  %r = sub i64 %a, %b
+
+  ; CHECK: cmplt_u [[BORROW:s[0-9]+]], s0, s2
+  ; CHECK: and [[BORROW]], [[BORROW]], 1
+  ; CHECK: sub_i s1, s1, [[BORROW]]
+  ; CHECK-NOT: btrue
+  ; CHECK: ret
+  ret i64 %r
+}
+
+; Variable shifts are funnel sequences rather than library calls.
+define i64 @shl64(i64 %a, i64 %b) {	; CHECK-LABEL: shl64:
+  %r = shl i64 %a, %b
+
+  ; CHECK-NOT: call
+  ; CHECK: shl {{s[0-9]+}}, s2, 26
+  ; CHECK: ashr {{s[0-9]+}}, {{s[0-9]+}}, 31
+  ; CHECK-NOT: call
+  ; CHECK-NOT: btrue
+  ; CHECK-NOT: bfalse
+  ; CHECK: ret
+  ret i64 %r
+}
+
+define i64 @lshr64(i64 %a, i64 %b) {	; CHECK-LABEL: lshr64:
+  %r = lshr i64 %a, %b
+
+  ; CHECK-NOT: call
+  ; CHECK: shl {{s[0-9]+}}, s2, 26
+  ; CHECK: ashr {{s[0-9]+}}, {{s[0-9]+}}, 31
+  ; CHECK-NOT: call
+  ; CHECK-NOT: btrue
+  ; CHECK-NOT: bfalse
+  ; CHECK: ret
+  ret i64 %r
+}
+
+define i64 @ashr64(i64 %a, i64 %b) {	; CHECK-LABEL: ashr64:
+  %r = ashr i64 %a, %b
+
+  ; CHECK-NOT: call
+  ; CHECK: ashr {{s[0-9]+}}, s1, 31
+  ; CHECK-NOT: call
+  ; CHECK-NOT: btrue
+  ; CHECK-NOT: bfalse
+  ; CHECK: ret
+  ret i64 %r
+}
+
+; A 32x32->64 multiply is a low and a high multiply.
+define i64 @umul(i32 %a, i32 %b) {	; CHECK-LABEL: umul:
+  %x = zext i32 %a to i64
+  %y = zext i32 %b to i64
+  %r = mul i64 %x, %y
+
+  ; CHECK-DAG: mull_i {{s[0-9]+}}, s0, s1
+  ; CHECK-DAG: mulh_u s1, s0, s1
+  ; CHECK-NOT: call
+  ; CHECK: ret
+  ret i64 %r
+}
+
+define i64 @smul(i32 %a, i32 %b) {	; CHECK-LABEL: smul:
+  %x = sext i32 %a to i64
+  %y = sext i32 %b to i64
+  %r = mul i64 %x, %y
+
+  ; CHECK-DAG: mull_i {{s[0-9]+}}, s0, s1
+  ; CHECK-DAG: mulh_i s1, s0, s1
+  ; CHECK-NOT: call
+  ; CHECK: ret
+  ret i64 %r
+}
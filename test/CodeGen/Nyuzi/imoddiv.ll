@@ -2,23 +2,56 @@
 
 target triple = "nyuzi"
 
+; Division is computed inline from a floating point reciprocal estimate.
 define i32 @urem(i32 %a, i32 %b) { 	; CHECK: urem:
-	%1 = urem i32 %a, %b 			; CHECK: call __umodsi3
+	%1 = urem i32 %a, %b 			; CHECK: reciprocal
+	; CHECK: mulh_u
+	; CHECK-NOT: call
 	ret i32 %1
 }
 
 define i32 @srem(i32 %a, i32 %b) { 	; CHECK: srem:
-	%1 = srem i32 %a, %b 			; CHECK: call __modsi3
+	%1 = srem i32 %a, %b 			; CHECK: reciprocal
+	; CHECK-NOT: call
 	ret i32 %1
 }
 
 define i32 @udiv(i32 %a, i32 %b) { 	; CHECK: udiv:
-	%1 = udiv i32 %a, %b 			; CHECK: call __udivsi3
+	%1 = udiv i32 %a, %b 			; CHECK: reciprocal
+	; CHECK: mulh_u
+	; CHECK-NOT: call
 	ret i32 %1
 }
 
 define i32 @sdiv(i32 %a, i32 %b) { 	; CHECK: sdiv:
-	%1 = sdiv i32 %a, %b 			; CHECK: call __divsi3
+	%1 = sdiv i32 %a, %b 			; CHECK: reciprocal
+	; CHECK-NOT: call
 	ret i32 %1
 }
 
+define <16 x i32> @vudiv(<16 x i32> %a, <16 x i32> %b) { 	; CHECK: vudiv:
+	%1 = udiv <16 x i32> %a, %b 		; CHECK: reciprocal v{{[0-9]+}}
+	; CHECK: mulh_u v{{[0-9]+}}
+	; CHECK-NOT: call
+	ret <16 x i32> %1
+}
+
+define <16 x i32> @vsrem(<16 x i32> %a, <16 x i32> %b) { 	; CHECK: vsrem:
+	%1 = srem <16 x i32> %a, %b 		; CHECK: reciprocal v{{[0-9]+}}
+	; CHECK-NOT: call
+	ret <16 x i32> %1
+}
+
+; Division by a uniform constant is a multiply by a magic number.
+define i32 @udiv_const(i32 %a) { 	; CHECK: udiv_const:
+	%1 = udiv i32 %a, 7 			; CHECK: mulh_u
+	; CHECK-NOT: reciprocal
+	ret i32 %1
+}
+
+define <16 x i32> @vsdiv_const(<16 x i32> %a) { 	; CHECK: vsdiv_const:
+	%1 = sdiv <16 x i32> %a, <i32 10, i32 10, i32 10, i32 10, i32 10, i32 10, i32 10, i32 10, i32 10, i32 10, i32 10, i32 10, i32 10, i32 10, i32 10, i32 10>
+	; CHECK: mulh_i v{{[0-9]+}}
+	; CHECK-NOT: reciprocal
+	ret <16 x i32> %1
+}
@@ -75,3 +75,27 @@ define <16 x float> @loadfvec(<16 x float>* %ptr) { ; CHECK: loadfvec
 	%tmp = load <16 x float>* %ptr	 ; load_v v0, (s0)
 	ret <16 x float> %tmp
 }
+
+; Vectors that are only aligned to the element size are accessed with
+; gather/scatter from consecutive addresses.
+define <16 x i32> @loadivec_align4(<16 x i32>* %ptr) { ; CHECK: loadivec_align4
+	%tmp = load <16 x i32>* %ptr, align 4
+	; CHECK: load_v [[OFFSETS:v[0-9]+]], .LCPI
+	; CHECK: add_i [[ADDRS:v[0-9]+]], {{v[0-9]+}}, s0
+	; CHECK: load_gath v0, ([[ADDRS]])
+	ret <16 x i32> %tmp
+}
+
+define void @storefvec_align4(<16 x float>* %ptr, <16 x float> %val) { ; CHECK: storefvec_align4
+	store <16 x float> %val, <16 x float>* %ptr, align 4
+	; CHECK: add_i [[ADDRS:v[0-9]+]], {{v[0-9]+}}, s0
+	; CHECK: store_scat v0, ([[ADDRS]])
+	ret void
+}
+
+define <16 x float> @loadfvec_align1(<16 x float>* %ptr) { ; CHECK: loadfvec_align1
+	%tmp = load <16 x float>* %ptr, align 1
+	; CHECK-NOT: load_gath
+	; CHECK: load_u8
+	ret <16 x float> %tmp
+}
@@ -0,0 +1,172 @@
+; RUN: llc -mtriple nyuzi-elf -nyuzi-loop-prefetch -nyuzi-prefetch-loads %s -o - | FileCheck %s
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s -check-prefix=OFF
+
+; Loop prefetching is off by default.
+; OFF-NOT: load_u8
+; OFF: ret
+
+target triple = "nyuzi"
+
+; Loads that walk an array are prefetched 512 bytes ahead, but no further
+; than the last element the loop reads.
+define i32 @scalar_walk(i32* %a, i32 %n) { ; CHECK-LABEL: scalar_walk:
+entry:
+  br label %loop
+
+; CHECK: add_i [[PTR:s[0-9]+]], s0, 512
+; CHECK: [[LOOP:\.LBB[0-9_]+]]:
+; CHECK: cmpgt_u {{s[0-9]+}}, [[PTR]], [[LAST:s[0-9]+]]
+; CHECK: load_u8 s{{[0-9]+}}, (s{{[0-9]+}})
+; CHECK: load_32 s{{[0-9]+}}, -512([[PTR]])
+; CHECK: btrue s{{[0-9]+}}, [[LOOP]]
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %sum = phi i32 [ 0, %entry ], [ %sum.next, %loop ]
+  %p = getelementptr i32* %a, i32 %i
+  %v = load i32* %p
+  %sum.next = add i32 %sum, %v
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %sum.next
+}
+
+; Each block load stream gets its own prefetch. Stores are not prefetched.
+define void @block_walk(<16 x i32>* %a, <16 x i32>* %b, i32 %n) { ; CHECK-LABEL: block_walk:
+entry:
+  br label %loop
+
+; CHECK: [[LOOP:\.LBB[0-9_]+]]:
+; CHECK: cmpgt_u {{s[0-9]+}}, [[A:s[0-9]+]]
+; CHECK: load_u8
+; CHECK: load_v v{{[0-9]+}}, -512([[A]])
+; CHECK: cmpgt_u {{s[0-9]+}}, [[B:s[0-9]+]]
+; CHECK: load_u8
+; CHECK: load_v v{{[0-9]+}}, -512([[B]])
+; CHECK-NOT: load_u8
+; CHECK: btrue s{{[0-9]+}}, [[LOOP]]
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %pa = getelementptr <16 x i32>* %a, i32 %i
+  %pb = getelementptr <16 x i32>* %b, i32 %i
+  %va = load <16 x i32>* %pa
+  %vb = load <16 x i32>* %pb
+  %sum = add <16 x i32> %va, %vb
+  store <16 x i32> %sum, <16 x i32>* %pa
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+; Two fields in the same cache line share a prefetch.
+define i32 @struct_walk({ i32, i32 }* %a, i32 %n) { ; CHECK-LABEL: struct_walk:
+entry:
+  br label %loop
+
+; CHECK: [[LOOP:\.LBB[0-9_]+]]:
+; CHECK: load_u8
+; CHECK-NOT: load_u8
+; CHECK: btrue s{{[0-9]+}}, [[LOOP]]
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %sum = phi i32 [ 0, %entry ], [ %sum.next, %loop ]
+  %px = getelementptr { i32, i32 }* %a, i32 %i, i32 0
+  %py = getelementptr { i32, i32 }* %a, i32 %i, i32 1
+  %x = load i32* %px
+  %y = load i32* %py
+  %xy = add i32 %x, %y
+  %sum.next = add i32 %sum, %xy
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %sum.next
+}
+
+; The loop finishes before data 512 bytes ahead would be used.
+define i32 @short_loop(i32* %a) { ; CHECK-LABEL: short_loop:
+entry:
+  br label %loop
+
+; CHECK-NOT: load_u8
+; CHECK: ret
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %sum = phi i32 [ 0, %entry ], [ %sum.next, %loop ]
+  %p = getelementptr i32* %a, i32 %i
+  %v = load i32* %p
+  %sum.next = add i32 %sum, %v
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, 64
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %sum.next
+}
+
+; Walking backwards, the prefetch is clamped to the start of the array.
+define i32 @reverse_walk(i32* %a, i32 %n) { ; CHECK-LABEL: reverse_walk:
+entry:
+  br label %loop
+
+; CHECK: [[LOOP:\.LBB[0-9_]+]]:
+; CHECK: cmplt_u
+; CHECK: load_u8
+; CHECK: btrue s{{[0-9]+}}, [[LOOP]]
+
+loop:
+  %i = phi i32 [ %n, %entry ], [ %i.next, %loop ]
+  %sum = phi i32 [ 0, %entry ], [ %sum.next, %loop ]
+  %i.next = add i32 %i, -1
+  %p = getelementptr i32* %a, i32 %i.next
+  %v = load i32* %p
+  %sum.next = add i32 %sum, %v
+  %done = icmp eq i32 %i.next, 0
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %sum.next
+}
+
+; A load that doesn't run on every iteration may never read the last
+; address, so it isn't prefetched.
+define i32 @conditional_load(i32* %a, i32* %b, i32 %n) { ; CHECK-LABEL: conditional_load:
+entry:
+  br label %loop
+
+; CHECK-NOT: load_u8
+; CHECK: ret
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %sum = phi i32 [ 0, %entry ], [ %sum.next, %latch ]
+  %pb = getelementptr i32* %b, i32 %i
+  %flag = load volatile i32* %pb
+  %skip = icmp eq i32 %flag, 0
+  br i1 %skip, label %latch, label %body
+
+body:
+  %pa = getelementptr i32* %a, i32 %i
+  %v = load i32* %pa
+  br label %latch
+
+latch:
+  %val = phi i32 [ 0, %loop ], [ %v, %body ]
+  %sum.next = add i32 %sum, %val
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %sum.next
+}
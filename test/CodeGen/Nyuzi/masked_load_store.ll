@@ -0,0 +1,57 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+declare <16 x i32> @llvm.masked.load.v16i32(<16 x i32>*, i32, <16 x i1>, <16 x i32>)
+declare <16 x float> @llvm.masked.load.v16f32(<16 x float>*, i32, <16 x i1>, <16 x float>)
+declare void @llvm.masked.store.v16i32(<16 x i32>, <16 x i32>*, i32, <16 x i1>)
+
+define <16 x i32> @mload_aligned(<16 x i32>* %ptr, <16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: mload_aligned:
+	%mask = icmp sgt <16 x i32> %a, %b
+	%v = call <16 x i32> @llvm.masked.load.v16i32(<16 x i32>* %ptr, i32 64, <16 x i1> %mask, <16 x i32> undef)
+
+; CHECK: cmpgt_i [[MASK:s[0-9]+]], v0, v1
+; CHECK: load_v_mask v0, [[MASK]], (s0)
+
+	ret <16 x i32> %v
+}
+
+; The disabled lanes come from the pass through value
+define <16 x float> @mload_unaligned(<16 x float>* %ptr, <16 x i32> %a, <16 x i32> %b, <16 x float> %old) { ; CHECK-LABEL: mload_unaligned:
+	%mask = icmp eq <16 x i32> %a, %b
+	%v = call <16 x float> @llvm.masked.load.v16f32(<16 x float>* %ptr, i32 4, <16 x i1> %mask, <16 x float> %old)
+
+; CHECK: cmpeq_i [[MASK:s[0-9]+]], v0, v1
+; CHECK: load_gath_mask [[LOADED:v[0-9]+]], [[MASK]], (v{{[0-9]+}})
+; CHECK: move_mask v2, [[MASK]], [[LOADED]]
+
+	ret <16 x float> %v
+}
+
+define void @mstore_aligned(<16 x i32>* %ptr, <16 x i32> %val, <16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: mstore_aligned:
+	%mask = icmp ult <16 x i32> %a, %b
+	call void @llvm.masked.store.v16i32(<16 x i32> %val, <16 x i32>* %ptr, i32 64, <16 x i1> %mask)
+
+; CHECK: cmplt_u [[MASK:s[0-9]+]], v1, v2
+; CHECK: store_v_mask v0, [[MASK]], (s0)
+
+	ret void
+}
+
+define void @mstore_unaligned(<16 x i32>* %ptr, <16 x i32> %val, <16 x i32> %a, <16 x i32> %b) { ; CHECK-LABEL: mstore_unaligned:
+	%mask = icmp ult <16 x i32> %a, %b
+	call void @llvm.masked.store.v16i32(<16 x i32> %val, <16 x i32>* %ptr, i32 4, <16 x i1> %mask)
+
+; CHECK: cmplt_u [[MASK:s[0-9]+]], v1, v2
+; CHECK: store_scat_mask v0, [[MASK]], (v{{[0-9]+}})
+
+	ret void
+}
+
+; A constant mask becomes a constant lane mask
+define void @mstore_const_mask(<16 x i32>* %ptr, <16 x i32> %val) { ; CHECK-LABEL: mstore_const_mask:
+	call void @llvm.masked.store.v16i32(<16 x i32> %val, <16 x i32>* %ptr, i32 64, <16 x i1> <i1 true, i1 true, i1 true, i1 true, i1 true, i1 true, i1 true, i1 true, i1 false, i1 false, i1 false, i1 false, i1 false, i1 false, i1 false, i1 false>)
+
+; CHECK: load_32 [[MASK:s[0-9]+]], .LCPI
+; CHECK: store_v_mask v0, [[MASK]], (s0)
+
+	ret void
+}
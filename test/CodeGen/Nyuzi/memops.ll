@@ -0,0 +1,72 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+target triple = "nyuzi"
+
+declare void @llvm.memcpy.p0i8.p0i8.i32(i8* nocapture, i8* nocapture, i32, i32, i1)
+declare void @llvm.memmove.p0i8.p0i8.i32(i8* nocapture, i8* nocapture, i32, i32, i1)
+declare void @llvm.memset.p0i8.i32(i8* nocapture, i8, i32, i32, i1)
+
+; Aligned copies use block loads and stores.
+define void @copy_blocks(i8* %dst, i8* %src) { ; CHECK: copy_blocks:
+	call void @llvm.memcpy.p0i8.p0i8.i32(i8* %dst, i8* %src, i32 128, i32 64, i1 false)
+	; CHECK-DAG: load_v [[VAL1:v[0-9]+]], (s1)
+	; CHECK-DAG: load_v [[VAL2:v[0-9]+]], 64(s1)
+	; CHECK-DAG: store_v [[VAL1]], (s0)
+	; CHECK-DAG: store_v [[VAL2]], 64(s0)
+	; CHECK-NOT: memcpy
+	ret void
+}
+
+; A partial block at the end is written with a masked store.
+define void @copy_tail(i8* %dst, i8* %src) { ; CHECK: copy_tail:
+	call void @llvm.memcpy.p0i8.p0i8.i32(i8* %dst, i8* %src, i32 80, i32 64, i1 false)
+	; CHECK-DAG: store_v v{{[0-9]+}}, (s0)
+	; CHECK-DAG: store_v_mask v{{[0-9]+}}, s{{[0-9]+}}, 64(s0)
+	; CHECK-NOT: memcpy
+	ret void
+}
+
+define void @move_blocks(i8* %dst, i8* %src) { ; CHECK: move_blocks:
+	call void @llvm.memmove.p0i8.p0i8.i32(i8* %dst, i8* %src, i32 128, i32 64, i1 false)
+	; CHECK: load_v
+	; CHECK: load_v
+	; CHECK: store_v
+	; CHECK: store_v
+	; CHECK-NOT: memmove
+	ret void
+}
+
+; memset stores a splat of the fill value.
+define void @fill_blocks(i8* %dst, i8 %val) { ; CHECK: fill_blocks:
+	call void @llvm.memset.p0i8.i32(i8* %dst, i8 %val, i32 200, i32 64, i1 false)
+	; CHECK: move [[FILL:v[0-9]+]], s{{[0-9]+}}
+	; CHECK-DAG: store_v [[FILL]], (s0)
+	; CHECK-DAG: store_v [[FILL]], 64(s0)
+	; CHECK-DAG: store_v [[FILL]], 128(s0)
+	; CHECK-DAG: store_v_mask [[FILL]], s{{[0-9]+}}, 192(s0)
+	; CHECK-NOT: memset
+	ret void
+}
+
+; A stack object can be aligned, so a fill starting partway into it has a
+; ragged head.
+define void @fill_offset() { ; CHECK: fill_offset:
+	%buf = alloca [256 x i8], align 64
+	%ptr = getelementptr [256 x i8]* %buf, i32 0, i32 16
+	call void @llvm.memset.p0i8.i32(i8* %ptr, i8 0, i32 128, i32 16, i1 false)
+	; CHECK-DAG: store_v_mask v{{[0-9]+}}, s{{[0-9]+}}, (sp)
+	; CHECK-DAG: store_v v{{[0-9]+}}, 64(sp)
+	; CHECK-DAG: store_v_mask v{{[0-9]+}}, s{{[0-9]+}}, 128(sp)
+	; CHECK-NOT: memset
+	call void @use(i8* %ptr)
+	ret void
+}
+
+declare void @use(i8*)
+
+; Copies above the threshold call the library.
+define void @copy_large(i8* %dst, i8* %src) { ; CHECK: copy_large:
+	call void @llvm.memcpy.p0i8.p0i8.i32(i8* %dst, i8* %src, i32 4096, i32 64, i1 false)
+	; CHECK: call memcpy
+	ret void
+}
@@ -0,0 +1,141 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+target triple = "nyuzi"
+
+; Vectors with fewer than 16 elements are widened to a full register. Loads
+; and stores are masked to the live lanes rather than split into elements.
+
+define void @v4f32(<4 x float>* %p, <4 x float>* %q) { ; CHECK-LABEL: v4f32:
+  %a = load <4 x float>* %p
+  %b = load <4 x float>* %q
+  %r = fmul <4 x float> %a, %b
+  store <4 x float> %r, <4 x float>* %p
+
+  ; CHECK: load_32 [[MASK:s[0-9]+]]
+  ; CHECK-DAG: load_gath_mask {{v[0-9]+}}, [[MASK]], ([[PADDR:v[0-9]+]])
+  ; CHECK-DAG: load_gath_mask {{v[0-9]+}}, [[MASK]], ({{v[0-9]+}})
+  ; CHECK: mul_f [[RESULT:v[0-9]+]]
+  ; CHECK: store_scat_mask [[RESULT]], [[MASK]], ([[PADDR]])
+  ; CHECK-NOT: getlane
+  ; CHECK: ret
+  ret void
+}
+
+define void @v8i32_aligned(<8 x i32>* %p) { ; CHECK-LABEL: v8i32_aligned:
+  %a = load <8 x i32>* %p, align 64
+  %r = add <8 x i32> %a, %a
+  store <8 x i32> %r, <8 x i32>* %p, align 64
+
+  ; CHECK: load_32 [[MASK:s[0-9]+]]
+  ; CHECK: load_v_mask [[VAL:v[0-9]+]], [[MASK]], (s0)
+  ; CHECK: add_i [[VAL]], [[VAL]], [[VAL]]
+  ; CHECK: store_v_mask [[VAL]], [[MASK]], (s0)
+  ; CHECK-NOT: getlane
+  ; CHECK: ret
+  ret void
+}
+
+; Vectors of bytes and halfwords are promoted to 32 bit elements. Their loads
+; fetch the packed words into the first lanes, then spread them out with a
+; shuffle and shifts.
+
+define <16 x i32> @zext_v16i8(<16 x i8>* %p) { ; CHECK-LABEL: zext_v16i8:
+  %a = load <16 x i8>* %p, align 4
+  %r = zext <16 x i8> %a to <16 x i32>
+
+  ; CHECK: load_gath_mask [[WORDS:v[0-9]+]]
+  ; CHECK: shuffle [[SPREAD:v[0-9]+]], [[WORDS]]
+  ; CHECK: shl [[TOP:v[0-9]+]], [[SPREAD]]
+  ; CHECK: shr {{v[0-9]+}}, [[TOP]], 24
+  ; CHECK-NOT: load_u8
+  ; CHECK: ret
+  ret <16 x i32> %r
+}
+
+define <16 x i32> @sext_v16i16(<16 x i16>* %p) { ; CHECK-LABEL: sext_v16i16:
+  %a = load <16 x i16>* %p, align 64
+  %r = sext <16 x i16> %a to <16 x i32>
+
+  ; CHECK: load_v_mask [[WORDS:v[0-9]+]]
+  ; CHECK: shuffle [[SPREAD:v[0-9]+]], [[WORDS]]
+  ; CHECK: shl [[TOP:v[0-9]+]], [[SPREAD]]
+  ; CHECK: ashr v0, [[TOP]], 16
+  ; CHECK-NOT: load_s16
+  ; CHECK: ret
+  ret <16 x i32> %r
+}
+
+; Truncating stores pack the elements into words, then store those.
+define void @trunc_v16i8(<16 x i32> %a, <16 x i8>* %p) { ; CHECK-LABEL: trunc_v16i8:
+  %r = trunc <16 x i32> %a to <16 x i8>
+  store <16 x i8> %r, <16 x i8>* %p, align 4
+
+  ; CHECK: and [[BYTES:v[0-9]+]], v0, 255
+  ; CHECK: shl [[POSITIONED:v[0-9]+]], [[BYTES]]
+  ; CHECK: shuffle
+  ; CHECK: or
+  ; CHECK: shuffle
+  ; CHECK: or
+  ; CHECK: shuffle
+  ; CHECK: store_scat_mask
+  ; CHECK-NOT: store_8
+  ; CHECK: ret
+  ret void
+}
+
+; Byte vectors that aren't word aligned are accessed an element at a time.
+define void @unaligned_v16i8(<16 x i8>* %p) { ; CHECK-LABEL: unaligned_v16i8:
+  %a = load <16 x i8>* %p, align 1
+  %r = add <16 x i8> %a, %a
+  store <16 x i8> %r, <16 x i8>* %p, align 1
+
+  ; CHECK: load_u8
+  ; CHECK: store_8
+  ; CHECK: ret
+  ret void
+}
+
+; Signed operations on promoted elements sign extend them in place with a
+; shift pair.
+
+define <16 x i8> @ashr_v16i8(<16 x i8> %a, <16 x i8> %b) { ; CHECK-LABEL: ashr_v16i8:
+  %r = ashr <16 x i8> %a, %b
+
+  ; CHECK: shl [[TOP:v[0-9]+]], v0, 24
+  ; CHECK: ashr [[EXT:v[0-9]+]], [[TOP]], 24
+  ; CHECK: ashr v0, [[EXT]], v{{[0-9]+}}
+  ret <16 x i8> %r
+}
+
+define <16 x i16> @select_slt_v16i16(<16 x i16> %a, <16 x i16> %b) { ; CHECK-LABEL: select_slt_v16i16:
+  %c = icmp slt <16 x i16> %a, %b
+  %r = select <16 x i1> %c, <16 x i16> %a, <16 x i16> %b
+
+  ; CHECK-DAG: shl [[TOPA:v[0-9]+]], v0, 16
+  ; CHECK-DAG: shl [[TOPB:v[0-9]+]], v1, 16
+  ; CHECK-DAG: ashr [[EXTA:v[0-9]+]], [[TOPA]], 16
+  ; CHECK-DAG: ashr [[EXTB:v[0-9]+]], [[TOPB]], 16
+  ; CHECK: cmplt_i [[MASK:s[0-9]+]], [[EXTA]], [[EXTB]]
+  ; CHECK: move_mask {{v[0-9]+}}, [[MASK]], v0
+  ret <16 x i16> %r
+}
+
+define <16 x i8> @sdiv_v16i8(<16 x i8> %a, <16 x i8> %b) { ; CHECK-LABEL: sdiv_v16i8:
+  %r = sdiv <16 x i8> %a, %b
+
+  ; CHECK-DAG: ashr {{v[0-9]+}}, {{v[0-9]+}}, 24
+  ; CHECK-DAG: ashr {{v[0-9]+}}, {{v[0-9]+}}, 24
+  ; CHECK: reciprocal
+  ; CHECK: ret
+  ret <16 x i8> %r
+}
+
+define <16 x i16> @srem_v16i16(<16 x i16> %a, <16 x i16> %b) { ; CHECK-LABEL: srem_v16i16:
+  %r = srem <16 x i16> %a, %b
+
+  ; CHECK-DAG: ashr {{v[0-9]+}}, {{v[0-9]+}}, 16
+  ; CHECK-DAG: ashr {{v[0-9]+}}, {{v[0-9]+}}, 16
+  ; CHECK: reciprocal
+  ; CHECK: ret
+  ret <16 x i16> %r
+}
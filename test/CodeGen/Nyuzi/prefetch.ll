@@ -0,0 +1,46 @@
+; RUN: llc -mtriple nyuzi-elf -nyuzi-prefetch-loads %s -o - | FileCheck %s
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s -check-prefix=DROP
+
+target triple = "nyuzi"
+
+declare void @llvm.prefetch(i8*, i32, i32, i32)
+declare void @llvm.nyuzi.__builtin_nyuzi_dflush(i8*)
+declare void @llvm.nyuzi.__builtin_nyuzi_dinvalidate(i8*)
+declare void @llvm.nyuzi.__builtin_nyuzi_iinvalidate(i8*)
+
+; There is no prefetch instruction, so prefetches are dropped by default.
+; With -nyuzi-prefetch-loads, a data prefetch is a load whose result is
+; unused. An instruction prefetch is always dropped.
+define void @prefetch(i8* %p) { ; CHECK-LABEL: prefetch:
+  ; DROP-LABEL: prefetch:
+  ; DROP-NOT: load_u8
+  ; DROP: ret
+  call void @llvm.prefetch(i8* %p, i32 0, i32 3, i32 1)
+  ; CHECK: load_u8 s{{[0-9]+}}, (s0)
+
+  %q = getelementptr i8* %p, i32 128
+  call void @llvm.prefetch(i8* %q, i32 1, i32 0, i32 1)
+  ; CHECK: load_u8 s{{[0-9]+}}, 128(s0)
+
+  call void @llvm.prefetch(i8* %p, i32 0, i32 3, i32 0)
+  ; CHECK-NOT: load_u8
+  ; CHECK: ret
+
+  ret void
+}
+
+define void @cache_control(i8* %p) { ; CHECK-LABEL: cache_control:
+  call void @llvm.nyuzi.__builtin_nyuzi_dflush(i8* %p)
+  ; CHECK: dflush s0
+
+  call void @llvm.nyuzi.__builtin_nyuzi_dinvalidate(i8* %p)
+  ; CHECK: dinvalidate s0
+
+  call void @llvm.nyuzi.__builtin_nyuzi_iinvalidate(i8* %p)
+  ; CHECK: iinvalidate s0
+
+  fence seq_cst
+  ; CHECK: membar
+
+  ret void
+}
@@ -0,0 +1,90 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+target triple = "nyuzi"
+
+declare i32 @llvm.nyuzi.__builtin_nyuzi_reduce_addi(<16 x i32>)
+declare i32 @llvm.nyuzi.__builtin_nyuzi_reduce_xori(<16 x i32>)
+declare i32 @llvm.nyuzi.__builtin_nyuzi_reduce_umaxi(<16 x i32>)
+declare float @llvm.nyuzi.__builtin_nyuzi_reduce_mulf(<16 x float>)
+declare float @llvm.nyuzi.__builtin_nyuzi_reduce_minf(<16 x float>)
+
+; Each step swaps lanes whose indices differ in one bit and combines them
+; with the original.
+define i32 @reduce_addi(<16 x i32> %a) { ; CHECK-LABEL: reduce_addi:
+  %r = call i32 @llvm.nyuzi.__builtin_nyuzi_reduce_addi(<16 x i32> %a)
+  ret i32 %r
+
+; CHECK: load_v [[LANES:v[0-9]+]]
+; CHECK: xor [[IDX:v[0-9]+]], [[LANES]], 8
+; CHECK: shuffle [[SWAPPED:v[0-9]+]], v0, [[IDX]]
+; CHECK: add_i v0, v0, [[SWAPPED]]
+; CHECK: xor {{v[0-9]+}}, [[LANES]], 4
+; CHECK: xor {{v[0-9]+}}, [[LANES]], 2
+; CHECK: xor {{v[0-9]+}}, [[LANES]], 1
+; CHECK: shuffle
+; CHECK: add_i [[RES:v[0-9]+]]
+; CHECK: getlane s0, [[RES]], 0
+; CHECK: ret
+}
+
+define i32 @reduce_xori(<16 x i32> %a) { ; CHECK-LABEL: reduce_xori:
+  %r = call i32 @llvm.nyuzi.__builtin_nyuzi_reduce_xori(<16 x i32> %a)
+  ret i32 %r
+
+; CHECK: xor
+; CHECK: xor
+; CHECK: xor
+; CHECK: xor
+; CHECK: getlane s0, {{v[0-9]+}}, 0
+}
+
+; Minimum and maximum keep the lanes that compare true with a masked move.
+define i32 @reduce_umaxi(<16 x i32> %a) { ; CHECK-LABEL: reduce_umaxi:
+  %r = call i32 @llvm.nyuzi.__builtin_nyuzi_reduce_umaxi(<16 x i32> %a)
+  ret i32 %r
+
+; CHECK: shuffle [[SWAPPED:v[0-9]+]], v0,
+; CHECK: cmpgt_u [[MASK:s[0-9]+]], v0, [[SWAPPED]]
+; CHECK: move_mask [[SWAPPED]], [[MASK]], v0
+; CHECK: getlane s0, {{v[0-9]+}}, 0
+}
+
+define float @reduce_mulf(<16 x float> %a) { ; CHECK-LABEL: reduce_mulf:
+  %r = call float @llvm.nyuzi.__builtin_nyuzi_reduce_mulf(<16 x float> %a)
+  ret float %r
+
+; CHECK: mul_f
+; CHECK: mul_f
+; CHECK: mul_f
+; CHECK: mul_f
+; CHECK: getlane s0, {{v[0-9]+}}, 0
+}
+
+define float @reduce_minf(<16 x float> %a) { ; CHECK-LABEL: reduce_minf:
+  %r = call float @llvm.nyuzi.__builtin_nyuzi_reduce_minf(<16 x float> %a)
+  ret float %r
+
+; CHECK: cmplt_f
+; CHECK: move_mask
+; CHECK: getlane s0, {{v[0-9]+}}, 0
+}
+
+; The reduction tree the vectorizers emit uses the same shuffles.
+define i32 @reduce_tree(<16 x i32> %a) { ; CHECK-LABEL: reduce_tree:
+  %r8 = shufflevector <16 x i32> %a, <16 x i32> undef, <16 x i32> <i32 8, i32 9, i32 10, i32 11, i32 12, i32 13, i32 14, i32 15, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef>
+  %s8 = add <16 x i32> %a, %r8
+  %r4 = shufflevector <16 x i32> %s8, <16 x i32> undef, <16 x i32> <i32 4, i32 5, i32 6, i32 7, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef>
+  %s4 = add <16 x i32> %s8, %r4
+  %r2 = shufflevector <16 x i32> %s4, <16 x i32> undef, <16 x i32> <i32 2, i32 3, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef>
+  %s2 = add <16 x i32> %s4, %r2
+  %r1 = shufflevector <16 x i32> %s2, <16 x i32> undef, <16 x i32> <i32 1, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef, i32 undef>
+  %s1 = add <16 x i32> %s2, %r1
+  %res = extractelement <16 x i32> %s1, i32 0
+  ret i32 %res
+
+; CHECK: xor {{v[0-9]+}}, [[LANES:v[0-9]+]], 8
+; CHECK-NOT: and
+; CHECK: xor {{v[0-9]+}}, [[LANES]], 4
+; CHECK: xor {{v[0-9]+}}, [[LANES]], 2
+; CHECK: getlane s0, {{v[0-9]+}}, 0
+}
@@ -0,0 +1,58 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+; Values that can be recomputed with a single instruction are rematerialized
+; rather than spilled when every register is clobbered.
+
+define <16 x i32> @splat_imm(<16 x i32> %a) { ; CHECK-LABEL: splat_imm:
+  %x = add <16 x i32> %a, <i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9>
+  call void asm sideeffect "", "~{v0},~{v1},~{v2},~{v3},~{v4},~{v5},~{v6},~{v7},~{v8},~{v9},~{v10},~{v11},~{v12},~{v13},~{v14},~{v15},~{v16},~{v17},~{v18},~{v19},~{v20},~{v21},~{v22},~{v23},~{v24},~{v25},~{v26},~{v27},~{v28},~{v29},~{v30},~{v31}"()
+  %y = sub <16 x i32> <i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9, i32 9>, %x
+
+; CHECK: add_i [[VAL:v[0-9]+]], v0, 9
+; CHECK: store_v [[VAL]]
+; CHECK-NOT: store_v
+; CHECK: ;NO_APP
+; CHECK: move [[SPLAT:v[0-9]+]], 9
+; CHECK: sub_i v0, [[SPLAT]], v{{[0-9]+}}
+
+  ret <16 x i32> %y
+}
+
+; Only the constant is live across the clobber, so the callee saved register
+; spills are the only other stack accesses.
+define i32 @constpool(i32 %a) { ; CHECK-LABEL: constpool:
+  %x = mul i32 %a, 123456
+  store volatile i32 %x, i32* inttoptr (i32 256 to i32*)
+  call void asm sideeffect "", "~{s0},~{s1},~{s2},~{s3},~{s4},~{s5},~{s6},~{s7},~{s8},~{s9},~{s10},~{s11},~{s12},~{s13},~{s14},~{s15},~{s16},~{s17},~{s18},~{s19},~{s20},~{s21},~{s22},~{s23},~{s24},~{s25},~{s26},~{s27}"()
+  %v = load volatile i32* inttoptr (i32 256 to i32*)
+  %y = mul i32 %v, 123456
+
+; CHECK: load_32 [[CONST1:s[0-9]+]], .LCPI1_0
+; CHECK-NOT: (sp)
+; CHECK: mull_i {{s[0-9]+}}, s0, [[CONST1]]
+; CHECK-NOT: (sp)
+; CHECK: ;NO_APP
+; CHECK-NOT: (sp)
+; CHECK: load_32 [[CONST2:s[0-9]+]], .LCPI1_0
+; CHECK: mull_i s0, {{s[0-9]+}}, [[CONST2]]
+
+  ret i32 %y
+}
+
+declare void @foo(i32*)
+
+define void @frame_addr() { ; CHECK-LABEL: frame_addr:
+  %buf = alloca [16 x i32], align 4
+  %p = getelementptr [16 x i32]* %buf, i32 0, i32 3
+  call void @foo(i32* %p)
+  call void asm sideeffect "", "~{s0},~{s1},~{s2},~{s3},~{s4},~{s5},~{s6},~{s7},~{s8},~{s9},~{s10},~{s11},~{s12},~{s13},~{s14},~{s15},~{s16},~{s17},~{s18},~{s19},~{s20},~{s21},~{s22},~{s23},~{s24},~{s25},~{s26},~{s27}"()
+  call void @foo(i32* %p)
+
+; CHECK: lea s0, [[OFFSET:[0-9]+]](sp)
+; CHECK-NEXT: call foo
+; CHECK: ;NO_APP
+; CHECK-NEXT: lea s0, [[OFFSET]](sp)
+; CHECK-NEXT: call foo
+
+  ret void
+}
@@ -0,0 +1,26 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+; RUN: llc -mtriple nyuzi-elf -mcpu=nyuzi %s -o - | FileCheck %s
+; RUN: llc -mtriple nyuzi-elf -mcpu=generic %s -o - | FileCheck %s -check-prefix=GENERIC
+
+target triple = "nyuzi"
+
+; The scheduler should start the loads and the multiply before the
+; independent integer arithmetic so their latency is hidden.
+define float @hide_latency(float* %a, float* %b, i32 %c, i32 %d, i32* %e) { ; CHECK: hide_latency
+  %1 = load float* %a
+  %2 = load float* %b
+  %3 = add i32 %c, %d
+  %4 = xor i32 %3, %c
+  store i32 %4, i32* %e
+  %5 = fmul float %1, %2
+  ret float %5
+
+  ; CHECK: load_32
+  ; CHECK: load_32
+  ; CHECK: mul_f
+  ; CHECK: add_i
+
+  ; GENERIC: hide_latency
+  ; GENERIC: add_i
+  ; GENERIC: mul_f
+}
@@ -8,9 +8,13 @@ entry:
 	; CHECK: cmpeq_i [[PRED:s[0-9]+]], s0, 4
 
     %val = select i1 %cmp, i32 2, i32 3
-	; CHECK: btrue [[PRED]], [[TRUELABEL:[\.A-Z0-9a-z_]+]]
-	; move s{{[0-9]+}}, [0-9]+
-	; [[TRUELABEL]]:
+	; Early if-conversion turns the compare result into an all ones or zero
+	; mask and selects with xor/and/xor.
+	; CHECK-NOT: btrue
+	; CHECK: shl [[SHIFTED:s[0-9]+]], [[PRED]], 31
+	; CHECK: ashr [[MASK:s[0-9]+]], [[SHIFTED]], 31
+	; CHECK: and s{{[0-9]+}}, s{{[0-9]+}}, [[MASK]]
+	; CHECK: xor s0,
     
     ret i32 %val
 }
@@ -22,8 +26,11 @@ entry:
 
     %val = select i1 %cmp, float %b, float %c
 
-	; CHECK: btrue [[PRED]], [[TRUELABEL:[\.A-Z0-9a-z_]+]]
-	; [[TRUELABEL]]:
+	; CHECK-NOT: btrue
+	; CHECK: shl [[SHIFTED:s[0-9]+]], [[PRED]], 31
+	; CHECK: ashr [[MASK:s[0-9]+]], [[SHIFTED]], 31
+	; CHECK: and s{{[0-9]+}}, s{{[0-9]+}}, [[MASK]]
+	; CHECK: xor s0,
     
     ret float %val
 }
@@ -34,9 +41,8 @@ entry:
 	; CHECK: cmpeq_i [[PRED:s[0-9]+]], s0, 4
 
     %val = select i1 %cmp, <16 x i32> %b, <16 x i32> %c
-	; CHECK: btrue [[PRED]], [[TRUELABEL:[\.A-Z0-9a-z_]+]]
-	; move v{{[0-9]+}}, v0
-	; [[TRUELABEL]]:
+	; CHECK-NOT: btrue
+	; CHECK: move_mask v{{[0-9]+}}, s{{[0-9]+}}, v0
     
     ret <16 x i32> %val
 }
@@ -47,9 +53,8 @@ entry:
 	; CHECK: cmpeq_i [[PRED:s[0-9]+]], s0, 4
 
     %val = select i1 %cmp, <16 x float> %b, <16 x float> %c
-	; CHECK: btrue [[PRED]], [[TRUELABEL:[\.A-Z0-9a-z_]+]]
-	; move v{{[0-9]+}}, v0
-	; [[TRUELABEL]]:
+	; CHECK-NOT: btrue
+	; CHECK: move_mask v{{[0-9]+}}, s{{[0-9]+}}, v0
     
     ret <16 x float> %val
 }
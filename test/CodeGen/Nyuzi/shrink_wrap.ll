@@ -0,0 +1,94 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+target triple = "nyuzi"
+
+declare i32 @work(i32)
+declare <16 x i32> @vwork(<16 x i32>)
+
+; The early return doesn't set up a frame or save registers.
+define i32 @early_return(i32 %a, i32 %n) { ; CHECK-LABEL: early_return:
+entry:
+  %c = icmp sgt i32 %n, 100
+  br i1 %c, label %exit, label %body, !prof !0
+
+; CHECK-NOT: sp
+; CHECK: btrue s{{[0-9]+}}, [[EXIT:[\.A-Z0-9a-z_]+]]
+; CHECK: add_i sp, sp, -64
+; CHECK: store_32 s24,
+; CHECK: call work
+; CHECK: load_32 s24,
+; CHECK: add_i sp, sp, 64
+; CHECK-NEXT: ret
+; CHECK: [[EXIT]]:
+; CHECK-NEXT: move s0, -1
+; CHECK-NEXT: ret
+
+body:
+  %v = call i32 @work(i32 %a)
+  %w = call i32 @work(i32 %a)
+  %s = add i32 %v, %w
+  %t = add i32 %s, %n
+  ret i32 %t
+
+exit:
+  ret i32 -1
+}
+
+; Registers are restored before branching to a block that is also reached
+; without setting up the frame.
+define <16 x i32> @rejoin(<16 x i32> %x, i32 %n) { ; CHECK-LABEL: rejoin:
+entry:
+  %c = icmp sgt i32 %n, 100
+  br i1 %c, label %exit, label %body
+
+; CHECK-NOT: sp
+; CHECK: btrue s{{[0-9]+}}, [[EXIT:[\.A-Z0-9a-z_]+]]
+; CHECK: add_i sp, sp, -
+; CHECK: store_v v26,
+; CHECK: call vwork
+; CHECK: load_v v26,
+; CHECK: add_i sp, sp,
+; CHECK-NEXT: [[EXIT]]:
+; CHECK-NEXT: ret
+
+body:
+  %v = call <16 x i32> @vwork(<16 x i32> %x)
+  %w = call <16 x i32> @vwork(<16 x i32> %v)
+  %s = add <16 x i32> %v, %w
+  %t = add <16 x i32> %s, %x
+  br label %exit
+
+exit:
+  %r = phi <16 x i32> [ %t, %body ], [ %x, %entry ]
+  ret <16 x i32> %r
+}
+
+; The frame pointer is set up and restored along with the rest of the frame.
+define i32 @dynamic_alloca(i32 %n) { ; CHECK-LABEL: dynamic_alloca:
+entry:
+  %c = icmp sgt i32 %n, 0
+  br i1 %c, label %body, label %exit
+
+; CHECK-NOT: sp
+; CHECK: btrue
+; CHECK: add_i sp, sp, -64
+; CHECK: store_32 fp,
+; CHECK: move fp, sp
+; CHECK: call work
+; CHECK: move sp, fp
+; CHECK: load_32 fp,
+; CHECK: add_i sp, sp, 64
+
+body:
+  %p = alloca i32, i32 %n
+  %v = call i32 @work(i32 %n)
+  store i32 %v, i32* %p
+  %l = load volatile i32* %p
+  br label %exit
+
+exit:
+  %r = phi i32 [ %l, %body ], [ 0, %entry ]
+  ret i32 %r
+}
+
+!0 = !{!"branch_weights", i32 1, i32 100}
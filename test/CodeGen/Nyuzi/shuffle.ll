@@ -0,0 +1,70 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+target triple = "nyuzi"
+
+; Broadcast a lane other than 0
+define <16 x i32> @broadcast_lane(<16 x i32> %a) { ; CHECK: broadcast_lane:
+	%res = shufflevector <16 x i32> %a, <16 x i32> undef, <16 x i32> <i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5>
+
+	; CHECK: getlane [[LANE:s[0-9]+]], v0, 5
+	; CHECK: move v0, [[LANE]]
+	; CHECK-NOT: shuffle
+	ret <16 x i32> %res
+}
+
+; Each lane comes from the same lane of one of the sources
+define <16 x float> @blend(<16 x float> %a, <16 x float> %b) { ; CHECK: blend:
+	%res = shufflevector <16 x float> %a, <16 x float> %b, <16 x i32> <i32 0, i32 17, i32 2, i32 19, i32 4, i32 21, i32 6, i32 23, i32 8, i32 25, i32 10, i32 27, i32 12, i32 29, i32 14, i32 31>
+
+	; CHECK: move_mask v0, {{s[0-9]+}}, v1
+	; CHECK-NOT: shuffle
+	ret <16 x float> %res
+}
+
+define <16 x i32> @reverse(<16 x i32> %a) { ; CHECK: reverse:
+	%res = shufflevector <16 x i32> %a, <16 x i32> undef, <16 x i32> <i32 15, i32 14, i32 13, i32 12, i32 11, i32 10, i32 9, i32 8, i32 7, i32 6, i32 5, i32 4, i32 3, i32 2, i32 1, i32 0>
+
+	; CHECK: load_v [[LANES:v[0-9]+]]
+	; CHECK: xor [[INDICES:v[0-9]+]], [[LANES]], 15
+	; CHECK: shuffle v0, v0, [[INDICES]]
+	ret <16 x i32> %res
+}
+
+define <16 x i32> @rotate(<16 x i32> %a) { ; CHECK: rotate:
+	%res = shufflevector <16 x i32> %a, <16 x i32> undef, <16 x i32> <i32 3, i32 4, i32 5, i32 6, i32 7, i32 8, i32 9, i32 10, i32 11, i32 12, i32 13, i32 14, i32 15, i32 0, i32 1, i32 2>
+
+	; CHECK: load_v [[LANES:v[0-9]+]]
+	; CHECK: add_i [[SUM:v[0-9]+]], [[LANES]], 3
+	; CHECK: and [[INDICES:v[0-9]+]], [[SUM]], 15
+	; CHECK: shuffle v0, v0, [[INDICES]]
+	ret <16 x i32> %res
+}
+
+; Swap adjacent pairs of lanes
+define <16 x float> @swizzle(<16 x float> %a) { ; CHECK: swizzle:
+	%res = shufflevector <16 x float> %a, <16 x float> undef, <16 x i32> <i32 1, i32 0, i32 3, i32 2, i32 5, i32 4, i32 7, i32 6, i32 9, i32 8, i32 11, i32 10, i32 13, i32 12, i32 15, i32 14>
+
+	; CHECK: load_v [[LANES:v[0-9]+]]
+	; CHECK: xor [[INDICES:v[0-9]+]], [[LANES]], 1
+	; CHECK: shuffle v0, v0, [[INDICES]]
+	ret <16 x float> %res
+}
+
+; Arbitrary single source shuffle
+define <16 x float> @permute(<16 x float> %a) { ; CHECK: permute:
+	%res = shufflevector <16 x float> %a, <16 x float> undef, <16 x i32> <i32 1, i32 0, i32 2, i32 3, i32 5, i32 4, i32 7, i32 6, i32 9, i32 8, i32 11, i32 10, i32 13, i32 12, i32 15, i32 14>
+
+	; CHECK: load_v [[INDICES:v[0-9]+]]
+	; CHECK: shuffle v0, v0, [[INDICES]]
+	ret <16 x float> %res
+}
+
+; Arbitrary two source shuffle
+define <16 x i32> @two_source(<16 x i32> %a, <16 x i32> %b) { ; CHECK: two_source:
+	%res = shufflevector <16 x i32> %a, <16 x i32> %b, <16 x i32> <i32 0, i32 16, i32 1, i32 17, i32 2, i32 18, i32 3, i32 19, i32 4, i32 20, i32 5, i32 21, i32 6, i32 22, i32 7, i32 23>
+
+	; CHECK: load_v [[INDICES:v[0-9]+]]
+	; CHECK: shuffle [[RESULT:v[0-9]+]], v0, [[INDICES]]
+	; CHECK: shuffle_mask [[RESULT]], {{s[0-9]+}}, v1, [[INDICES]]
+	ret <16 x i32> %res
+}
@@ -0,0 +1,58 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+target triple = "nyuzi"
+
+; Uniform operands use the vector/scalar and vector/immediate instruction
+; forms rather than being copied into a vector register.
+define <16 x i32> @scalar_rhs(<16 x i32> %a, i32 %b) { ; CHECK: scalar_rhs:
+	%single = insertelement <16 x i32> undef, i32 %b, i32 0
+	%splat = shufflevector <16 x i32> %single, <16 x i32> undef, <16 x i32> zeroinitializer
+	%sum = add <16 x i32> %a, %splat
+	; CHECK: add_i v{{[0-9]+}}, v0, s0
+	ret <16 x i32> %sum
+}
+
+define <16 x i32> @scalar_lhs(<16 x i32> %a, i32 %b) { ; CHECK: scalar_lhs:
+	%single = insertelement <16 x i32> undef, i32 %b, i32 0
+	%splat = shufflevector <16 x i32> %single, <16 x i32> undef, <16 x i32> zeroinitializer
+	%prod = mul <16 x i32> %splat, %a
+	; CHECK: mull_i v{{[0-9]+}}, v0, s0
+	ret <16 x i32> %prod
+}
+
+define <16 x i32> @immediate(<16 x i32> %a) { ; CHECK: immediate:
+	%prod = mul <16 x i32> %a, <i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5, i32 5>
+	; CHECK: mull_i v{{[0-9]+}}, v0, 5
+	ret <16 x i32> %prod
+}
+
+define <16 x float> @float_scalar(<16 x float> %a, float %b) { ; CHECK: float_scalar:
+	%single = insertelement <16 x float> undef, float %b, i32 0
+	%splat = shufflevector <16 x float> %single, <16 x float> undef, <16 x i32> zeroinitializer
+	%prod = fmul <16 x float> %splat, %a
+	; CHECK: mul_f v{{[0-9]+}}, v0, s0
+	ret <16 x float> %prod
+}
+
+; A comparison with a uniform first operand is reversed.
+define <16 x i32> @compare_lhs(<16 x i32> %a, i32 %b) { ; CHECK: compare_lhs:
+	%single = insertelement <16 x i32> undef, i32 %b, i32 0
+	%splat = shufflevector <16 x i32> %single, <16 x i32> undef, <16 x i32> zeroinitializer
+	%cmp = icmp sgt <16 x i32> %splat, %a
+	%sel = select <16 x i1> %cmp, <16 x i32> %a, <16 x i32> zeroinitializer
+	; CHECK: cmplt_i s{{[0-9]+}}, v0, s0
+	ret <16 x i32> %sel
+}
+
+; An operation on two uniform values is performed on the scalars.
+define <16 x i32> @both_uniform(<16 x i32> %a, i32 %b, i32 %c) { ; CHECK: both_uniform:
+	%single1 = insertelement <16 x i32> undef, i32 %b, i32 0
+	%splat1 = shufflevector <16 x i32> %single1, <16 x i32> undef, <16 x i32> zeroinitializer
+	%single2 = insertelement <16 x i32> undef, i32 %c, i32 0
+	%splat2 = shufflevector <16 x i32> %single2, <16 x i32> undef, <16 x i32> zeroinitializer
+	%stride = shl <16 x i32> %splat1, %splat2
+	%sum = add <16 x i32> %a, %stride
+	; CHECK: shl [[STRIDE:s[0-9]+]], s0, s1
+	; CHECK: add_i v{{[0-9]+}}, v0, [[STRIDE]]
+	ret <16 x i32> %sum
+}
@@ -0,0 +1,100 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+; RUN: llc -mtriple nyuzi-elf -enable-unsafe-fp-math %s -o - | FileCheck %s -check-prefix=FAST
+
+target triple = "nyuzi"
+
+declare float @llvm.sqrt.f32(float)
+declare <16 x float> @llvm.sqrt.v16f32(<16 x float>)
+declare double @llvm.sqrt.f64(double)
+
+; Square roots are computed inline from a reciprocal square root estimate.
+; Each refinement step has one subtraction: three for full precision and two
+; with unsafe math.
+define float @sqrt_f(float %a) { ; CHECK: sqrt_f:
+	%r = call float @llvm.sqrt.f32(float %a)
+	; CHECK: shr
+	; CHECK: mul_f
+	; CHECK: sub_f
+	; CHECK: sub_f
+	; CHECK: sub_f
+	; CHECK-NOT: sub_f
+	; CHECK-NOT: call
+	; CHECK: ret
+	; FAST: sqrt_f:
+	; FAST-NOT: cmp
+	; FAST: sub_f
+	; FAST: sub_f
+	; FAST-NOT: {{sub_f|cmp|call}}
+	; FAST: ret
+	ret float %r
+}
+
+define <16 x float> @sqrt_vf(<16 x float> %a) { ; CHECK: sqrt_vf:
+	%r = call <16 x float> @llvm.sqrt.v16f32(<16 x float> %a)
+	; CHECK: shr v{{[0-9]+}}, v0, 1
+	; CHECK: mul_f v
+	; CHECK-NOT: call
+	; CHECK: ret
+	ret <16 x float> %r
+}
+
+; The reciprocal estimate for zero overflows, so zero and denormals (whose
+; magnitude is less than FLT_MIN) are replaced with zero of the same sign.
+define <16 x float> @sqrt_vf_zero(<16 x float> %a) { ; CHECK: sqrt_vf_zero:
+	%r = call <16 x float> @llvm.sqrt.v16f32(<16 x float> %a)
+	; CHECK: and [[ABS:v[0-9]+]], v0,
+	; CHECK: cmplt_f [[TINY:s[0-9]+]], [[ABS]]
+	; CHECK: and [[SIGN:v[0-9]+]], v0,
+	; CHECK: move_mask {{v[0-9]+}}, [[TINY]], [[SIGN]]
+	; CHECK: ret
+	ret <16 x float> %r
+}
+
+; The constant pool entry is emitted before the function.
+; CHECK: .long 0 {{ *}}; float 0
+define float @sqrt_zero() { ; CHECK: sqrt_zero:
+	%r = call float @llvm.sqrt.f32(float 0.0)
+	; CHECK: load_32 s0
+	; CHECK-NEXT: ret
+	ret float %r
+}
+
+; CHECK: .long 2147483648 {{ *}}; float -0
+define float @sqrt_negzero() { ; CHECK: sqrt_negzero:
+	%r = call float @llvm.sqrt.f32(float -0.0)
+	; CHECK: load_32 s0
+	; CHECK-NEXT: ret
+	ret float %r
+}
+
+; Dividing by a square root uses the reciprocal square root directly, with
+; the same number of refinement steps.
+define <16 x float> @rsqrt_vf(<16 x float> %a, <16 x float> %b) { ; CHECK: rsqrt_vf:
+	%s = call <16 x float> @llvm.sqrt.v16f32(<16 x float> %b)
+	%r = fdiv <16 x float> %a, %s
+	; CHECK: sub_f
+	; CHECK: sub_f
+	; CHECK: sub_f
+	; CHECK-NOT: sub_f
+	; CHECK-NOT: reciprocal
+	; CHECK-NOT: call
+	; CHECK: ret
+	; FAST: rsqrt_vf:
+	; FAST: shr v{{[0-9]+}}, v1, 1
+	; FAST: sub_f
+	; FAST: sub_f
+	; FAST-NOT: sub_f
+	; FAST-NOT: reciprocal
+	; FAST: ret
+	ret <16 x float> %r
+}
+
+; The reciprocal square root only handles single precision. Other types
+; aren't combined.
+define double @rsqrt_d(double %a, double %b) { ; CHECK: rsqrt_d:
+	%s = call double @llvm.sqrt.f64(double %b)
+	%r = fdiv double %a, %s
+	; CHECK: call sqrt
+	; CHECK: call __divdf3
+	ret double %r
+}
@@ -6,9 +6,69 @@ define i32 @doSomethingElse(i32 %a, i32 %b) #0 {
 entry:
   %result = tail call i32 @doSomething(i32 %a, i32 %b) #2
 
-  ; CHECK: call
+  ; CHECK-LABEL: doSomethingElse:
+  ; CHECK-NOT: call
+  ; CHECK: goto doSomething
 
   ret i32 %result
 }
 
+define i32 @indirect(i32 (i32)* %func, i32 %a) #0 {
+entry:
+  %result = tail call i32 %func(i32 %a)
+
+  ; CHECK-LABEL: indirect:
+  ; CHECK-NOT: call
+  ; CHECK: goto s{{[0-9]+}}
+
+  ret i32 %result
+}
+
+define void @preserveCalleeSaved(i32 %a) #0 {
+entry:
+  call void @doSomethingVoid(i32 %a)
+  tail call void @doSomethingVoid(i32 %a)
+
+  ; CHECK-LABEL: preserveCalleeSaved:
+  ; CHECK: call doSomethingVoid
+  ; CHECK: load_32 ra,
+  ; CHECK: goto doSomethingVoid
+
+  ret void
+}
+
+; Arguments passed on the stack would be written into the caller's frame.
+define i32 @stackArgs(i32 %a) #0 {
+entry:
+  %result = tail call i32 @manyArgs(i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a)
+
+  ; CHECK-LABEL: stackArgs:
+  ; CHECK: call manyArgs
+  ; CHECK: ret
+
+  ret i32 %result
+}
+
+; fastcc passes more arguments in registers, so the same call can be a tail
+; call between fastcc functions.
+define internal fastcc i32 @fastStackArgs(i32 %a) #0 {
+entry:
+  %result = tail call fastcc i32 @fastManyArgs(i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a)
+
+  ; CHECK-LABEL: fastStackArgs:
+  ; CHECK-NOT: call
+  ; CHECK: goto fastManyArgs
+
+  ret i32 %result
+}
+
+define i32 @callFastStackArgs(i32 %a) #0 {
+entry:
+  %result = call fastcc i32 @fastStackArgs(i32 %a)
+  ret i32 %result
+}
+
 declare i32 @doSomething(i32, i32) #1
+declare void @doSomethingVoid(i32) #1
+declare i32 @manyArgs(i32, i32, i32, i32, i32, i32, i32, i32, i32) #1
+declare fastcc i32 @fastManyArgs(i32, i32, i32, i32, i32, i32, i32, i32, i32) #1
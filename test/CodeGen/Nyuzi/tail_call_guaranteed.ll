@@ -0,0 +1,24 @@
+; RUN: not llc -mtriple nyuzi-elf -tailcallopt %s -o /dev/null 2>&1 | FileCheck %s
+
+target triple = "nyuzi"
+
+; fastcc passes the first 16 scalar arguments in registers. The rest go on
+; the stack, and callees don't pop them, so -tailcallopt can't make this a
+; tail call.
+
+; CHECK: LLVM ERROR: failed to perform guaranteed tail call optimization on a fastcc call
+
+define internal fastcc i32 @callee(i32 %a0, i32 %a1, i32 %a2, i32 %a3, i32 %a4, i32 %a5, i32 %a6, i32 %a7, i32 %a8, i32 %a9, i32 %a10, i32 %a11, i32 %a12, i32 %a13, i32 %a14, i32 %a15, i32 %a16) {
+  %sum = add i32 %a0, %a16
+  ret i32 %sum
+}
+
+define internal fastcc i32 @caller(i32 %a) {
+  %result = tail call fastcc i32 @callee(i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a, i32 %a)
+  ret i32 %result
+}
+
+define i32 @entry(i32 %a) {
+  %result = call fastcc i32 @caller(i32 %a)
+  ret i32 %result
+}
@@ -6,6 +6,10 @@ target triple = "nyuzi"
 ; The original bug was that the goto was not inserted at the end of the first block
 ; when two blocks were tail merged.
 ;
+; The stack frame is now only set up on the if.else path, so both returns
+; merge into a block that if.else falls through to. @merged_epilogue below
+; still needs the goto.
+;
 
 define i32 @_Z3fibi(i32 %n) {
 entry:
@@ -24,13 +28,41 @@ if.else:                                          ; preds = %entry
 
   %add = add nsw i32 %call2, %call
 
-; CHECK:	goto [[EXITLABEL:[\.A-Z0-9a-z_]+]]
+; CHECK: add_i sp, sp, 64
+; CHECK-NEXT: [[TRUELABEL]]:{{.*}}
+; CHECK-NEXT: ret
 
   ret i32 %add
 
-; CHECK: [[TRUELABEL]]:                          
-; CHECK: [[EXITLABEL]]:                          
-
 return:                                           ; preds = %entry
   ret i32 %n
 }	
+
+declare i32 @work(i32)
+
+define i32 @merged_epilogue(i32 %a) {
+entry:
+  %v = call i32 @work(i32 %a)
+  %c = icmp sgt i32 %v, 0
+  br i1 %c, label %pos, label %neg, !prof !0
+
+; CHECK: merged_epilogue:
+; CHECK: btrue {{s[0-9]+}}, [[NEGLABEL:[\.A-Z0-9a-z_]+]]
+; CHECK: [[EXITLABEL:[\.A-Z0-9a-z_]+]]:
+; CHECK: add_i sp, sp, 64
+; CHECK-NEXT: ret
+; CHECK: [[NEGLABEL]]:
+; CHECK: call work
+; CHECK: call work
+; CHECK-NEXT: goto [[EXITLABEL]]
+
+pos:
+  ret i32 %v
+
+neg:
+  %w = call i32 @work(i32 %v)
+  %x = call i32 @work(i32 %w)
+  ret i32 %x
+}
+
+!0 = !{!"branch_weights", i32 100, i32 1}
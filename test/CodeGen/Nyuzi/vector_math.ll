@@ -0,0 +1,74 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+target triple = "nyuzi"
+
+declare <16 x float> @llvm.sin.v16f32(<16 x float>)
+declare <16 x float> @llvm.cos.v16f32(<16 x float>)
+declare <16 x float> @llvm.exp.v16f32(<16 x float>)
+declare <16 x float> @llvm.exp2.v16f32(<16 x float>)
+declare <16 x float> @llvm.log.v16f32(<16 x float>)
+declare <16 x float> @llvm.log2.v16f32(<16 x float>)
+declare <16 x float> @llvm.log10.v16f32(<16 x float>)
+declare <16 x float> @llvm.pow.v16f32(<16 x float>, <16 x float>)
+
+; Vector transcendental functions are computed inline on all lanes rather
+; than with 16 scalar library calls.
+define <16 x float> @vsin(<16 x float> %a) { ; CHECK: vsin:
+	%r = call <16 x float> @llvm.sin.v16f32(<16 x float> %a)
+	; CHECK: ftoi v{{[0-9]+}}
+	; CHECK: itof v{{[0-9]+}}
+	; CHECK-NOT: call
+	; CHECK: ret
+	ret <16 x float> %r
+}
+
+define <16 x float> @vcos(<16 x float> %a) { ; CHECK: vcos:
+	%r = call <16 x float> @llvm.cos.v16f32(<16 x float> %a)
+	; CHECK-NOT: call
+	; CHECK: ret
+	ret <16 x float> %r
+}
+
+define <16 x float> @vexp(<16 x float> %a) { ; CHECK: vexp:
+	%r = call <16 x float> @llvm.exp.v16f32(<16 x float> %a)
+	; CHECK: shl v{{[0-9]+}}, v{{[0-9]+}}, 23
+	; CHECK-NOT: call
+	; CHECK: ret
+	ret <16 x float> %r
+}
+
+define <16 x float> @vexp2(<16 x float> %a) { ; CHECK: vexp2:
+	%r = call <16 x float> @llvm.exp2.v16f32(<16 x float> %a)
+	; CHECK-NOT: call
+	; CHECK: ret
+	ret <16 x float> %r
+}
+
+define <16 x float> @vlog(<16 x float> %a) { ; CHECK: vlog:
+	%r = call <16 x float> @llvm.log.v16f32(<16 x float> %a)
+	; CHECK: shr v{{[0-9]+}}, v0, 23
+	; CHECK-NOT: call
+	; CHECK: ret
+	ret <16 x float> %r
+}
+
+define <16 x float> @vlog2(<16 x float> %a) { ; CHECK: vlog2:
+	%r = call <16 x float> @llvm.log2.v16f32(<16 x float> %a)
+	; CHECK-NOT: call
+	; CHECK: ret
+	ret <16 x float> %r
+}
+
+define <16 x float> @vlog10(<16 x float> %a) { ; CHECK: vlog10:
+	%r = call <16 x float> @llvm.log10.v16f32(<16 x float> %a)
+	; CHECK-NOT: call
+	; CHECK: ret
+	ret <16 x float> %r
+}
+
+define <16 x float> @vpow(<16 x float> %a, <16 x float> %b) { ; CHECK: vpow:
+	%r = call <16 x float> @llvm.pow.v16f32(<16 x float> %a, <16 x float> %b)
+	; CHECK-NOT: call
+	; CHECK: ret
+	ret <16 x float> %r
+}
@@ -0,0 +1,42 @@
+; RUN: llc -mtriple nyuzi-elf %s -o - | FileCheck %s
+
+target triple = "nyuzi"
+
+; Vector selects are a comparison and a masked move, without branches.
+define <16 x i32> @select_vv(<16 x i32> %a, <16 x i32> %b) { ; CHECK: select_vv:
+	%cmp = icmp sgt <16 x i32> %a, %b
+	%sel = select <16 x i1> %cmp, <16 x i32> %a, <16 x i32> %b
+	; CHECK: cmpgt_i [[MASK:s[0-9]+]], v0, v1
+	; CHECK-NOT: {{btrue|bfalse}}
+	; CHECK: move_mask v{{[0-9]+}}, [[MASK]], v0
+	ret <16 x i32> %sel
+}
+
+define <16 x float> @select_fvv(<16 x float> %a, <16 x float> %b) { ; CHECK: select_fvv:
+	%cmp = fcmp olt <16 x float> %a, %b
+	%sel = select <16 x i1> %cmp, <16 x float> %a, <16 x float> %b
+	; CHECK: cmplt_f [[MASK:s[0-9]+]], v0, v1
+	; CHECK-NOT: {{btrue|bfalse}}
+	; CHECK: move_mask v{{[0-9]+}}, [[MASK]], v0
+	ret <16 x float> %sel
+}
+
+; The masked move is folded into the arithmetic instruction.
+define <16 x i32> @select_add(<16 x i32> %a, <16 x i32> %b, <16 x i32> %c) { ; CHECK: select_add:
+	%cmp = icmp eq <16 x i32> %a, %b
+	%sum = add <16 x i32> %a, %c
+	%sel = select <16 x i1> %cmp, <16 x i32> %sum, <16 x i32> %c
+	; CHECK: cmpeq_i [[MASK:s[0-9]+]], v0, v1
+	; CHECK: add_i_mask v2, [[MASK]], v0, v2
+	ret <16 x i32> %sel
+}
+
+; A scalar condition selects all lanes or none.
+define <16 x i32> @select_scalar_cond(i32 %a, i32 %b, <16 x i32> %c, <16 x i32> %d) { ; CHECK: select_scalar_cond:
+	%cmp = icmp slt i32 %a, %b
+	%sel = select i1 %cmp, <16 x i32> %c, <16 x i32> %d
+	; CHECK: cmplt_i
+	; CHECK-NOT: {{btrue|bfalse}}
+	; CHECK: move_mask
+	ret <16 x i32> %sel
+}
@@ -6215,7 +6215,7 @@ namespace {
       SizeType = UnsignedInt;
       PtrDiffType = SignedInt;
       MaxAtomicPromoteWidth = MaxAtomicInlineWidth = 32;
-      DescriptionString = "e-m:e-p:32:32";
+      DescriptionString = "e-m:e-p:32:32-n32";
       LongDoubleWidth = 32;
       LongDoubleAlign = 32;
       DoubleWidth = 32;
@@ -6229,6 +6229,13 @@ namespace {
       Builder.defineMacro("__NYUZI__");
     }
 
+    virtual bool setCPU(const std::string &Name) override {
+      return llvm::StringSwitch<bool>(Name)
+        .Case("generic", true)
+        .Case("nyuzi", true)
+        .Default(false);
+    }
+
   	virtual void getTargetBuiltins(const Builtin::Info *&Records,
   		                             unsigned &NumRecords) const override
   	{
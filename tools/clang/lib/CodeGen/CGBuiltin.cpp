@@ -6285,6 +6285,14 @@ Value *CodeGenFunction::EmitNyuziBuiltinExpr(unsigned BuiltinID,
 		case Nyuzi::BI__builtin_nyuzi_vftoi:
 			return Builder.CreateFPToSI(Ops[0], llvm::VectorType::get(Builder.getInt32Ty(),
 				16));
+
+		case Nyuzi::BI__builtin_nyuzi_membar:
+			return Builder.CreateFence(llvm::SequentiallyConsistent);
+
+		// A read prefetch into the data cache with maximum temporal locality.
+		case Nyuzi::BI__builtin_nyuzi_prefetch:
+			return Builder.CreateCall4(CGM.getIntrinsic(Intrinsic::prefetch), Ops[0],
+				Builder.getInt32(0), Builder.getInt32(3), Builder.getInt32(1));
 	}
 
 	// This maps directly to an LLVM intrinsic.  Look up the function name and create
@@ -6300,6 +6308,18 @@ Value *CodeGenFunction::EmitNyuziBuiltinExpr(unsigned BuiltinID,
 			F = CGM.getIntrinsic(Intrinsic::nyuzi_write_control_reg);
 			break;
 			
+		case Nyuzi::BI__builtin_nyuzi_dflush:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_dflush);
+			break;
+
+		case Nyuzi::BI__builtin_nyuzi_dinvalidate:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_dinvalidate);
+			break;
+
+		case Nyuzi::BI__builtin_nyuzi_iinvalidate:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_iinvalidate);
+			break;
+
 		case Nyuzi::BI__builtin_nyuzi_shufflei:
 			F = CGM.getIntrinsic(Intrinsic::nyuzi_shufflei);
 			break;
@@ -6348,6 +6368,14 @@ Value *CodeGenFunction::EmitNyuziBuiltinExpr(unsigned BuiltinID,
 			F = CGM.getIntrinsic(Intrinsic::nyuzi_scatter_storef_masked);
 			break;
 
+		case Nyuzi::BI__builtin_nyuzi_scatter_atomic_addi:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_scatter_atomic_addi);
+			break;
+
+		case Nyuzi::BI__builtin_nyuzi_scatter_atomic_addi_masked:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_scatter_atomic_addi_masked);
+			break;
+
 		case Nyuzi::BI__builtin_nyuzi_block_loadi_masked:
 			F = CGM.getIntrinsic(Intrinsic::nyuzi_block_loadi_masked);
 			break;
@@ -6364,6 +6392,59 @@ Value *CodeGenFunction::EmitNyuziBuiltinExpr(unsigned BuiltinID,
 			F = CGM.getIntrinsic(Intrinsic::nyuzi_block_storef_masked);
 			break;
 
+		// Horizontal reductions
+		case Nyuzi::BI__builtin_nyuzi_reduce_addi:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_reduce_addi);
+			break;
+
+		case Nyuzi::BI__builtin_nyuzi_reduce_muli:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_reduce_muli);
+			break;
+
+		case Nyuzi::BI__builtin_nyuzi_reduce_andi:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_reduce_andi);
+			break;
+
+		case Nyuzi::BI__builtin_nyuzi_reduce_ori:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_reduce_ori);
+			break;
+
+		case Nyuzi::BI__builtin_nyuzi_reduce_xori:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_reduce_xori);
+			break;
+
+		case Nyuzi::BI__builtin_nyuzi_reduce_smini:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_reduce_smini);
+			break;
+
+		case Nyuzi::BI__builtin_nyuzi_reduce_smaxi:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_reduce_smaxi);
+			break;
+
+		case Nyuzi::BI__builtin_nyuzi_reduce_umini:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_reduce_umini);
+			break;
+
+		case Nyuzi::BI__builtin_nyuzi_reduce_umaxi:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_reduce_umaxi);
+			break;
+
+		case Nyuzi::BI__builtin_nyuzi_reduce_addf:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_reduce_addf);
+			break;
+
+		case Nyuzi::BI__builtin_nyuzi_reduce_mulf:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_reduce_mulf);
+			break;
+
+		case Nyuzi::BI__builtin_nyuzi_reduce_minf:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_reduce_minf);
+			break;
+
+		case Nyuzi::BI__builtin_nyuzi_reduce_maxf:
+			F = CGM.getIntrinsic(Intrinsic::nyuzi_reduce_maxf);
+			break;
+
 		// Vector comparisions
 		case Nyuzi::BI__builtin_nyuzi_mask_cmpi_ugt: 
 			F = CGM.getIntrinsic(Intrinsic::nyuzi_mask_cmpi_ugt);
@@ -708,6 +708,7 @@ public:
                       const llvm::opt::ArgList &Args);
   ~NyuziToolChain();
   virtual bool IsIntegratedAssemblerDefault() const override;
+  virtual bool IsMathErrnoDefault() const override { return false; }
   virtual bool isPICDefault() const override;
   virtual bool isPIEDefault() const override;
   virtual bool isPICDefaultForced() const override;
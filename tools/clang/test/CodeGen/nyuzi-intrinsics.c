@@ -148,3 +148,51 @@ unsigned int test_builtin_return_address() // CHECK: test_builtin_return_address
 }
 
 
+
+void test_dflush(void *ptr) // CHECK: test_dflush:
+{
+	__builtin_nyuzi_dflush(ptr);
+	// CHECK: dflush s0
+}
+
+void test_dinvalidate(void *ptr) // CHECK: test_dinvalidate:
+{
+	__builtin_nyuzi_dinvalidate(ptr);
+	// CHECK: dinvalidate s0
+}
+
+void test_iinvalidate(void *ptr) // CHECK: test_iinvalidate:
+{
+	__builtin_nyuzi_iinvalidate(ptr);
+	// CHECK: iinvalidate s0
+}
+
+void test_membar() // CHECK: test_membar:
+{
+	__builtin_nyuzi_membar();
+	// CHECK: membar
+}
+
+void test_prefetch(const int *ptr) // CHECK: test_prefetch:
+{
+	__builtin_nyuzi_prefetch(ptr + 64);
+	// CHECK-NOT: load_u8
+	// CHECK: ret
+}
+
+int test_reduce_addi(veci16 a) // CHECK: test_reduce_addi:
+{
+	return __builtin_nyuzi_reduce_addi(a);
+	// CHECK: shuffle
+	// CHECK: add_i
+	// CHECK: getlane s0, v{{[0-9]+}}, 0
+}
+
+float test_reduce_maxf(vecf16 a) // CHECK: test_reduce_maxf:
+{
+	return __builtin_nyuzi_reduce_maxf(a);
+	// CHECK: shuffle
+	// CHECK: cmpgt_f
+	// CHECK: move_mask
+	// CHECK: getlane s0, v{{[0-9]+}}, 0
+}